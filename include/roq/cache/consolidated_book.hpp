@@ -0,0 +1,295 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/exceptions.hpp"
+#include "roq/layer.hpp"
+#include "roq/numbers.hpp"
+#include "roq/side.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/market_by_price_update.hpp"
+#include "roq/mbp_update.hpp"
+
+#include "roq/cache/reference_data_cache.hpp"
+
+#include "roq/utils/common.hpp"
+
+namespace roq {
+namespace cache {
+
+// consolidated (merged) book of the same asset traded on several venues
+// - venues are identified by (exchange, symbol) and must be added before updates are received
+// - prices are converted to integer ticks using a common tick size
+// - each level holds the quantity per venue (attribution) and the total
+// - levels are kept in sorted vectors with the best level last, i.e. best bid/offer is O(1) and updates close to the
+//   top of the book are cheap
+// - level deltas (MarketByPriceUpdate) are applied incrementally, a SNAPSHOT only clears the levels of that venue
+// - levels of a venue beyond its max_depth (if non-zero) are removed after each update (depth-limited feeds do not
+//   send deletes for levels pushed beyond the depth)
+// - venues must quote on the common tick grid (their tick size being a multiple of the common tick size), i.e. two
+//   prices of a venue never alias to the same tick
+// note! prices not on the common tick grid (beyond rounding noise) are rejected (and counted)
+// note! the consolidated book may be crossed (venues are not arbitraged)
+
+struct ConsolidatedBook final {
+  static constexpr size_t const MAX_VENUES = 8;
+  static constexpr size_t const NOT_FOUND = static_cast<size_t>(-1);
+
+  struct Level final {
+    int64_t ticks = {};
+    double price = NaN;
+    double quantity = 0.0;  // total
+    uint32_t venues = {};   // mask
+    std::array<double, MAX_VENUES> quantities = {};
+  };
+
+  explicit ConsolidatedBook(double tick_size)
+      : tick_size_{tick_size}, inverse_tick_size_{1.0 / tick_size},
+        price_precision_{ReferenceDataCache::compute_precision(tick_size)} {
+    using namespace std::literals;
+    if (price_precision_ == Precision::UNDEFINED)
+      throw InvalidArgument{"unexpected: tick_size={}"sv, tick_size};
+    price_scale_ = std::pow(10.0, utils::decimal_digits(price_precision_));
+    tick_units_ = std::llround(tick_size * price_scale_);
+  }
+
+  ConsolidatedBook(ConsolidatedBook &&) = default;
+  ConsolidatedBook(ConsolidatedBook const &) = delete;
+
+  double tick_size() const { return tick_size_; }
+
+  Precision price_precision() const { return price_precision_; }
+
+  // number of prices rejected (not on the common tick grid)
+  size_t rejected() const { return rejected_; }
+
+  // returns the venue index
+  // note! tick_size (of the venue) is validated against the common tick size, NaN means not known
+  size_t add(std::string_view const &exchange, std::string_view const &symbol, double tick_size = NaN) {
+    auto index = find_venue(exchange, symbol);
+    if (index != NOT_FOUND)
+      return index;
+    using namespace std::literals;
+    if (std::size(venues_) == MAX_VENUES)
+      throw InvalidArgument{"unexpected: too many venues (max {})"sv, MAX_VENUES};
+    if (!std::isnan(tick_size)) {
+      auto ticks = tick_size * inverse_tick_size_;
+      if (!(ticks > 0.5) || !is_on_grid(ticks))
+        throw InvalidArgument{"unexpected: tick_size={} (common tick_size={})"sv, tick_size, tick_size_};
+    }
+    venues_.emplace_back(Venue{
+        .exchange = exchange,
+        .symbol = symbol,
+    });
+    return std::size(venues_) - 1;
+  }
+
+  size_t find_venue(std::string_view const &exchange, std::string_view const &symbol) const {
+    for (size_t i = 0; i < std::size(venues_); ++i)
+      if (venues_[i].exchange == exchange && venues_[i].symbol == symbol)
+        return i;
+    return NOT_FOUND;
+  }
+
+  // returns {size(bids), size(asks)}
+  std::pair<size_t, size_t> size() const { return {std::size(bids_), std::size(asks_)}; }
+
+  bool empty() const { return std::empty(bids_) && std::empty(asks_); }
+
+  // note! hot path
+  Level const *best(Side side) const {
+    auto &levels = get_levels(side);
+    return std::empty(levels) ? nullptr : &levels.back();
+  }
+
+  Layer top_of_book() const {
+    Layer result;
+    if (!std::empty(bids_)) {
+      result.bid_price = bids_.back().price;
+      result.bid_quantity = bids_.back().quantity;
+    }
+    if (!std::empty(asks_)) {
+      result.ask_price = asks_.back().price;
+      result.ask_quantity = asks_.back().quantity;
+    }
+    return result;
+  }
+
+  // best first
+  template <typename Callback>
+  void for_each(Side side, Callback callback) const {
+    auto &levels = get_levels(side);
+    for (auto iter = std::rbegin(levels); iter != std::rend(levels); ++iter)
+      callback(*iter);
+  }
+
+  // note! same semantics as MarketByPrice::compute_vwap, the quantities are what is available (up to total_quantity)
+  Layer compute_vwap(double total_quantity) const {
+    Layer result;
+    std::tie(result.bid_price, result.bid_quantity) = compute_vwap(bids_, total_quantity);
+    std::tie(result.ask_price, result.ask_quantity) = compute_vwap(asks_, total_quantity);
+    return result;
+  }
+
+  // returns false if the venue is unknown
+  bool operator()(Event<MarketByPriceUpdate> const &event) {
+    auto &market_by_price_update = event.value;
+    auto venue = find_venue(market_by_price_update.exchange, market_by_price_update.symbol);
+    if (venue == NOT_FOUND)
+      return false;
+    if (utils::is_snapshot(market_by_price_update.update_type))
+      clear(venue);
+    for (auto &item : market_by_price_update.bids)
+      update(Side::BUY, venue, item.price, item.quantity);
+    for (auto &item : market_by_price_update.asks)
+      update(Side::SELL, venue, item.price, item.quantity);
+    if (market_by_price_update.max_depth != 0)
+      trim(venue, market_by_price_update.max_depth);
+    return true;
+  }
+
+  // note! quantity == 0 means remove
+  // note! returns false if the price is not on the common tick grid (ignored)
+  bool update(Side side, size_t venue, double price, double quantity) {
+    auto value = price * inverse_tick_size_;
+    if (!is_on_grid(value)) [[unlikely]] {
+      ++rejected_;
+      return false;
+    }
+    auto ticks = std::llround(value);
+    auto mask = uint32_t{1} << venue;
+    auto &levels = get_levels(side);
+    auto iter = side == Side::BUY ? find_level(levels, ticks, std::less{}) : find_level(levels, ticks, std::greater{});
+    auto remove = !(quantity > 0.0);
+    if (iter == std::end(levels) || (*iter).ticks != ticks) {
+      if (remove)
+        return true;
+      iter = levels.emplace(iter);
+      (*iter).ticks = ticks;
+      (*iter).price = static_cast<double>(ticks * tick_units_) / price_scale_;
+    }
+    auto &level = *iter;
+    if (remove) {
+      level.quantities[venue] = 0.0;
+      level.venues &= ~mask;
+      if (level.venues == 0) {
+        levels.erase(iter);
+        return true;
+      }
+    } else {
+      level.quantities[venue] = quantity;
+      level.venues |= mask;
+    }
+    update_quantity(level);
+    return true;
+  }
+
+  // remove all levels of a venue
+  void clear(size_t venue) {
+    auto mask = uint32_t{1} << venue;
+    auto helper = [&](auto &levels) {
+      for (auto &level : levels) {
+        if (!(level.venues & mask))
+          continue;
+        level.venues &= ~mask;
+        level.quantities[venue] = 0.0;
+        update_quantity(level);
+      }
+      std::erase_if(levels, [](auto &level) { return level.venues == 0; });
+    };
+    helper(bids_);
+    helper(asks_);
+  }
+
+  // remove the levels of a venue beyond max_depth (of that venue)
+  void trim(size_t venue, size_t max_depth) {
+    auto mask = uint32_t{1} << venue;
+    auto helper = [&](auto &levels) {
+      size_t depth = 0;
+      auto erase = false;
+      for (auto iter = std::rbegin(levels); iter != std::rend(levels); ++iter) {
+        auto &level = *iter;
+        if (!(level.venues & mask) || ++depth <= max_depth)
+          continue;
+        level.venues &= ~mask;
+        level.quantities[venue] = 0.0;
+        update_quantity(level);
+        erase |= level.venues == 0;
+      }
+      if (erase)
+        std::erase_if(levels, [](auto &level) { return level.venues == 0; });
+    };
+    helper(bids_);
+    helper(asks_);
+  }
+
+  void clear() {
+    bids_.clear();
+    asks_.clear();
+  }
+
+ protected:
+  struct Venue final {
+    Exchange exchange;
+    Symbol symbol;
+  };
+
+  // note! rounding noise is accepted, anything else would alias (two prices to one tick)
+  static bool is_on_grid(double ticks) {
+    return std::fabs(ticks - std::nearbyint(ticks)) <= ReferenceDataCache::TOLERANCE;
+  }
+
+  template <typename Compare>
+  static std::vector<Level>::iterator find_level(std::vector<Level> &levels, int64_t ticks, Compare compare) {
+    auto helper = [&](auto &level, auto value) { return compare(level.ticks, value); };
+    return std::lower_bound(std::begin(levels), std::end(levels), ticks, helper);
+  }
+
+  // note! recomputed (no accumulated rounding errors)
+  static void update_quantity(Level &level) {
+    level.quantity = 0.0;
+    for (auto quantity : level.quantities)
+      level.quantity += quantity;
+  }
+
+  std::vector<Level> const &get_levels(Side side) const { return side == Side::BUY ? bids_ : asks_; }
+  std::vector<Level> &get_levels(Side side) { return side == Side::BUY ? bids_ : asks_; }
+
+  static std::pair<double, double> compute_vwap(std::vector<Level> const &levels, double total_quantity) {
+    auto quantity = 0.0, notional = 0.0;
+    for (auto iter = std::rbegin(levels); iter != std::rend(levels) && quantity < total_quantity; ++iter) {
+      auto tmp = std::min((*iter).quantity, total_quantity - quantity);
+      quantity += tmp;
+      notional += tmp * (*iter).price;
+    }
+    if (quantity > 0.0)
+      return {notional / quantity, quantity};
+    return {NaN, 0.0};
+  }
+
+ private:
+  double const tick_size_;
+  double const inverse_tick_size_;
+  Precision const price_precision_;
+  double price_scale_ = 1.0;
+  int64_t tick_units_ = {};
+  std::vector<Venue> venues_;
+  std::vector<Level> bids_;  // note! ascending, best last
+  std::vector<Level> asks_;  // note! descending, best last
+  size_t rejected_ = {};
+};
+
+}  // namespace cache
+}  // namespace roq
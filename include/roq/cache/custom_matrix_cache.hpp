@@ -0,0 +1,358 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/exceptions.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/custom_matrix.hpp"
+#include "roq/custom_matrix_update.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace cache {
+
+// dense matrices keyed by (label, account, exchange, symbol)
+// - row-major storage, rows and columns are indexed by key (lookup is a hash and a compare)
+// - element-wise operations are simple loops over contiguous storage (written to be auto-vectorized)
+// - publication is either the full matrix (SNAPSHOT) or a delta (INCREMENTAL) limited to the rows and columns
+//   having changed cells since the last publication (cells are compared against the published copy)
+// - updates (CustomMatrix or CustomMatrixUpdate) can be SNAPSHOT or INCREMENTAL, unknown keys will extend the matrix
+// note! pointers to Matrix are invalidated when a new matrix is added
+
+struct CustomMatrixCache final {
+  struct Matrix final {
+    Matrix() = default;
+
+    Matrix(Matrix &&) = default;
+    Matrix(Matrix const &) = delete;
+
+    Matrix &operator=(Matrix &&) = default;
+
+    std::string_view label() const { return label_; }
+    std::string_view account() const { return account_; }
+    std::string_view exchange() const { return exchange_; }
+    std::string_view symbol() const { return symbol_; }
+
+    uint32_t version() const { return version_; }
+
+    std::span<MatrixKey const> rows() const { return rows_; }
+    std::span<MatrixKey const> columns() const { return columns_; }
+
+    // row-major
+    std::span<double const> data() const { return data_; }
+    std::span<double> data() { return data_; }
+
+    size_t row_index(std::string_view const &key) const { return find(rows_, rows_lookup_, key); }
+    size_t column_index(std::string_view const &key) const { return find(columns_, columns_lookup_, key); }
+
+    double operator()(size_t row, size_t column) const { return data_[row * std::size(columns_) + column]; }
+    double &operator()(size_t row, size_t column) { return data_[row * std::size(columns_) + column]; }
+
+    // returns NaN if either key is unknown
+    double get(std::string_view const &row, std::string_view const &column) const {
+      auto i = row_index(row);
+      auto j = column_index(column);
+      if (i == NOT_FOUND || j == NOT_FOUND)
+        return NaN;
+      return (*this)(i, j);
+    }
+
+    // note! existing cells are preserved (matched by key)
+    void reset(std::span<MatrixKey const> const &rows, std::span<MatrixKey const> const &columns) {
+      std::vector<double> data(std::size(rows) * std::size(columns), NaN);
+      for (size_t i = 0; i < std::size(rows); ++i) {
+        auto row = row_index(rows[i]);
+        if (row == NOT_FOUND)
+          continue;
+        for (size_t j = 0; j < std::size(columns); ++j) {
+          auto column = column_index(columns[j]);
+          if (column != NOT_FOUND)
+            data[i * std::size(columns) + j] = (*this)(row, column);
+        }
+      }
+      assign(rows_, rows_lookup_, rows);
+      assign(columns_, columns_lookup_, columns);
+      data_.swap(data);
+      // note! a change of shape requires a full publication
+      published_.clear();
+    }
+
+    // element-wise operations
+
+    void fill(double value) { std::fill(std::begin(data_), std::end(data_), value); }
+
+    void scale(double factor) {
+      auto data = std::data(data_);
+      for (size_t i = 0, size = std::size(data_); i < size; ++i)
+        data[i] *= factor;
+    }
+
+    void add(std::span<double const> const &other) { apply(other, [](auto lhs, auto rhs) { return lhs + rhs; }); }
+
+    void subtract(std::span<double const> const &other) {
+      apply(other, [](auto lhs, auto rhs) { return lhs - rhs; });
+    }
+
+    // hadamard product
+    void multiply(std::span<double const> const &other) {
+      apply(other, [](auto lhs, auto rhs) { return lhs * rhs; });
+    }
+
+    // this = alpha * other + this
+    void axpy(double alpha, std::span<double const> const &other) {
+      apply(other, [alpha](auto lhs, auto rhs) { return alpha * rhs + lhs; });
+    }
+
+    // this = alpha * other + (1 - alpha) * this
+    void ema(double alpha, std::span<double const> const &other) {
+      apply(other, [alpha](auto lhs, auto rhs) { return alpha * rhs + (1.0 - alpha) * lhs; });
+    }
+
+    // publication
+
+    // returns false if there was nothing to publish (callback is not called)
+    template <typename Callback>
+    bool publish(bool delta, Callback callback) {
+      auto incremental = delta && std::size(published_) == std::size(data_);
+      if (incremental) {
+        auto columns = std::size(columns_);
+        changed_rows_.assign(std::size(rows_), false);
+        changed_columns_.assign(columns, false);
+        auto any = false;
+        for (size_t i = 0; i < std::size(rows_); ++i) {
+          for (size_t j = 0; j < columns; ++j) {
+            auto index = i * columns + j;
+            // note! NaN is considered equal to NaN
+            auto lhs = data_[index], rhs = published_[index];
+            if (lhs == rhs || (std::isnan(lhs) && std::isnan(rhs)))
+              continue;
+            changed_rows_[i] = true;
+            changed_columns_[j] = true;
+            any = true;
+          }
+        }
+        if (!any)
+          return false;
+        row_keys_.clear();
+        column_keys_.clear();
+        buffer_.clear();
+        for (size_t i = 0; i < std::size(rows_); ++i)
+          if (changed_rows_[i])
+            row_keys_.emplace_back(rows_[i]);
+        for (size_t j = 0; j < columns; ++j)
+          if (changed_columns_[j])
+            column_keys_.emplace_back(columns_[j]);
+        for (size_t i = 0; i < std::size(rows_); ++i) {
+          if (!changed_rows_[i])
+            continue;
+          for (size_t j = 0; j < columns; ++j)
+            if (changed_columns_[j])
+              buffer_.emplace_back((*this)(i, j));
+        }
+      }
+      ++version_;
+      CustomMatrix custom_matrix{
+          .label = label_,
+          .account = account_,
+          .exchange = exchange_,
+          .symbol = symbol_,
+          .rows = incremental ? std::span<MatrixKey const>{row_keys_} : std::span<MatrixKey const>{rows_},
+          .columns = incremental ? std::span<MatrixKey const>{column_keys_} : std::span<MatrixKey const>{columns_},
+          .data = incremental ? std::span<double const>{buffer_} : std::span<double const>{data_},
+          .update_type = incremental ? UpdateType::INCREMENTAL : UpdateType::SNAPSHOT,
+          .version = version_,
+      };
+      callback(custom_matrix);
+      published_.assign(std::begin(data_), std::end(data_));
+      return true;
+    }
+
+    // updates
+
+    template <typename T>
+    void operator()(T const &value) {
+      using namespace std::literals;
+      if (std::size(value.data) != (std::size(value.rows) * std::size(value.columns))) [[unlikely]]
+        throw InvalidArgument{"data does not match the size of rows and columns"sv};
+      if (utils::is_snapshot(value.update_type)) {
+        assign(rows_, rows_lookup_, value.rows);
+        assign(columns_, columns_lookup_, value.columns);
+        data_.assign(std::begin(value.data), std::end(value.data));
+        published_.clear();
+      } else {
+        extend(value.rows, value.columns);
+        auto columns = std::size(value.columns);
+        column_indices_.resize(columns);
+        for (size_t j = 0; j < columns; ++j)
+          column_indices_[j] = column_index(value.columns[j]);
+        for (size_t i = 0; i < std::size(value.rows); ++i) {
+          auto offset = row_index(value.rows[i]) * std::size(columns_);
+          auto source = std::data(value.data) + i * columns;
+          for (size_t j = 0; j < columns; ++j)
+            data_[offset + column_indices_[j]] = source[j];
+        }
+      }
+      version_ = value.version;
+    }
+
+   protected:
+    friend struct CustomMatrixCache;
+
+    static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+    static size_t find(
+        std::vector<MatrixKey> const &keys, utils::HashIndex const &lookup, std::string_view const &key) {
+      return lookup.find(utils::hash_all(key), [&](auto index) { return keys[index] == key; });
+    }
+
+    static void insert(std::vector<MatrixKey> &keys, utils::HashIndex &lookup, std::string_view const &key) {
+      lookup.insert(utils::hash_all(key), std::size(keys));
+      keys.emplace_back(key);
+    }
+
+    // note! values may refer to keys (e.g. matrix.reset(matrix.rows(), ...))
+    static void assign(
+        std::vector<MatrixKey> &keys, utils::HashIndex &lookup, std::span<MatrixKey const> const &values) {
+      std::vector<MatrixKey> result;
+      result.reserve(std::size(values));
+      lookup.clear();
+      for (auto &key : values)
+        insert(result, lookup, key);
+      keys.swap(result);
+    }
+
+    void extend(std::span<MatrixKey const> const &rows, std::span<MatrixKey const> const &columns) {
+      auto missing = [](auto &keys, auto &lookup, auto &values) {
+        for (auto &key : values)
+          if (find(keys, lookup, key) == NOT_FOUND)
+            return true;
+        return false;
+      };
+      if (!missing(rows_, rows_lookup_, rows) && !missing(columns_, columns_lookup_, columns))
+        return;
+      auto rows_2 = rows_;
+      for (auto &key : rows)
+        if (row_index(key) == NOT_FOUND && std::find(std::begin(rows_2), std::end(rows_2), key) == std::end(rows_2))
+          rows_2.emplace_back(key);
+      auto columns_2 = columns_;
+      for (auto &key : columns)
+        if (column_index(key) == NOT_FOUND &&
+            std::find(std::begin(columns_2), std::end(columns_2), key) == std::end(columns_2))
+          columns_2.emplace_back(key);
+      reset(rows_2, columns_2);
+    }
+
+    template <typename F>
+    void apply(std::span<double const> const &other, F f) {
+      using namespace std::literals;
+      if (std::size(other) != std::size(data_)) [[unlikely]]
+        throw InvalidArgument{"size mismatch"sv};
+      auto lhs = std::data(data_);
+      auto rhs = std::data(other);
+      for (size_t i = 0, size = std::size(data_); i < size; ++i)
+        lhs[i] = f(lhs[i], rhs[i]);
+    }
+
+   private:
+    Label label_;
+    Account account_;
+    Exchange exchange_;
+    Symbol symbol_;
+    uint32_t version_ = {};
+    std::vector<MatrixKey> rows_;
+    utils::HashIndex rows_lookup_;
+    std::vector<MatrixKey> columns_;
+    utils::HashIndex columns_lookup_;
+    std::vector<double> data_;
+    std::vector<double> published_;
+    // note! buffers (re-used)
+    std::vector<size_t> column_indices_;
+    std::vector<bool> changed_rows_;
+    std::vector<bool> changed_columns_;
+    std::vector<MatrixKey> row_keys_;
+    std::vector<MatrixKey> column_keys_;
+    std::vector<double> buffer_;
+  };
+
+  CustomMatrixCache() = default;
+
+  CustomMatrixCache(CustomMatrixCache &&) = default;
+  CustomMatrixCache(CustomMatrixCache const &) = delete;
+
+  size_t size() const { return std::size(matrices_); }
+
+  bool empty() const { return std::empty(matrices_); }
+
+  Matrix const *find(
+      std::string_view const &label,
+      std::string_view const &account = {},
+      std::string_view const &exchange = {},
+      std::string_view const &symbol = {}) const {
+    auto index = lookup_.find(utils::hash_all(label, account, exchange, symbol), [&](auto index) {
+      return is_match(matrices_[index], label, account, exchange, symbol);
+    });
+    return index == utils::HashIndex::NOT_FOUND ? nullptr : &matrices_[index];
+  }
+
+  Matrix &get(
+      std::string_view const &label,
+      std::string_view const &account = {},
+      std::string_view const &exchange = {},
+      std::string_view const &symbol = {}) {
+    auto create = [&]() {
+      auto index = std::size(matrices_);
+      auto &matrix = matrices_.emplace_back();
+      matrix.label_ = label;
+      matrix.account_ = account;
+      matrix.exchange_ = exchange;
+      matrix.symbol_ = symbol;
+      return index;
+    };
+    auto index = lookup_.get(
+        utils::hash_all(label, account, exchange, symbol),
+        [&](auto index) { return is_match(matrices_[index], label, account, exchange, symbol); },
+        create);
+    return matrices_[index];
+  }
+
+  Matrix const &operator()(CustomMatrix const &custom_matrix) { return update(custom_matrix); }
+
+  Matrix const &operator()(Event<CustomMatrixUpdate> const &event) { return update(event.value); }
+
+ protected:
+  template <typename T>
+  Matrix &update(T const &value) {
+    auto &matrix = get(value.label, value.account, value.exchange, value.symbol);
+    matrix(value);
+    return matrix;
+  }
+
+  static bool is_match(
+      Matrix const &matrix,
+      std::string_view const &label,
+      std::string_view const &account,
+      std::string_view const &exchange,
+      std::string_view const &symbol) {
+    return matrix.label_ == label && matrix.account_ == account && matrix.exchange_ == exchange &&
+           matrix.symbol_ == symbol;
+  }
+
+ private:
+  std::vector<Matrix> matrices_;
+  utils::HashIndex lookup_;
+};
+
+}  // namespace cache
+}  // namespace roq
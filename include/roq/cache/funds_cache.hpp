@@ -0,0 +1,265 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <cmath>
+#include <string_view>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/funds_update.hpp"
+#include "roq/reference_data.hpp"
+#include "roq/top_of_book.hpp"
+
+#include "roq/utils/compare.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+#include "roq/utils/update.hpp"
+
+namespace roq {
+namespace cache {
+
+// funds per (account, currency, margin_mode) with a total (available = balance - hold) converted to a base currency
+// - the total is maintained incrementally on each FundsUpdate and on each TopOfBook for a conversion instrument
+// - conversion instruments are discovered from ReferenceData (base_currency/quote_currency), both directions
+// - funds without a known conversion rate are excluded from the total and counted as missing
+// note! use refresh() to recompute all totals from scratch (e.g. to reset accumulated rounding errors)
+
+struct FundsCache final {
+  struct Funds final {
+    Account account;
+    Currency currency;
+    MarginMode margin_mode = {};
+    double balance = NaN;
+    double hold = NaN;
+
+    double available() const { return balance - (std::isnan(hold) ? 0.0 : hold); }
+  };
+
+  struct Total final {
+    Account account;
+    MarginMode margin_mode = {};
+    double available = 0.0;  // base currency
+    size_t missing = {};     // number of funds without conversion rate
+
+    bool is_complete() const { return missing == 0; }
+  };
+
+  explicit FundsCache(std::string_view const &base_currency) : base_currency_{base_currency} {
+    // note! the base currency always converts 1:1
+    auto &currency = currencies_[get_currency(base_currency)];
+    currency.rate = 1.0;
+  }
+
+  FundsCache(FundsCache &&) = default;
+  FundsCache(FundsCache const &) = delete;
+
+  std::string_view base_currency() const { return base_currency_; }
+
+  Funds const *find(
+      std::string_view const &account, std::string_view const &currency, MarginMode margin_mode = {}) const {
+    auto index = funds_lookup_.find(utils::hash_all(account, currency, margin_mode), [&](auto index) {
+      auto &funds = funds_[index].funds;
+      return funds.account == account && funds.currency == currency && funds.margin_mode == margin_mode;
+    });
+    return index == utils::HashIndex::NOT_FOUND ? nullptr : &funds_[index].funds;
+  }
+
+  // note! the pointer is stable until funds for a new (account, margin_mode) are seen
+  Total const *get_total(std::string_view const &account, MarginMode margin_mode = {}) const {
+    auto index = totals_lookup_.find(utils::hash_all(account, margin_mode), [&](auto index) {
+      auto &total = totals_[index];
+      return total.account == account && total.margin_mode == margin_mode;
+    });
+    return index == utils::HashIndex::NOT_FOUND ? nullptr : &totals_[index];
+  }
+
+  // conversion rate (NaN if unknown)
+  double get_rate(std::string_view const &currency) const {
+    auto index = currencies_lookup_.find(utils::hash_all(currency), [&](auto index) {
+      return currencies_[index].name == currency;
+    });
+    return index == utils::HashIndex::NOT_FOUND ? NaN : currencies_[index].rate;
+  }
+
+  Total const *operator()(Event<FundsUpdate> const &event) {
+    auto &funds_update = event.value;
+    auto index = get_funds(funds_update.account, funds_update.currency, funds_update.margin_mode);
+    auto &item = funds_[index];
+    if (!std::isnan(funds_update.balance))
+      item.funds.balance = funds_update.balance;
+    if (!std::isnan(funds_update.hold))
+      item.funds.hold = funds_update.hold;
+    update(item);
+    return &totals_[item.total];
+  }
+
+  void operator()(Event<ReferenceData> const &event) {
+    auto &reference_data = event.value;
+    auto helper = [&](auto &currency, auto inverse) {
+      auto &conversion = conversions_[get_conversion(reference_data.exchange, reference_data.symbol)];
+      conversion.currency = get_currency(currency);
+      conversion.inverse = inverse;
+    };
+    if (reference_data.quote_currency == base_currency_ && !std::empty(reference_data.base_currency))
+      helper(reference_data.base_currency, false);
+    else if (reference_data.base_currency == base_currency_ && !std::empty(reference_data.quote_currency))
+      helper(reference_data.quote_currency, true);
+  }
+
+  void operator()(Event<TopOfBook> const &event) {
+    auto &top_of_book = event.value;
+    auto index = conversions_lookup_.find(utils::hash_all(top_of_book.exchange, top_of_book.symbol), [&](auto index) {
+      auto &conversion = conversions_[index];
+      return conversion.exchange == top_of_book.exchange && conversion.symbol == top_of_book.symbol;
+    });
+    if (index == utils::HashIndex::NOT_FOUND)
+      return;
+    auto &conversion = conversions_[index];
+    auto &layer = top_of_book.layer;
+    if (std::isnan(layer.bid_price) || std::isnan(layer.ask_price))
+      return;
+    auto mid_price = 0.5 * (layer.bid_price + layer.ask_price);
+    if (utils::is_zero(mid_price))
+      return;
+    auto &currency = currencies_[conversion.currency];
+    auto rate = conversion.inverse ? (1.0 / mid_price) : mid_price;
+    if (!utils::update(currency.rate, rate))
+      return;
+    for (auto index : currency.funds)
+      update(funds_[index]);
+  }
+
+  // recompute all totals
+  void refresh() {
+    for (auto &total : totals_) {
+      total.available = 0.0;
+      total.missing = {};
+    }
+    for (auto &item : funds_) {
+      item.contribution = 0.0;
+      item.included = false;
+      auto &total = totals_[item.total];
+      ++total.missing;
+      update(item);
+    }
+  }
+
+ protected:
+  struct Item final {
+    Funds funds;
+    size_t currency = {};
+    size_t total = {};
+    double contribution = 0.0;  // currently included in total
+    bool included = false;
+  };
+
+  struct Rate final {
+    Currency name;
+    double rate = NaN;
+    std::vector<size_t> funds;
+  };
+
+  struct Conversion final {
+    Exchange exchange;
+    Symbol symbol;
+    size_t currency = {};
+    bool inverse = false;
+  };
+
+  void update(Item &item) {
+    auto &total = totals_[item.total];
+    if (item.included)
+      total.available -= item.contribution;
+    else
+      --total.missing;
+    auto contribution = item.funds.available() * currencies_[item.currency].rate;
+    if (std::isnan(contribution)) {
+      item.contribution = 0.0;
+      item.included = false;
+      ++total.missing;
+    } else {
+      item.contribution = contribution;
+      item.included = true;
+      total.available += contribution;
+    }
+  }
+
+  size_t get_funds(std::string_view const &account, std::string_view const &currency, MarginMode margin_mode) {
+    auto is_match = [&](auto index) {
+      auto &funds = funds_[index].funds;
+      return funds.account == account && funds.currency == currency && funds.margin_mode == margin_mode;
+    };
+    auto create = [&]() {
+      auto index = std::size(funds_);
+      auto &item = funds_.emplace_back();
+      item.funds.account = account;
+      item.funds.currency = currency;
+      item.funds.margin_mode = margin_mode;
+      item.currency = get_currency(currency);
+      item.total = get_total_index(account, margin_mode);
+      ++totals_[item.total].missing;
+      currencies_[item.currency].funds.emplace_back(index);
+      return index;
+    };
+    return funds_lookup_.get(utils::hash_all(account, currency, margin_mode), is_match, create);
+  }
+
+  size_t get_total_index(std::string_view const &account, MarginMode margin_mode) {
+    auto is_match = [&](auto index) {
+      auto &total = totals_[index];
+      return total.account == account && total.margin_mode == margin_mode;
+    };
+    auto create = [&]() {
+      auto index = std::size(totals_);
+      auto &total = totals_.emplace_back();
+      total.account = account;
+      total.margin_mode = margin_mode;
+      return index;
+    };
+    return totals_lookup_.get(utils::hash_all(account, margin_mode), is_match, create);
+  }
+
+  size_t get_conversion(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &conversion = conversions_[index];
+      return conversion.exchange == exchange && conversion.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(conversions_);
+      auto &conversion = conversions_.emplace_back();
+      conversion.exchange = exchange;
+      conversion.symbol = symbol;
+      return index;
+    };
+    return conversions_lookup_.get(utils::hash_all(exchange, symbol), is_match, create);
+  }
+
+  size_t get_currency(std::string_view const &currency) {
+    auto is_match = [&](auto index) { return currencies_[index].name == currency; };
+    auto create = [&]() {
+      auto index = std::size(currencies_);
+      auto &tmp = currencies_.emplace_back();
+      tmp.name = currency;
+      return index;
+    };
+    return currencies_lookup_.get(utils::hash_all(currency), is_match, create);
+  }
+
+ private:
+  Currency const base_currency_;
+  std::vector<Item> funds_;
+  utils::HashIndex funds_lookup_;
+  std::vector<Total> totals_;
+  utils::HashIndex totals_lookup_;
+  std::vector<Rate> currencies_;
+  utils::HashIndex currencies_lookup_;
+  std::vector<Conversion> conversions_;
+  utils::HashIndex conversions_lookup_;
+};
+
+}  // namespace cache
+}  // namespace roq
@@ -0,0 +1,624 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/exceptions.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/cancel_order.hpp"
+#include "roq/create_order.hpp"
+#include "roq/modify_order.hpp"
+
+#include "roq/order_ack.hpp"
+#include "roq/order_update.hpp"
+#include "roq/trade_update.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+#include "roq/utils/update.hpp"
+
+#include "roq/tools/fill_deduplicator.hpp"
+
+namespace roq {
+namespace cache {
+
+// order state indexed by order_id
+// - client order ids are allocated by the client and are (mostly) dense and increasing
+// - storage is a power-of-two slab addressed by (order_id & mask), i.e. lookup is a single load
+// - the source (gateway) is recorded per order
+// - slots holding completed orders are recycled when a new order maps to the same slot
+// - storage will double (and re-index) if a new order maps to a slot holding a working order
+// - storage is capped (max_capacity), orders which can not be placed are kept in an overflow hash map
+// - fills are de-duplicated using external_trade_id (time-bounded, see tools::FillDeduplicator)
+// - secondary indexes over working orders (intrusive doubly-linked lists using order_id as link):
+//   - (account, exchange, symbol, side) sorted by price, best first (market orders before limit orders), time priority
+//     within a price level
+//   - price levels are kept in a sorted vector per (account, exchange, symbol, side), i.e. (re-)linking an order is a
+//     binary search over the price levels (not a walk over the orders) plus a contiguous move when a level is added
+//     or removed
+//   - strategy_id
+//   - routing_id
+// note! pointers returned by this class are invalidated by any call which may add an order
+// note! callbacks must not modify the cache
+
+struct OrderCache final {
+  struct Order final {
+    uint64_t order_id = {};
+    uint8_t source = {};
+    Account account;
+    Exchange exchange;
+    Symbol symbol;
+    Side side = {};
+    PositionEffect position_effect = {};
+    MarginMode margin_mode = {};
+    OrderType order_type = {};
+    TimeInForce time_in_force = {};
+    OrderStatus order_status = {};
+    RequestStatus request_status = {};  // last ack
+    double quantity = NaN;
+    double price = NaN;
+    double stop_price = NaN;
+    double remaining_quantity = NaN;
+    double traded_quantity = NaN;
+    double average_traded_price = NaN;
+    double filled_quantity = 0.0;  // sum of (unique) fills received by TradeUpdate
+    RoutingId routing_id;
+    uint32_t strategy_id = {};
+    uint32_t max_request_version = {};
+    uint32_t max_response_version = {};
+    uint32_t max_accepted_version = {};
+    std::chrono::nanoseconds create_time_utc = {};
+    std::chrono::nanoseconds update_time_utc = {};
+
+    // note! internal (secondary indexes)
+    struct Link final {
+      uint64_t prev = {};
+      uint64_t next = {};
+    };
+    Link by_instrument;
+    Link by_strategy;
+    Link by_routing_id;
+    uint32_t instrument_bucket = {};
+    uint32_t routing_id_bucket = {};
+
+    bool is_complete() const { return utils::is_order_complete(order_status); }
+
+    // note! request in flight (waiting for a response)
+    bool has_pending_request() const { return max_response_version < max_request_version; }
+  };
+
+  explicit OrderCache(
+      size_t capacity = 1024,
+      size_t max_capacity = 1 << 20,
+      tools::FillDeduplicator::Config const &fill_deduplicator = {})
+      : orders_(std::bit_ceil(std::max<size_t>(capacity, 2))),
+        max_capacity_{std::max(std::bit_ceil(std::max<size_t>(max_capacity, 2)), std::size(orders_))},
+        fill_deduplicator_{fill_deduplicator} {
+    mask_ = std::size(orders_) - 1;
+    strategies_.reserve(64);
+  }
+
+  OrderCache(OrderCache &&) = default;
+  OrderCache(OrderCache const &) = delete;
+
+  // number of working orders
+  size_t size() const { return working_; }
+
+  bool empty() const { return working_ == 0; }
+
+  // current storage size
+  size_t capacity() const { return std::size(orders_); }
+
+  // number of orders held by the overflow hash map
+  size_t overflow() const { return std::size(overflow_); }
+
+  void clear() {
+    for (auto &order : orders_)
+      order = {};
+    overflow_.clear();
+    overflow_complete_ = {};
+    for (auto &bucket : instruments_) {
+      bucket.head = {};
+      bucket.levels.clear();
+    }
+    for (auto &bucket : routing_ids_)
+      bucket.head = {};
+    for (auto &[_, head] : strategies_)
+      head = {};
+    working_ = {};
+    fill_deduplicator_.clear();
+  }
+
+  // returns nullptr if the order is unknown or the slot has since been recycled
+  Order const *find(uint64_t order_id) const {
+    auto &order = orders_[order_id & mask_];
+    if (order.order_id == order_id && order_id != 0) [[likely]]
+      return &order;
+    if (std::empty(overflow_)) [[likely]]
+      return nullptr;
+    auto iter = overflow_.find(order_id);
+    return iter == std::end(overflow_) ? nullptr : &(*iter).second;
+  }
+
+  // visit all working orders
+  template <typename Callback>
+  void for_each(Callback callback) const {
+    for (auto &order : orders_)
+      if (order.order_id != 0 && !order.is_complete())
+        callback(order);
+    for (auto &[_, order] : overflow_)
+      if (!order.is_complete())
+        callback(order);
+  }
+
+  // visit working orders for (account, exchange, symbol, side) in price order, best first
+  template <typename Callback>
+  void for_each(
+      std::string_view const &account,
+      std::string_view const &exchange,
+      std::string_view const &symbol,
+      Side side,
+      Callback callback) const {
+    auto index = find_instrument_bucket(account, exchange, symbol, side);
+    if (index == NOT_FOUND)
+      return;
+    for_each_helper(instruments_[index].head, &Order::by_instrument, callback);
+  }
+
+  // visit working orders for strategy_id
+  template <typename Callback>
+  void for_each_strategy(uint32_t strategy_id, Callback callback) const {
+    auto iter = strategies_.find(strategy_id);
+    if (iter == std::end(strategies_))
+      return;
+    for_each_helper((*iter).second, &Order::by_strategy, callback);
+  }
+
+  // visit working orders for routing_id
+  template <typename Callback>
+  void for_each_routing_id(std::string_view const &routing_id, Callback callback) const {
+    auto index = find_routing_id_bucket(routing_id);
+    if (index == NOT_FOUND)
+      return;
+    for_each_helper(routing_ids_[index].head, &Order::by_routing_id, callback);
+  }
+
+  // requests (from client)
+
+  Order const *operator()(CreateOrder const &create_order, uint8_t source, std::chrono::nanoseconds now = {}) {
+    auto &order = insert(create_order.order_id);
+    order.source = source;
+    order.account = create_order.account;
+    order.exchange = create_order.exchange;
+    order.symbol = create_order.symbol;
+    order.side = create_order.side;
+    order.position_effect = create_order.position_effect;
+    order.margin_mode = create_order.margin_mode;
+    order.order_type = create_order.order_type;
+    order.time_in_force = create_order.time_in_force;
+    order.order_status = OrderStatus::SENT;
+    order.request_status = RequestStatus::FORWARDED;
+    order.quantity = create_order.quantity;
+    order.price = create_order.price;
+    order.stop_price = create_order.stop_price;
+    order.remaining_quantity = create_order.quantity;
+    order.routing_id = create_order.routing_id;
+    order.strategy_id = create_order.strategy_id;
+    order.max_request_version = 1;
+    order.create_time_utc = now;
+    order.update_time_utc = now;
+    link(order);
+    return &order;
+  }
+
+  Order const *operator()(ModifyOrder const &modify_order) {
+    auto order = find_helper(modify_order.order_id);
+    if (order)
+      utils::update_max(order->max_request_version, modify_order.version);
+    return order;
+  }
+
+  Order const *operator()(CancelOrder const &cancel_order) {
+    auto order = find_helper(cancel_order.order_id);
+    if (order)
+      utils::update_max(order->max_request_version, cancel_order.version);
+    return order;
+  }
+
+  // responses (from gateway)
+
+  Order const *operator()(Event<OrderAck> const &event) {
+    auto &order_ack = event.value;
+    auto order = find_helper(order_ack.order_id);
+    if (!order)
+      return nullptr;
+    order->request_status = order_ack.request_status;
+    if (utils::has_request_maybe_completed(order_ack.request_status))
+      utils::update_max(order->max_response_version, order_ack.version);
+    if (order_ack.request_status == RequestStatus::ACCEPTED)
+      utils::update_max(order->max_accepted_version, order_ack.version);
+    // note! a rejected create request will never be followed by an order update
+    if (order_ack.request_type == RequestType::CREATE_ORDER && utils::has_request_failed(order_ack.request_status))
+      update_order_status(*order, OrderStatus::REJECTED);
+    return order;
+  }
+
+  // note! orders not previously seen (e.g. download) will be added
+  Order const *operator()(Event<OrderUpdate> const &event) {
+    auto &order_update = event.value;
+    auto order = find_helper(order_update.order_id);
+    if (!order) {
+      if (utils::is_order_complete(order_update.order_status) && !utils::is_snapshot(order_update.update_type))
+        return nullptr;
+      order = &insert(order_update.order_id);
+      order->source = event.message_info.source;
+      order->account = order_update.account;
+      order->exchange = order_update.exchange;
+      order->symbol = order_update.symbol;
+      order->side = order_update.side;
+      order->position_effect = order_update.position_effect;
+      order->margin_mode = order_update.margin_mode;
+      order->order_type = order_update.order_type;
+      order->time_in_force = order_update.time_in_force;
+      order->order_status = OrderStatus::SENT;
+      order->routing_id = order_update.routing_id;
+      order->strategy_id = order_update.strategy_id;
+      order->create_time_utc = order_update.create_time_utc;
+      order->price = order_update.price;
+      link(*order);
+    }
+    utils::update(order->quantity, order_update.quantity);
+    auto price = order->price;
+    if (utils::update(order->price, order_update.price) && !order->is_complete())
+      relink_instrument(*order, price);
+    utils::update(order->stop_price, order_update.stop_price);
+    utils::update(order->remaining_quantity, order_update.remaining_quantity);
+    utils::update(order->traded_quantity, order_update.traded_quantity);
+    utils::update(order->average_traded_price, order_update.average_traded_price);
+    utils::update_max(order->max_request_version, order_update.max_request_version);
+    utils::update_max(order->max_response_version, order_update.max_response_version);
+    utils::update_max(order->max_accepted_version, order_update.max_accepted_version);
+    utils::update_max(order->update_time_utc, order_update.update_time_utc);
+    update_order_status(*order, order_update.order_status);
+    return order;
+  }
+
+  Order const *operator()(Event<TradeUpdate> const &event) {
+    auto &trade_update = event.value;
+    auto order = find_helper(trade_update.order_id);
+    if (!order)
+      return nullptr;
+    for (auto &fill : trade_update.fills) {
+      if (std::isnan(fill.quantity))
+        continue;
+      // note! replayed fills (e.g. after reconnect or download) must not be counted twice
+      if (!std::empty(fill.external_trade_id) && !fill_deduplicator_(trade_update.exchange, trade_update.symbol, fill))
+        continue;
+      order->filled_quantity += fill.quantity;
+    }
+    utils::update_max(order->update_time_utc, trade_update.update_time_utc);
+    return order;
+  }
+
+ protected:
+  static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+  struct Level final {
+    double price = NaN;
+    uint64_t tail = {};  // note! last order (time priority) at this price
+  };
+
+  struct InstrumentBucket final {
+    Account account;
+    Exchange exchange;
+    Symbol symbol;
+    Side side = {};
+    uint64_t head = {};
+    std::vector<Level> levels;  // note! best first
+  };
+
+  struct RoutingIdBucket final {
+    RoutingId routing_id;
+    uint64_t head = {};
+  };
+
+  Order *find_helper(uint64_t order_id) {
+    return const_cast<Order *>(std::as_const(*this).find(order_id));
+  }
+
+  Order &insert(uint64_t order_id) {
+    using namespace std::literals;
+    if (order_id == 0) [[unlikely]]
+      throw InvalidArgument{"order_id must be non-zero"sv};
+    auto existing = find_helper(order_id);
+    if (existing && !(*existing).is_complete()) {
+      unlink(*existing);
+      --working_;
+    } else if (existing && is_overflow(*existing)) {
+      --overflow_complete_;
+    }
+    auto &order = existing ? *existing : get_free_slot(order_id);
+    order = {};
+    order.order_id = order_id;
+    ++working_;
+    return order;
+  }
+
+  Order &get_free_slot(uint64_t order_id) {
+    for (;;) {
+      auto &order = orders_[order_id & mask_];
+      if (order.order_id == 0 || order.is_complete()) [[likely]]
+        return order;
+      if (std::size(orders_) >= max_capacity_)
+        break;
+      grow();
+    }
+    // note! completed orders are purged from the overflow once they account for half of it (amortized O(1))
+    if (2 * overflow_complete_ >= std::size(overflow_)) {
+      std::erase_if(overflow_, [](auto &item) { return item.second.is_complete(); });
+      overflow_complete_ = {};
+    }
+    return overflow_[order_id];
+  }
+
+  bool is_overflow(Order const &order) const { return &orders_[order.order_id & mask_] != &order; }
+
+  void update_order_status(Order &order, OrderStatus order_status) {
+    if (order_status == OrderStatus::UNDEFINED)
+      return;
+    auto was_complete = order.is_complete();
+    // note! a final status is never reverted
+    if (was_complete)
+      return;
+    order.order_status = order_status;
+    if (order.is_complete()) {
+      unlink(order);
+      --working_;
+      if (is_overflow(order))
+        ++overflow_complete_;
+    }
+  }
+
+  // note! only working orders are carried over
+  // note! at max_capacity, working orders which can not be placed are moved to the overflow
+  void grow() {
+    auto size = std::size(orders_);
+    while (size < max_capacity_) {
+      size *= 2;
+      std::vector<Order> orders(size);
+      auto mask = size - 1;
+      auto last = size >= max_capacity_;
+      auto ok = true;
+      for (auto &order : orders_) {
+        if (order.order_id == 0 || order.is_complete())
+          continue;
+        auto &tmp = orders[order.order_id & mask];
+        if (tmp.order_id != 0) {
+          if (!last) {
+            ok = false;
+            break;
+          }
+          overflow_.emplace(order.order_id, order);
+          continue;
+        }
+        tmp = order;
+      }
+      if (ok) {
+        orders_.swap(orders);
+        mask_ = mask;
+        break;
+      }
+    }
+    // note! try to move orders back from the overflow
+    std::erase_if(overflow_, [&](auto &item) {
+      auto &[order_id, order] = item;
+      if (order.is_complete())
+        return true;
+      auto &tmp = orders_[order_id & mask_];
+      if (tmp.order_id != 0)
+        return false;
+      tmp = order;
+      return true;
+    });
+    overflow_complete_ = {};
+  }
+
+  // secondary indexes
+
+  template <typename Callback>
+  void for_each_helper(uint64_t order_id, Order::Link Order::*link, Callback &callback) const {
+    while (order_id != 0) {
+      auto order = find(order_id);
+      auto next = (order->*link).next;
+      callback(*order);
+      order_id = next;
+    }
+  }
+
+  // note! market orders (NaN) are better than any limit order
+  static bool is_better(Side side, double lhs, double rhs) {
+    if (std::isnan(lhs))
+      return !std::isnan(rhs);
+    if (std::isnan(rhs))
+      return false;
+    return side == Side::SELL ? lhs < rhs : lhs > rhs;
+  }
+
+  static bool is_same(double lhs, double rhs) { return std::isnan(lhs) ? std::isnan(rhs) : lhs == rhs; }
+
+  // returns the first level not better than price
+  static auto find_level(InstrumentBucket &bucket, double price) {
+    return std::lower_bound(
+        std::begin(bucket.levels), std::end(bucket.levels), price, [&](auto &level, auto price) {
+          return is_better(bucket.side, level.price, price);
+        });
+  }
+
+  void link(Order &order) {
+    order.instrument_bucket = get_instrument_bucket(order.account, order.exchange, order.symbol, order.side);
+    link_instrument(order);
+    // note! entries are never erased, i.e. only the first order for a strategy will allocate
+    auto iter = strategies_.find(order.strategy_id);
+    if (iter == std::end(strategies_)) [[unlikely]]
+      iter = strategies_.try_emplace(order.strategy_id).first;
+    link_front((*iter).second, order, &Order::by_strategy);
+    if (!std::empty(order.routing_id)) {
+      order.routing_id_bucket = get_routing_id_bucket(order.routing_id);
+      link_front(routing_ids_[order.routing_id_bucket].head, order, &Order::by_routing_id);
+    }
+  }
+
+  void unlink(Order &order) {
+    unlink_instrument(order, order.price);
+    auto iter = strategies_.find(order.strategy_id);
+    if (iter != std::end(strategies_))
+      unlink((*iter).second, order, &Order::by_strategy);
+    if (!std::empty(order.routing_id))
+      unlink(routing_ids_[order.routing_id_bucket].head, order, &Order::by_routing_id);
+  }
+
+  // note! price is the price used when the order was linked
+  void relink_instrument(Order &order, double price) {
+    unlink_instrument(order, price);
+    link_instrument(order);
+  }
+
+  // note! insert after the last order of the same price level, otherwise after the last order of a better level
+  void link_instrument(Order &order) {
+    auto &bucket = instruments_[order.instrument_bucket];
+    auto iter = find_level(bucket, order.price);
+    uint64_t prev = {};
+    if (iter != std::end(bucket.levels) && is_same((*iter).price, order.price)) {
+      prev = (*iter).tail;
+      (*iter).tail = order.order_id;
+    } else {
+      if (iter != std::begin(bucket.levels))
+        prev = (*std::prev(iter)).tail;
+      bucket.levels.insert(
+          iter,
+          {
+              .price = order.price,
+              .tail = order.order_id,
+          });
+    }
+    auto next = prev != 0 ? (*find_helper(prev)).by_instrument.next : bucket.head;
+    order.by_instrument = {
+        .prev = prev,
+        .next = next,
+    };
+    if (prev != 0)
+      (*find_helper(prev)).by_instrument.next = order.order_id;
+    else
+      bucket.head = order.order_id;
+    if (next != 0)
+      (*find_helper(next)).by_instrument.prev = order.order_id;
+  }
+
+  void unlink_instrument(Order &order, double price) {
+    auto &bucket = instruments_[order.instrument_bucket];
+    auto iter = find_level(bucket, price);
+    if (iter != std::end(bucket.levels) && (*iter).tail == order.order_id) {
+      auto prev = order.by_instrument.prev;
+      if (prev != 0 && is_same((*find_helper(prev)).price, price))
+        (*iter).tail = prev;
+      else
+        bucket.levels.erase(iter);
+    }
+    unlink(bucket.head, order, &Order::by_instrument);
+  }
+
+  void link_front(uint64_t &head, Order &order, Order::Link Order::*link) {
+    (order.*link) = {
+        .prev = {},
+        .next = head,
+    };
+    if (head != 0)
+      ((*find_helper(head)).*link).prev = order.order_id;
+    head = order.order_id;
+  }
+
+  void unlink(uint64_t &head, Order &order, Order::Link Order::*link) {
+    auto &tmp = order.*link;
+    if (tmp.prev != 0)
+      ((*find_helper(tmp.prev)).*link).next = tmp.next;
+    else if (head == order.order_id)
+      head = tmp.next;
+    if (tmp.next != 0)
+      ((*find_helper(tmp.next)).*link).prev = tmp.prev;
+    tmp = {};
+  }
+
+  size_t find_instrument_bucket(
+      std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol, Side side)
+      const {
+    return instruments_lookup_.find(utils::hash_all(account, exchange, symbol, side), [&](auto index) {
+      auto &bucket = instruments_[index];
+      return bucket.account == account && bucket.exchange == exchange && bucket.symbol == symbol && bucket.side == side;
+    });
+  }
+
+  uint32_t get_instrument_bucket(
+      std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol, Side side) {
+    auto is_match = [&](auto index) {
+      auto &bucket = instruments_[index];
+      return bucket.account == account && bucket.exchange == exchange && bucket.symbol == symbol && bucket.side == side;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &bucket = instruments_.emplace_back();
+      bucket.account = account;
+      bucket.exchange = exchange;
+      bucket.symbol = symbol;
+      bucket.side = side;
+      return index;
+    };
+    auto key = utils::hash_all(account, exchange, symbol, side);
+    return static_cast<uint32_t>(instruments_lookup_.get(key, is_match, create));
+  }
+
+  size_t find_routing_id_bucket(std::string_view const &routing_id) const {
+    return routing_ids_lookup_.find(
+        utils::hash_all(routing_id), [&](auto index) { return routing_ids_[index].routing_id == routing_id; });
+  }
+
+  uint32_t get_routing_id_bucket(std::string_view const &routing_id) {
+    auto is_match = [&](auto index) { return routing_ids_[index].routing_id == routing_id; };
+    auto create = [&]() {
+      auto index = std::size(routing_ids_);
+      auto &bucket = routing_ids_.emplace_back();
+      bucket.routing_id = routing_id;
+      return index;
+    };
+    return static_cast<uint32_t>(routing_ids_lookup_.get(utils::hash_all(routing_id), is_match, create));
+  }
+
+ private:
+  std::vector<Order> orders_;
+  size_t const max_capacity_;
+  size_t mask_ = {};
+  std::unordered_map<uint64_t, Order> overflow_;
+  size_t overflow_complete_ = {};
+  size_t working_ = {};
+  std::vector<InstrumentBucket> instruments_;
+  utils::HashIndex instruments_lookup_;
+  std::unordered_map<uint32_t, uint64_t> strategies_;  // note! head (zero means empty)
+  std::vector<RoutingIdBucket> routing_ids_;
+  utils::HashIndex routing_ids_lookup_;
+  tools::FillDeduplicator fill_deduplicator_;
+};
+
+}  // namespace cache
+}  // namespace roq
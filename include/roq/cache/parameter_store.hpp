@@ -0,0 +1,324 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include "roq/compat.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/parameters_update.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/compare.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace cache {
+
+// typed parameters (T) per (account, exchange, symbol)
+// - labels are bound to members of T (double, int32_t, int64_t or bool)
+// - values are parsed once (when received), values failing to parse are ignored (and counted)
+// - wildcard scoping is resolved when received (the most specific parameter wins)
+//   - specificity: symbol > exchange > account > strategy_id > global
+// - new versions of T are published RCU-style, i.e. reading is a single (acquire) load and a dereference
+// - the dispatching thread (the one applying updates and adding instruments) reads directly, using operator[]
+// - other threads must read through a Reader (create_reader), a Guard announces the epoch being read
+// - previous versions (and instrument tables) are retired with the current epoch and only reclaimed once no guard
+//   announcing that epoch (or an earlier one) remains, i.e. a guard never observes freed memory
+// note! parameters for another (non-zero) strategy_id are ignored
+// note! references obtained through a Guard must not be used after the guard has been destroyed
+// note! the store must outlive its readers, readers are only released when the store is destroyed
+
+template <typename T>
+struct ParameterStore final {
+  using Member = std::variant<double T::*, int32_t T::*, int64_t T::*, bool T::*>;
+
+  // note! not re-entrant, i.e. at most one guard per reader
+  struct Guard final {
+    Guard(Guard &&) = delete;
+    Guard(Guard const &) = delete;
+
+    ~Guard() { epoch_.store(0, std::memory_order_release); }
+
+    // note! the reference is valid until the guard has been destroyed
+    T const &operator[](size_t index) const { return *table_[index]->load(std::memory_order_acquire); }
+
+   private:
+    friend struct ParameterStore;
+
+    Guard(std::atomic<uint64_t> &epoch, std::atomic<T const *> const *const *table) : epoch_{epoch}, table_{table} {}
+
+    std::atomic<uint64_t> &epoch_;
+    std::atomic<T const *> const *const *table_;
+  };
+
+  struct Reader final {
+    Guard lock() const {
+      (*epoch_).store((*store_).epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+      // note! the announced epoch must be visible before the table (and versions) are loaded
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      return Guard{*epoch_, (*store_).table_.load(std::memory_order_acquire)};
+    }
+
+   private:
+    friend struct ParameterStore;
+
+    Reader(ParameterStore const &store, std::atomic<uint64_t> &epoch) : store_{&store}, epoch_{&epoch} {}
+
+    ParameterStore const *store_;
+    std::atomic<uint64_t> *epoch_;
+  };
+
+  explicit ParameterStore(
+      std::initializer_list<std::pair<std::string_view, Member>> bindings, uint32_t strategy_id = {}, T defaults = {})
+      : strategy_id_{strategy_id}, defaults_{std::move(defaults)} {
+    for (auto &[label, member] : bindings)
+      bindings_.emplace_back(label, member);
+  }
+
+  ParameterStore(ParameterStore &&) = delete;
+  ParameterStore(ParameterStore const &) = delete;
+
+  // number of parameters failing to parse
+  size_t errors() const { return errors_; }
+
+  // incremented for each published update
+  uint64_t version() const { return version_; }
+
+  // number of retired versions (and instrument tables) not yet reclaimed
+  size_t retired() const { return std::size(retired_) + std::size(retired_tables_); }
+
+  // note! thread-safe
+  Reader create_reader() {
+    std::lock_guard lock{mutex_};
+    auto &slot = *slots_.emplace_back(std::make_unique<Slot>());
+    return Reader{*this, slot.epoch};
+  }
+
+  // returns an index (stable) used for reading
+  size_t add(std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = *instruments_[index];
+      return instrument.account == account && instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = *instruments_.emplace_back(std::make_unique<Instrument>());
+      instrument.account = account;
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      publish(instrument);
+      // note! readers index a copy (the previous table is retired)
+      Table table{std::begin(table_storage_), std::end(table_storage_)};
+      table.emplace_back(&instrument.current);
+      table_.store(std::data(table), std::memory_order_release);
+      retired_tables_.emplace_back(epoch_.load(std::memory_order_relaxed), std::move(table_storage_));
+      table_storage_ = std::move(table);
+      return index;
+    };
+    auto size = std::size(instruments_);
+    auto result = lookup_.get(utils::hash_all(account, exchange, symbol), is_match, create);
+    if (std::size(instruments_) != size)
+      advance();
+    return result;
+  }
+
+  // note! hot path (dispatching thread only)
+  T const &operator[](size_t index) const { return *(*instruments_[index]).storage; }
+
+  void operator()(Event<ParametersUpdate> const &event) {
+    auto &parameters_update = event.value;
+    if (utils::is_snapshot(parameters_update.update_type))
+      entries_.clear();
+    for (auto &parameter : parameters_update.parameters) {
+      if (parameter.strategy_id != 0 && parameter.strategy_id != strategy_id_)
+        continue;
+      auto binding = find_binding(parameter.label);
+      if (binding == std::size(bindings_))
+        continue;
+      auto value = parse(bindings_[binding].second, parameter.value);
+      if (!value) {
+        ++errors_;
+        continue;
+      }
+      auto iter = std::find_if(std::begin(entries_), std::end(entries_), [&](auto &entry) {
+        return entry.binding == binding && entry.strategy_id == parameter.strategy_id &&
+               entry.account == parameter.account && entry.exchange == parameter.exchange &&
+               entry.symbol == parameter.symbol;
+      });
+      if (iter != std::end(entries_)) {
+        (*iter).value = *value;
+        continue;
+      }
+      entries_.emplace_back(Entry{
+          .binding = binding,
+          .strategy_id = parameter.strategy_id,
+          .account = parameter.account,
+          .exchange = parameter.exchange,
+          .symbol = parameter.symbol,
+          .value = *value,
+      });
+    }
+    // note! apply least specific first
+    std::stable_sort(std::begin(entries_), std::end(entries_), [](auto &lhs, auto &rhs) {
+      return specificity(lhs) < specificity(rhs);
+    });
+    for (auto &instrument : instruments_)
+      publish(*instrument);
+    ++version_;
+    advance();
+  }
+
+ protected:
+  using Value = std::variant<double, int64_t, bool>;
+
+  using Table = std::vector<std::atomic<T const *> const *>;
+
+  struct Slot final {
+    alignas(ROQ_CACHELINE_SIZE) std::atomic<uint64_t> epoch = {};  // note! zero means not reading
+  };
+
+  struct Instrument final {
+    Account account;
+    Exchange exchange;
+    Symbol symbol;
+    std::atomic<T const *> current = {};
+    std::unique_ptr<T> storage;
+  };
+
+  struct Entry final {
+    size_t binding = {};
+    uint32_t strategy_id = {};
+    Account account;
+    Exchange exchange;
+    Symbol symbol;
+    Value value;
+  };
+
+  static int specificity(Entry const &entry) {
+    return (std::empty(entry.symbol) ? 0 : 8) + (std::empty(entry.exchange) ? 0 : 4) +
+           (std::empty(entry.account) ? 0 : 2) + (entry.strategy_id == 0 ? 0 : 1);
+  }
+
+  static bool matches(Entry const &entry, Instrument const &instrument) {
+    return (std::empty(entry.account) || entry.account == instrument.account) &&
+           (std::empty(entry.exchange) || entry.exchange == instrument.exchange) &&
+           (std::empty(entry.symbol) || entry.symbol == instrument.symbol);
+  }
+
+  size_t find_binding(std::string_view const &label) const {
+    for (size_t i = 0; i < std::size(bindings_); ++i)
+      if (bindings_[i].first == label)
+        return i;
+    return std::size(bindings_);
+  }
+
+  static std::optional<Value> parse(Member const &member, std::string_view const &value) {
+    auto from_chars = [&](auto result) -> std::optional<decltype(result)> {
+      auto first = std::data(value), last = first + std::size(value);
+      auto [ptr, ec] = std::from_chars(first, last, result);
+      if (ec != std::errc{} || ptr != last)
+        return {};
+      return result;
+    };
+    return std::visit(
+        [&](auto member) -> std::optional<Value> {
+          using type = std::decay_t<decltype(std::declval<T>().*member)>;
+          if constexpr (std::is_same<type, bool>::value) {
+            using namespace std::literals;
+            for (auto tmp : {"true"sv, "yes"sv, "on"sv, "1"sv})
+              if (utils::case_insensitive_compare(value, tmp) == std::strong_ordering::equal)
+                return Value{true};
+            for (auto tmp : {"false"sv, "no"sv, "off"sv, "0"sv})
+              if (utils::case_insensitive_compare(value, tmp) == std::strong_ordering::equal)
+                return Value{false};
+            return {};
+          } else if constexpr (std::is_floating_point<type>::value) {
+            if (auto result = from_chars(double{}))
+              return Value{*result};
+            return {};
+          } else {
+            // note! parsed as the member type, i.e. out of range is an error (not truncated)
+            if (auto result = from_chars(type{}))
+              return Value{static_cast<int64_t>(*result)};
+            return {};
+          }
+        },
+        member);
+  }
+
+  void publish(Instrument &instrument) {
+    auto result = std::make_unique<T>(defaults_);
+    for (auto &entry : entries_) {
+      if (!matches(entry, instrument))
+        continue;
+      std::visit(
+          [&](auto member) {
+            using type = std::decay_t<decltype((*result).*member)>;
+            std::visit([&](auto value) { (*result).*member = static_cast<type>(value); }, entry.value);
+          },
+          bindings_[entry.binding].second);
+    }
+    instrument.current.store(result.get(), std::memory_order_release);
+    if (instrument.storage)
+      retired_.emplace_back(epoch_.load(std::memory_order_relaxed), std::move(instrument.storage));
+    instrument.storage = std::move(result);
+  }
+
+  // note! readers announcing the previous epoch (or later) can not observe anything retired before this call
+  void advance() {
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+    reclaim();
+  }
+
+  void reclaim() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto min = epoch_.load(std::memory_order_relaxed);
+    {
+      std::lock_guard lock{mutex_};
+      for (auto &slot : slots_) {
+        auto epoch = (*slot).epoch.load(std::memory_order_acquire);
+        if (epoch != 0)
+          min = std::min(min, epoch);
+      }
+    }
+    auto is_reclaimable = [&](auto &item) { return item.first < min; };
+    std::erase_if(retired_, is_reclaimable);
+    std::erase_if(retired_tables_, is_reclaimable);
+  }
+
+ private:
+  uint32_t const strategy_id_;
+  T const defaults_;
+  std::vector<std::pair<ParameterKey, Member>> bindings_;
+  std::vector<Entry> entries_;
+  std::vector<std::unique_ptr<Instrument>> instruments_;
+  utils::HashIndex lookup_;
+  Table table_storage_;
+  std::atomic<typename Table::value_type const *> table_ = {};
+  std::atomic<uint64_t> epoch_ = 1;  // note! zero is reserved (not reading)
+  std::vector<std::pair<uint64_t, std::unique_ptr<T>>> retired_;
+  std::vector<std::pair<uint64_t, Table>> retired_tables_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  size_t errors_ = {};
+  uint64_t version_ = {};
+};
+
+}  // namespace cache
+}  // namespace roq
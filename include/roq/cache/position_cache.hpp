@@ -0,0 +1,269 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/position_update.hpp"
+#include "roq/reference_data.hpp"
+#include "roq/top_of_book.hpp"
+#include "roq/trade_update.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/compare.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+#include "roq/tools/fill_deduplicator.hpp"
+
+namespace roq {
+namespace cache {
+
+// positions and profit/loss per (account, exchange, symbol)
+// - incremental update from each fill (TradeUpdate)
+// - mark-to-market from TopOfBook (mid price), contract multiplier from ReferenceData
+// - fills are de-duplicated using external_trade_id (time-bounded, see tools::FillDeduplicator)
+// - position_effect is respected, otherwise fills will first reduce the opposite position (netting)
+// - CLOSE quantity exceeding the opposite position is not applied, it is reported as close_excess_quantity
+// note! positions reported by the gateway (PositionUpdate) are only cached for reconciliation
+
+struct PositionCache final {
+  struct Position final {
+    Account account;
+    Exchange exchange;
+    Symbol symbol;
+    double multiplier = 1.0;
+    double long_quantity = 0.0;
+    double short_quantity = 0.0;
+    double long_average_price = NaN;
+    double short_average_price = NaN;
+    double realized_pnl = 0.0;
+    double unrealized_pnl = 0.0;
+    double mark_price = NaN;
+    double close_excess_quantity = 0.0;  // note! accumulated, see above
+    // from PositionUpdate
+    double reported_long_quantity = NaN;
+    double reported_short_quantity = NaN;
+
+    double net_quantity() const { return long_quantity - short_quantity; }
+
+    double total_pnl() const { return realized_pnl + unrealized_pnl; }
+  };
+
+  PositionCache() = default;
+
+  explicit PositionCache(tools::FillDeduplicator::Config const &config) : fill_deduplicator_{config} {}
+
+  // number of positions
+  size_t size() const { return std::size(positions_); }
+
+  bool empty() const { return std::empty(positions_); }
+
+  Position const *find(
+      std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol) const {
+    auto index = find_index(account, exchange, symbol);
+    if (index == NOT_FOUND)
+      return nullptr;
+    return &positions_[index];
+  }
+
+  template <typename Callback>
+  void for_each(Callback callback) const {
+    for (auto &position : positions_)
+      callback(position);
+  }
+
+  // returns nullptr if all fills were duplicates
+  // note! fills are de-duplicated before the position is created
+  Position const *operator()(Event<TradeUpdate> const &event) {
+    auto &trade_update = event.value;
+    fills_.clear();
+    for (auto &fill : trade_update.fills) {
+      if (std::isnan(fill.quantity) || std::isnan(fill.price)) [[unlikely]]
+        continue;
+      if (!std::empty(fill.external_trade_id) && !fill_deduplicator_(trade_update.exchange, trade_update.symbol, fill))
+        continue;
+      fills_.emplace_back(fill.quantity, fill.price);
+    }
+    if (std::empty(fills_))
+      return nullptr;
+    auto &position = get(trade_update.account, trade_update.exchange, trade_update.symbol);
+    for (auto [quantity, price] : fills_) {
+      auto excess = apply(position, trade_update.side, trade_update.position_effect, quantity, price);
+      position.close_excess_quantity += excess;
+    }
+    update_unrealized_pnl(position);
+    return &position;
+  }
+
+  void operator()(Event<TopOfBook> const &event) {
+    auto &top_of_book = event.value;
+    auto &layer = top_of_book.layer;
+    if (std::isnan(layer.bid_price) || std::isnan(layer.ask_price))
+      return;
+    auto mark_price = 0.5 * (layer.bid_price + layer.ask_price);
+    auto instrument = find_instrument(top_of_book.exchange, top_of_book.symbol);
+    if (instrument == NOT_FOUND)
+      return;
+    for (auto index : instruments_[instrument].positions) {
+      auto &position = positions_[index];
+      position.mark_price = mark_price;
+      update_unrealized_pnl(position);
+    }
+  }
+
+  void operator()(Event<ReferenceData> const &event) {
+    auto &reference_data = event.value;
+    if (std::isnan(reference_data.multiplier) || utils::is_zero(reference_data.multiplier))
+      return;
+    auto &instrument = instruments_[get_instrument(reference_data.exchange, reference_data.symbol)];
+    instrument.multiplier = reference_data.multiplier;
+    for (auto index : instrument.positions) {
+      auto &position = positions_[index];
+      position.multiplier = instrument.multiplier;
+      update_unrealized_pnl(position);
+    }
+  }
+
+  Position const *operator()(Event<PositionUpdate> const &event) {
+    auto &position_update = event.value;
+    auto &position = get(position_update.account, position_update.exchange, position_update.symbol);
+    if (!std::isnan(position_update.long_quantity))
+      position.reported_long_quantity = position_update.long_quantity;
+    if (!std::isnan(position_update.short_quantity))
+      position.reported_short_quantity = position_update.short_quantity;
+    return &position;
+  }
+
+ protected:
+  static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+  struct Instrument final {
+    Exchange exchange;
+    Symbol symbol;
+    double multiplier = 1.0;
+    std::vector<size_t> positions;
+  };
+
+  size_t find_index(
+      std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol) const {
+    return lookup_.find(utils::hash_all(account, exchange, symbol), [&](auto index) {
+      auto &position = positions_[index];
+      return position.account == account && position.exchange == exchange && position.symbol == symbol;
+    });
+  }
+
+  Position &get(std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &position = positions_[index];
+      return position.account == account && position.exchange == exchange && position.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(positions_);
+      auto &position = positions_.emplace_back();
+      position.account = account;
+      position.exchange = exchange;
+      position.symbol = symbol;
+      auto &instrument = instruments_[get_instrument(exchange, symbol)];
+      position.multiplier = instrument.multiplier;
+      instrument.positions.emplace_back(index);
+      return index;
+    };
+    return positions_[lookup_.get(utils::hash_all(account, exchange, symbol), is_match, create)];
+  }
+
+  size_t find_instrument(std::string_view const &exchange, std::string_view const &symbol) const {
+    return instruments_lookup_.find(utils::hash_all(exchange, symbol), [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    });
+  }
+
+  size_t get_instrument(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = instruments_.emplace_back();
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      return index;
+    };
+    return instruments_lookup_.get(utils::hash_all(exchange, symbol), is_match, create);
+  }
+
+  // returns the CLOSE quantity exceeding the opposite position (not applied)
+  static double apply(Position &position, Side side, PositionEffect position_effect, double quantity, double price) {
+    auto multiplier = position.multiplier;
+    auto reduce = [&](double &position_quantity, double &average_price, int sign) {
+      auto result = std::min(quantity, position_quantity);
+      if (result > 0.0) {
+        position.realized_pnl += sign * (price - average_price) * result * multiplier;
+        position_quantity -= result;
+        quantity -= result;
+        if (utils::is_zero(position_quantity)) {
+          position_quantity = 0.0;
+          average_price = NaN;
+        }
+      }
+    };
+    auto increase = [&](double &position_quantity, double &average_price) {
+      if (utils::is_zero(quantity))
+        return;
+      auto total = position_quantity + quantity;
+      average_price = utils::is_zero(position_quantity)
+                          ? price
+                          : (average_price * position_quantity + price * quantity) / total;
+      position_quantity = total;
+    };
+    switch (side) {
+      using enum Side;
+      case UNDEFINED:
+        break;
+      case BUY:
+        if (position_effect != PositionEffect::OPEN)
+          reduce(position.short_quantity, position.short_average_price, -1);
+        if (position_effect != PositionEffect::CLOSE)
+          increase(position.long_quantity, position.long_average_price);
+        break;
+      case SELL:
+        if (position_effect != PositionEffect::OPEN)
+          reduce(position.long_quantity, position.long_average_price, 1);
+        if (position_effect != PositionEffect::CLOSE)
+          increase(position.short_quantity, position.short_average_price);
+        break;
+    }
+    return position_effect == PositionEffect::CLOSE && !utils::is_zero(quantity) ? quantity : 0.0;
+  }
+
+  static void update_unrealized_pnl(Position &position) {
+    if (std::isnan(position.mark_price))
+      return;
+    auto result = 0.0;
+    if (position.long_quantity > 0.0)
+      result += (position.mark_price - position.long_average_price) * position.long_quantity;
+    if (position.short_quantity > 0.0)
+      result += (position.short_average_price - position.mark_price) * position.short_quantity;
+    position.unrealized_pnl = result * position.multiplier;
+  }
+
+ private:
+  std::vector<Position> positions_;
+  utils::HashIndex lookup_;
+  std::vector<Instrument> instruments_;  // note! multiplier and positions per (exchange, symbol)
+  utils::HashIndex instruments_lookup_;
+  tools::FillDeduplicator fill_deduplicator_;
+  std::vector<std::pair<double, double>> fills_;  // {quantity, price}
+};
+
+}  // namespace cache
+}  // namespace roq
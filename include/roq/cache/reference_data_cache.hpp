@@ -0,0 +1,197 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/numbers.hpp"
+#include "roq/precision.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/reference_data.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/compare.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+#include "roq/utils/update.hpp"
+
+namespace roq {
+namespace cache {
+
+// reference data per (exchange, symbol) with precomputed conversion factors
+// - reciprocals (tick size, step size), integer multipliers, precision and tolerance-adjusted limits are computed once
+//   (when received)
+// - validation is then a few multiplies and compares, no divisions
+// - prices are converted back from ticks using the decimal representation of the tick size, i.e. 3 ticks of 0.1
+//   is 0.3 (and not 0.30000000000000004)
+// note! converting back from ticks is a single division by a power of ten (multiplying by the reciprocal is not exact)
+// note! unknown (NaN) limits are relaxed: min_trade_vol = 0, max_trade_vol = inf, min_notional = 0, no step size
+// note! instrument pointers are stable
+
+struct ReferenceDataCache final {
+  // fraction of a tick (or step) considered to be rounding noise
+  static constexpr double const TOLERANCE = 1.0e-6;
+
+  struct Instrument final {
+    // note! order-path fields first
+    double inverse_tick_size = 0.0;
+    double price_scale = 1.0;  // 10^decimal_digits(price_precision)
+    int64_t tick_units = {};   // tick_size * price_scale
+    double inverse_trade_vol_step_size = 0.0;
+    double min_trade_vol_threshold = 0.0;  // min_trade_vol less tolerance
+    double max_trade_vol_threshold = std::numeric_limits<double>::infinity();  // max_trade_vol plus tolerance
+    double min_notional = 0.0;
+    double multiplier = 1.0;
+    Precision price_precision = {};
+    Precision quantity_precision = {};
+    // as received
+    double tick_size = NaN;
+    double trade_vol_step_size = NaN;
+    double min_trade_vol = 0.0;
+    double max_trade_vol = std::numeric_limits<double>::infinity();
+    Exchange exchange;
+    Symbol symbol;
+    SecurityType security_type = {};
+    Currency base_currency;
+    Currency quote_currency;
+
+    bool has_tick_size() const { return tick_units != 0; }
+
+    // note! undefined (zero) unless has_tick_size()
+    // note! price must not be NaN (the result would be unspecified)
+    int64_t to_ticks(double price) const { return std::llround(price * inverse_tick_size); }
+
+    double from_ticks(int64_t ticks) const { return static_cast<double>(ticks * tick_units) / price_scale; }
+
+    // note! same result as from_ticks(to_ticks(price)), but NaN is preserved (no conversion to integer)
+    // note! returns the price unchanged if the tick size is unknown
+    double round_to_tick(double price) const {
+      if (!has_tick_size())
+        return price;
+      return std::nearbyint(price * inverse_tick_size) * static_cast<double>(tick_units) / price_scale;
+    }
+
+    // note! returns true if the tick size is unknown
+    bool validate_price(double price) const {
+      auto ticks = price * inverse_tick_size;
+      return std::fabs(ticks - std::nearbyint(ticks)) <= TOLERANCE;
+    }
+
+    // note! returns false for NaN
+    // note! limits allow the same rounding noise as the step size, e.g. 0.1 + 0.2 satisfies a minimum of 0.3
+    bool validate_quantity(double quantity) const {
+      auto steps = quantity * inverse_trade_vol_step_size;
+      bool on_step = std::fabs(steps - std::nearbyint(steps)) <= TOLERANCE;
+      return (quantity > 0.0) & (quantity >= min_trade_vol_threshold) & (quantity <= max_trade_vol_threshold) &
+             on_step;
+    }
+
+    bool validate_notional(double price, double quantity) const {
+      return std::fabs(price * quantity * multiplier) >= min_notional;
+    }
+  };
+
+  ReferenceDataCache() = default;
+
+  ReferenceDataCache(ReferenceDataCache &&) = default;
+  ReferenceDataCache(ReferenceDataCache const &) = delete;
+
+  size_t size() const { return std::size(instruments_); }
+
+  Instrument const *find(std::string_view const &exchange, std::string_view const &symbol) const {
+    auto index = lookup_.find(utils::hash_all(exchange, symbol), [&](auto index) {
+      auto &instrument = *instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    });
+    return index == utils::HashIndex::NOT_FOUND ? nullptr : instruments_[index].get();
+  }
+
+  // note! NaN means "unchanged"
+  Instrument const &operator()(Event<ReferenceData> const &event) {
+    auto &reference_data = event.value;
+    auto &instrument = get_instrument(reference_data.exchange, reference_data.symbol);
+    utils::update_if_not_empty(instrument.security_type, reference_data.security_type);
+    utils::update_if_not_empty(instrument.base_currency, reference_data.base_currency);
+    utils::update_if_not_empty(instrument.quote_currency, reference_data.quote_currency);
+    if (utils::update(instrument.tick_size, reference_data.tick_size)) {
+      instrument.price_precision = compute_precision(instrument.tick_size);
+      if (instrument.price_precision != Precision::UNDEFINED) {
+        instrument.price_scale = std::pow(10.0, utils::decimal_digits(instrument.price_precision));
+        instrument.tick_units = std::llround(instrument.tick_size * instrument.price_scale);
+        instrument.inverse_tick_size = 1.0 / instrument.tick_size;
+      } else {
+        instrument.price_scale = 1.0;
+        instrument.tick_units = {};
+        instrument.inverse_tick_size = 0.0;
+      }
+    }
+    if (utils::update(instrument.trade_vol_step_size, reference_data.trade_vol_step_size)) {
+      instrument.quantity_precision = compute_precision(instrument.trade_vol_step_size);
+      instrument.inverse_trade_vol_step_size =
+          instrument.quantity_precision != Precision::UNDEFINED ? (1.0 / instrument.trade_vol_step_size) : 0.0;
+    }
+    if (!std::isnan(reference_data.min_trade_vol))
+      instrument.min_trade_vol = reference_data.min_trade_vol;
+    if (!std::isnan(reference_data.max_trade_vol))
+      instrument.max_trade_vol = reference_data.max_trade_vol;
+    // note! a fraction of a step, or relative to the limit if the step size is unknown
+    auto tolerance = [&](auto limit) {
+      auto unit = instrument.quantity_precision != Precision::UNDEFINED ? instrument.trade_vol_step_size : limit;
+      return TOLERANCE * std::fabs(unit);
+    };
+    instrument.min_trade_vol_threshold = instrument.min_trade_vol - tolerance(instrument.min_trade_vol);
+    instrument.max_trade_vol_threshold = instrument.max_trade_vol + tolerance(instrument.max_trade_vol);
+    if (!std::isnan(reference_data.min_notional))
+      instrument.min_notional = reference_data.min_notional;
+    if (!std::isnan(reference_data.multiplier) && reference_data.multiplier > 0.0)
+      instrument.multiplier = reference_data.multiplier;
+    return instrument;
+  }
+
+  void clear() {
+    instruments_.clear();
+    lookup_.clear();
+  }
+
+  // smallest number of decimal digits required to represent value (UNDEFINED if not positive or too many)
+  static Precision compute_precision(double value) {
+    if (!(value > 0.0))
+      return {};
+    auto scale = 1.0;
+    for (int8_t i = 0; i < 16; ++i, scale *= 10.0) {
+      auto tmp = value * scale;
+      if (utils::compare(tmp, std::round(tmp)) == std::strong_ordering::equal && tmp >= 0.5)
+        return utils::to_precision(i);
+    }
+    return {};
+  }
+
+ protected:
+  Instrument &get_instrument(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = *instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = *instruments_.emplace_back(std::make_unique<Instrument>());
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      return index;
+    };
+    return *instruments_[lookup_.get(utils::hash_all(exchange, symbol), is_match, create)];
+  }
+
+ private:
+  std::vector<std::unique_ptr<Instrument>> instruments_;
+  utils::HashIndex lookup_;
+};
+
+}  // namespace cache
+}  // namespace roq
@@ -0,0 +1,162 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <magic_enum.hpp>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/statistics.hpp"
+#include "roq/statistics_type.hpp"
+#include "roq/statistics_update.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+#include "roq/utils/update.hpp"
+
+namespace roq {
+namespace cache {
+
+// statistics per (exchange, symbol)
+// - one slot per StatisticsType, i.e. reading a value is O(1) (no scanning of spans)
+// - INCREMENTAL updates merge into existing slots, SNAPSHOT updates also reset slots not included
+// - the stream_id last providing each type is tracked, i.e. a SNAPSHOT only resets types owned by its stream (gateways
+//   may split statistics across streams)
+// - the handler is notified when the value of a selected type changes (including reset to NaN)
+// note! instrument pointers are stable
+
+struct StatisticsCache final {
+  static constexpr size_t const SIZE = magic_enum::enum_count<StatisticsType>();
+
+  struct Instrument final {
+    Exchange exchange;
+    Symbol symbol;
+    std::array<Statistics, SIZE> statistics = {};
+    std::array<uint16_t, SIZE> stream_ids = {};  // note! stream last providing the type
+    std::chrono::nanoseconds exchange_time_utc = {};
+    uint64_t exchange_sequence = {};
+
+    // note! hot path
+    double operator[](StatisticsType type) const { return statistics[static_cast<size_t>(type)].value; }
+
+    Statistics const &get(StatisticsType type) const { return statistics[static_cast<size_t>(type)]; }
+  };
+
+  struct Handler {
+    virtual void operator()(Instrument const &, Statistics const &) = 0;
+  };
+
+  StatisticsCache() = default;
+
+  StatisticsCache(Handler &handler, std::initializer_list<StatisticsType> notify) : handler_{&handler} {
+    for (auto type : notify)
+      notify_[static_cast<size_t>(type)] = true;
+  }
+
+  StatisticsCache(StatisticsCache &&) = default;
+  StatisticsCache(StatisticsCache const &) = delete;
+
+  size_t size() const { return std::size(instruments_); }
+
+  Instrument const *find(std::string_view const &exchange, std::string_view const &symbol) const {
+    auto index = find_index(exchange, symbol);
+    return index == NOT_FOUND ? nullptr : instruments_[index].get();
+  }
+
+  // returns NaN if unknown
+  double get(std::string_view const &exchange, std::string_view const &symbol, StatisticsType type) const {
+    auto instrument = find(exchange, symbol);
+    return instrument ? (*instrument)[type] : NaN;
+  }
+
+  Instrument const &operator()(Event<StatisticsUpdate> const &event) {
+    auto &statistics_update = event.value;
+    auto &instrument = *instruments_[get_index(statistics_update.exchange, statistics_update.symbol)];
+    std::array<bool, SIZE> seen = {};
+    for (auto &statistics : statistics_update.statistics) {
+      auto index = static_cast<size_t>(statistics.type);
+      if (index == 0 || index >= SIZE) [[unlikely]]
+        continue;
+      seen[index] = true;
+      instrument.stream_ids[index] = statistics_update.stream_id;
+      auto &slot = instrument.statistics[index];
+      slot.begin_time_utc = statistics.begin_time_utc;
+      slot.end_time_utc = statistics.end_time_utc;
+      if (utils::update(slot.value, statistics.value))
+        notify(instrument, slot);
+    }
+    if (utils::is_snapshot(statistics_update.update_type)) {
+      for (size_t i = 1; i < SIZE; ++i) {
+        if (seen[i] || instrument.stream_ids[i] != statistics_update.stream_id)
+          continue;
+        auto &slot = instrument.statistics[i];
+        auto changed = !std::isnan(slot.value);
+        slot.value = NaN;
+        slot.begin_time_utc = {};
+        slot.end_time_utc = {};
+        if (changed)
+          notify(instrument, slot);
+      }
+    }
+    utils::update_max(instrument.exchange_time_utc, statistics_update.exchange_time_utc);
+    utils::update_max(instrument.exchange_sequence, statistics_update.exchange_sequence);
+    return instrument;
+  }
+
+  void clear() {
+    instruments_.clear();
+    lookup_.clear();
+  }
+
+ protected:
+  static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+  void notify(Instrument const &instrument, Statistics const &statistics) {
+    if (handler_ && notify_[static_cast<size_t>(statistics.type)])
+      (*handler_)(instrument, statistics);
+  }
+
+  size_t find_index(std::string_view const &exchange, std::string_view const &symbol) const {
+    return lookup_.find(utils::hash_all(exchange, symbol), [&](auto index) {
+      auto &instrument = *instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    });
+  }
+
+  size_t get_index(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = *instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = *instruments_.emplace_back(std::make_unique<Instrument>());
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      for (size_t i = 0; i < SIZE; ++i)
+        instrument.statistics[i].type = static_cast<StatisticsType>(i);
+      return index;
+    };
+    return lookup_.get(utils::hash_all(exchange, symbol), is_match, create);
+  }
+
+ private:
+  Handler *handler_ = nullptr;
+  std::array<bool, SIZE> notify_ = {};
+  std::vector<std::unique_ptr<Instrument>> instruments_;
+  utils::HashIndex lookup_;
+};
+
+}  // namespace cache
+}  // namespace roq
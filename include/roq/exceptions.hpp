@@ -6,8 +6,9 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <array>
 #include <stdexcept>
-#include <string>
 #include <string_view>
 #include <system_error>
 #include <utility>
@@ -19,16 +20,29 @@
 namespace roq {
 
 namespace detail {
-template <typename... Args>
-constexpr auto create_what(format_str<Args...> const &fmt, Args &&...args) -> std::string {
-  if (std::size(fmt.str) == 0)
-    return {};
-  if constexpr (sizeof...(args) == 0) {
-    return {std::data(fmt.str), std::size(fmt.str)};
-  } else {
-    return fmt::vformat(fmt.str, fmt::make_format_args(args...));
+// note! formats into a fixed-size inline buffer (no allocation), may truncate to N - 1 (null-terminated)
+template <size_t N>
+struct what_buffer final {
+  template <typename... Args>
+  explicit what_buffer(format_str<Args...> const &fmt, Args &&...args) {
+    if constexpr (sizeof...(args) == 0) {
+      length_ = std::min(std::size(fmt.str), N - 1);
+      std::copy_n(std::data(fmt.str), length_, std::data(buffer_));
+    } else {
+      auto result = fmt::vformat_to_n(std::data(buffer_), N - 1, fmt.str, fmt::make_format_args(args...));
+      length_ = std::min(result.size, N - 1);
+    }
+    buffer_[length_] = '\0';
   }
-}
+
+  char const *c_str() const noexcept { return std::data(buffer_); }
+
+  operator std::string_view() const noexcept { return {std::data(buffer_), length_}; }
+
+ private:
+  size_t length_ = {};
+  std::array<char, N> buffer_;
+};
 }  // namespace detail
 
 // This class hierarchy is *similar to* that of std::exception,
@@ -45,11 +59,13 @@ constexpr auto create_what(format_str<Args...> const &fmt, Args &&...args) -> st
 //     ...
 //   }
 
+// note! what() is formatted into a fixed-size inline buffer (no allocation), long messages are truncated
+
 //! Base
 struct ROQ_PUBLIC Exception : public std::exception {
   template <typename... Args>
   explicit Exception(format_str<Args...> const &fmt, Args &&...args)
-      : file_name_{fmt.file_name}, line_{fmt.line}, what_{detail::create_what(fmt, std::forward<Args>(args)...)} {}
+      : file_name_{fmt.file_name}, line_{fmt.line}, what_{fmt, std::forward<Args>(args)...} {}
 
   char const *what() const noexcept override { return what_.c_str(); }
 
@@ -68,7 +84,7 @@ struct ROQ_PUBLIC Exception : public std::exception {
         R"(line={})"
         R"(}})"sv,
         typeid(*this).name(),
-        what_,
+        static_cast<std::string_view>(what_),
         file_name_,
         line_);
   }
@@ -76,7 +92,7 @@ struct ROQ_PUBLIC Exception : public std::exception {
  protected:
   detail::static_string<32> const file_name_;
   uint32_t const line_;
-  std::string const what_;
+  detail::what_buffer<512> const what_;
 };
 
 //! Runtime error
@@ -109,7 +125,7 @@ struct ROQ_PUBLIC SystemError : public RuntimeError {
         R"(}})"
         R"(}})"sv,
         typeid(*this).name(),
-        what_,
+        static_cast<std::string_view>(what_),
         file_name_,
         line_,
         ec_.message(),
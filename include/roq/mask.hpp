@@ -7,8 +7,14 @@
 
 #include <magic_enum.hpp>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
 #include <initializer_list>
+#include <iterator>
 #include <limits>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 
@@ -23,8 +29,13 @@ template <typename T, typename = typename std::enable_if<std::is_enum<T>::value>
 struct Mask final {
   using value_type = typename std::underlying_type<T>::type;
 
+  using unsigned_type = typename std::make_unsigned<value_type>::type;
+
+  static constexpr size_t const DIGITS = std::numeric_limits<unsigned_type>::digits;
+
   struct sentinel final {};
 
+  // note! iterates the flags set (lowest first) by repeatedly clearing the lowest set bit
   struct iterator final {
     // std::iterator_traits
     using difference_type = std::ptrdiff_t;
@@ -33,32 +44,32 @@ struct Mask final {
     using reference = T const;
     using iterator_category = std::forward_iterator_tag;
 
-    using underlying_type = std::underlying_type<T>::type;
+    constexpr iterator() = default;
+
+    constexpr iterator(Mask<T> value) : value_{static_cast<unsigned_type>(value.get())} {}
 
-    iterator(Mask<T> value) : value_{value.get()} {}
+    constexpr bool operator==(iterator const &) const = default;
 
-    bool operator==(sentinel const &) const {
-      for (; bit_ < std::numeric_limits<underlying_type>::digits; ++bit_) {
-        auto mask = static_cast<underlying_type>(size_t{1} << bit_);
-        if (value_ < mask)
-          break;
-        if (value_ & mask)
-          return false;
-      }
-      return true;
+    constexpr bool operator==(sentinel const &) const { return value_ == unsigned_type{}; }
+
+    constexpr reference operator*() const { return Mask<T>::from_index(index()); }
+
+    constexpr iterator &operator++() {
+      value_ &= static_cast<unsigned_type>(value_ - 1);
+      return *this;
     }
 
-    reference operator*() const {
-      auto mask = static_cast<underlying_type>(size_t{1} << bit_++);
-      return static_cast<value_type>(mask);
+    constexpr iterator operator++(int) {
+      auto result = *this;
+      ++(*this);
+      return result;
     }
 
-    iterator &operator++() { return *this; }
-    void operator++(int) { ++(*this); }
+    // bit position of the current flag
+    constexpr size_t index() const { return static_cast<size_t>(std::countr_zero(value_)); }
 
    private:
-    underlying_type value_;
-    mutable size_t bit_ = 0;  // skip undefined
+    unsigned_type value_ = {};
   };
 
   constexpr Mask() = default;
@@ -83,6 +94,17 @@ struct Mask final {
 
   constexpr value_type get() const { return value_; }
 
+  // number of flags set
+  constexpr size_t popcount() const { return static_cast<size_t>(std::popcount(static_cast<unsigned_type>(value_))); }
+
+  // callback(T) for each flag set, lowest first
+  template <typename Callback>
+  constexpr void for_each_set(Callback callback) const {
+    for (auto value = static_cast<unsigned_type>(value_); value != unsigned_type{};
+         value &= static_cast<unsigned_type>(value - 1))
+      callback(from_index(static_cast<size_t>(std::countr_zero(value))));
+  }
+
   constexpr bool is_same(T flag) const { return value_ == static_cast<value_type>(flag); }
 
   constexpr bool has(T flag) const { return value_ & static_cast<value_type>(flag); }
@@ -161,6 +183,19 @@ struct Mask final {
     return *this;
   }
 
+  static constexpr T from_index(size_t index) {
+    return static_cast<T>(static_cast<value_type>(static_cast<unsigned_type>(unsigned_type{1} << index)));
+  }
+
+  // names indexed by bit position
+  // note! compile-time (magic_enum), empty if the flag can not be named (e.g. outside the reflected range)
+  static constexpr std::array<std::string_view, DIGITS> const NAMES = []() {
+    std::array<std::string_view, DIGITS> result;
+    for (size_t i = 0; i < DIGITS; ++i)
+      result[i] = magic_enum::enum_name(from_index(i));
+    return result;
+  }();
+
  private:
   value_type value_ = {};
 };
@@ -179,6 +214,18 @@ struct fmt::formatter<roq::Mask<T>> {
     using namespace std::literals;
     using iterator = typename roq::Mask<T>::iterator;
     using sentinel = typename roq::Mask<T>::sentinel;
-    return fmt::format_to(context.out(), "{}"sv, fmt::join(iterator{value}, sentinel{}, "|"sv));
+    auto out = context.out();
+    iterator const begin{value};
+    for (auto iter = begin; iter != sentinel{}; ++iter) {
+      if (iter != begin)
+        *out++ = '|';
+      // note! table lookup, falls back to the formatter of T
+      auto name = roq::Mask<T>::NAMES[iter.index()];
+      if (std::empty(name)) [[unlikely]]
+        out = fmt::format_to(out, "{}"sv, *iter);
+      else
+        out = std::copy(std::begin(name), std::end(name), out);
+    }
+    return out;
   }
 };
@@ -0,0 +1,78 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+#include "roq/metrics/writer.hpp"
+
+namespace roq {
+namespace metrics {
+
+// latency histogram
+// - buckets are powers of two (nanoseconds), i.e. an update is a bit_width and an increment
+// - first bucket is [0, 1024ns], then (1024ns, 2048ns], etc., last bucket is overflow
+// note! upper bounds are inclusive, i.e. consistent with prometheus' "le" (less than or equal)
+
+struct Histogram final {
+  static constexpr size_t const MIN_BITS = 10;  // 1024ns
+  static constexpr size_t const SIZE = 24;      // 2^32ns (~4.3s) is the upper bound of the last finite bucket
+
+  // upper bound (inclusive) of bucket, nanoseconds
+  static constexpr double bucket_limit(size_t index) {
+    if (index >= (SIZE - 1))
+      return std::numeric_limits<double>::infinity();
+    return static_cast<double>(uint64_t{1} << (index + MIN_BITS));
+  }
+
+  void update(std::chrono::nanoseconds value) {
+    auto tmp = static_cast<uint64_t>(std::max<int64_t>(value.count(), 0));
+    auto bits = static_cast<size_t>(tmp > 0 ? std::bit_width(tmp - 1) : 0);
+    auto index = bits > MIN_BITS ? std::min(bits - MIN_BITS, SIZE - 1) : size_t{0};
+    ++buckets_[index];
+    ++count_;
+    sum_ += tmp;
+  }
+
+  void operator()(std::chrono::nanoseconds value) { update(value); }
+
+  uint64_t count() const { return count_; }
+
+  std::chrono::nanoseconds sum() const { return std::chrono::nanoseconds{sum_}; }
+
+  uint64_t operator[](size_t index) const { return buckets_[index]; }
+
+  void clear() {
+    buckets_ = {};
+    count_ = {};
+    sum_ = {};
+  }
+
+  // prometheus' exposition format (cumulative)
+  void write(Writer &writer, std::string_view const &name, std::string_view const &labels) const {
+    using namespace std::literals;
+    writer.write_type(name, "histogram"sv);
+    uint64_t total = {};
+    for (size_t i = 0; i < SIZE; ++i) {
+      total += buckets_[i];
+      writer.write_bucket(name, labels, bucket_limit(i), total);
+    }
+    writer.write_sum(name, labels, static_cast<double>(sum_));
+    writer.write_count(name, labels, count_);
+    writer.finish();
+  }
+
+ private:
+  std::array<uint64_t, SIZE> buckets_ = {};
+  uint64_t count_ = {};
+  uint64_t sum_ = {};
+};
+
+}  // namespace metrics
+}  // namespace roq
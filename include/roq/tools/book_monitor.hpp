@@ -0,0 +1,272 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <magic_enum.hpp>
+
+#include <array>
+#include <bit>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/mask.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/market_by_price_update.hpp"
+#include "roq/mbp_update.hpp"
+
+#include "roq/cache/market_by_price.hpp"
+
+#include "roq/metrics/writer.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// book sanity monitor
+// - must be called after the MarketByPriceUpdate has been applied to the cache
+// - checked for each update: exchange_sequence gap (if non-zero) and checksum (if non-zero)
+// - checked at the end of each batch (is_last): crossed book and levels beyond max_depth (if non-zero)
+// - each violation type has a configurable action
+//   - TRIM: repair the book
+//     - crossed: levels of the side not updated most recently are removed (REQUEST_SNAPSHOT if undecidable)
+//     - max_depth: levels beyond max_depth are removed
+//   - REQUEST_SNAPSHOT: the handler is called (at most once per batch) and should request a new snapshot, further
+//     requests are suppressed until a SNAPSHOT has been received
+// - counters (violations, trims and snapshot requests) can be exported as metrics
+// note! TRIM is not supported for checksum and sequence gap (treated as NONE)
+
+struct BookMonitor final {
+  enum class Violation : uint8_t {
+    UNDEFINED = 0,
+    CROSSED = 0x1,
+    MAX_DEPTH = 0x2,
+    CHECKSUM = 0x4,
+    SEQUENCE_GAP = 0x8,
+  };
+
+  enum class Action : uint8_t {
+    NONE = 0,
+    TRIM,
+    REQUEST_SNAPSHOT,
+  };
+
+  struct Handler {
+    virtual void operator()(cache::MarketByPrice const &, Mask<Violation>) = 0;
+  };
+
+  struct Config final {
+    Action crossed = Action::TRIM;
+    Action max_depth = Action::TRIM;
+    Action checksum = Action::REQUEST_SNAPSHOT;
+    Action sequence_gap = Action::REQUEST_SNAPSHOT;
+  };
+
+  BookMonitor(Handler &handler, Config const &config)
+      : handler_{handler}, actions_{{config.crossed, config.max_depth, config.checksum, config.sequence_gap}} {}
+
+  BookMonitor(BookMonitor &&) = default;
+  BookMonitor(BookMonitor const &) = delete;
+
+  uint64_t violations(Violation violation) const { return violations_[to_index(violation)]; }
+  uint64_t trims() const { return trims_; }
+  uint64_t snapshot_requests() const { return snapshot_requests_; }
+
+  void operator()(Event<MarketByPriceUpdate> const &event, cache::MarketByPrice &market_by_price) {
+    auto &[message_info, market_by_price_update] = event;
+    auto &instrument = get_instrument(market_by_price_update.exchange, market_by_price_update.symbol);
+    instrument.market_by_price = &market_by_price;
+    auto snapshot = utils::is_snapshot(market_by_price_update.update_type);
+    if (snapshot)
+      instrument.awaiting_snapshot = false;
+    // sequence
+    auto exchange_sequence = market_by_price_update.exchange_sequence;
+    if (exchange_sequence != 0) {
+      if (!snapshot && instrument.exchange_sequence != 0 && exchange_sequence != (instrument.exchange_sequence + 1))
+        instrument.violations.set(Violation::SEQUENCE_GAP);
+      instrument.exchange_sequence = exchange_sequence;
+    }
+    // checksum
+    if (market_by_price_update.checksum != 0 && market_by_price_update.checksum != market_by_price.checksum())
+      instrument.violations.set(Violation::CHECKSUM);
+    // note! used to decide which side is stale
+    ++version_;
+    if (snapshot || !std::empty(market_by_price_update.bids))
+      instrument.bids_version = version_;
+    if (snapshot || !std::empty(market_by_price_update.asks))
+      instrument.asks_version = version_;
+    instrument.max_depth = market_by_price_update.max_depth;
+    if (!instrument.pending) {
+      instrument.pending = true;
+      pending_.emplace_back(&instrument);
+    }
+    if (message_info.is_last)
+      check();
+  }
+
+  // note! called automatically when is_last
+  void check() {
+    for (auto instrument : pending_)
+      check(*instrument);
+    pending_.clear();
+  }
+
+  void write(metrics::Writer &writer, std::string_view const &name) const {
+    using namespace std::literals;
+    writer.write_type(name, "counter"sv);
+    for (size_t i = 0; i < std::size(violations_); ++i) {
+      auto labels = fmt::format(R"(violation="{}")"sv, magic_enum::enum_name(from_index(i)));
+      writer.write_simple(name, labels, violations_[i]);
+    }
+    writer.write_simple(name, R"(action="trim")"sv, trims_);
+    writer.write_simple(name, R"(action="request_snapshot")"sv, snapshot_requests_);
+    writer.finish();
+  }
+
+ protected:
+  struct Instrument final {
+    Exchange exchange;
+    Symbol symbol;
+    cache::MarketByPrice *market_by_price = nullptr;
+    uint64_t exchange_sequence = {};
+    uint64_t bids_version = {};
+    uint64_t asks_version = {};
+    uint16_t max_depth = {};
+    Mask<Violation> violations;
+    bool pending = false;
+    bool awaiting_snapshot = false;
+  };
+
+  static size_t to_index(Violation violation) {
+    return static_cast<size_t>(std::countr_zero(static_cast<uint8_t>(violation)));
+  }
+
+  static Violation from_index(size_t index) { return static_cast<Violation>(1 << index); }
+
+  void check(Instrument &instrument) {
+    instrument.pending = false;
+    auto &market_by_price = *instrument.market_by_price;
+    // note! hot path (few ns)
+    if (market_by_price.is_bad())
+      instrument.violations.set(Violation::CROSSED);
+    if (instrument.max_depth != 0) {
+      auto [bids, asks] = market_by_price.size();
+      if (bids > instrument.max_depth || asks > instrument.max_depth)
+        instrument.violations.set(Violation::MAX_DEPTH);
+    }
+    if (std::empty(instrument.violations)) [[likely]]
+      return;
+    // violations
+    Mask<Violation> request_snapshot;
+    for (size_t i = 0; i < std::size(actions_); ++i) {
+      auto violation = from_index(i);
+      if (!instrument.violations.has(violation))
+        continue;
+      ++violations_[i];
+      switch (actions_[i]) {
+        using enum Action;
+        case NONE:
+          break;
+        case TRIM:
+          if (!trim(instrument, violation))
+            request_snapshot.set(violation);
+          break;
+        case REQUEST_SNAPSHOT:
+          request_snapshot.set(violation);
+          break;
+      }
+    }
+    instrument.violations.reset();
+    if (std::empty(request_snapshot) || instrument.awaiting_snapshot)
+      return;
+    instrument.awaiting_snapshot = true;
+    ++snapshot_requests_;
+    handler_(std::as_const(market_by_price), request_snapshot);
+  }
+
+  // returns false if the book could not be repaired
+  bool trim(Instrument &instrument, Violation violation) {
+    auto &market_by_price = *instrument.market_by_price;
+    market_by_price.extract_2(bids_, asks_);
+    removals_[0].clear();
+    removals_[1].clear();
+    switch (violation) {
+      using enum Violation;
+      case CROSSED:
+        if (instrument.bids_version == instrument.asks_version || std::empty(bids_) || std::empty(asks_))
+          return false;
+        if (instrument.bids_version < instrument.asks_version) {
+          for (auto &item : bids_)
+            if (item.price >= asks_[0].price)
+              removals_[0].emplace_back(MBPUpdate{.price = item.price, .quantity = 0.0});
+        } else {
+          for (auto &item : asks_)
+            if (item.price <= bids_[0].price)
+              removals_[1].emplace_back(MBPUpdate{.price = item.price, .quantity = 0.0});
+        }
+        break;
+      case MAX_DEPTH:
+        for (size_t i = instrument.max_depth; i < std::size(bids_); ++i)
+          removals_[0].emplace_back(MBPUpdate{.price = bids_[i].price, .quantity = 0.0});
+        for (size_t i = instrument.max_depth; i < std::size(asks_); ++i)
+          removals_[1].emplace_back(MBPUpdate{.price = asks_[i].price, .quantity = 0.0});
+        break;
+      case UNDEFINED:
+      case CHECKSUM:
+      case SEQUENCE_GAP:
+        return true;
+    }
+    market_by_price(removals_[0], removals_[1]);
+    ++trims_;
+    return !(violation == Violation::CROSSED && market_by_price.is_bad());
+  }
+
+  Instrument &get_instrument(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = *instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = *instruments_.emplace_back(std::make_unique<Instrument>());
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      return index;
+    };
+    return *instruments_[lookup_.get(utils::hash_all(exchange, symbol), is_match, create)];
+  }
+
+ private:
+  Handler &handler_;
+  std::array<Action, 4> const actions_;
+  std::array<uint64_t, 4> violations_ = {};
+  uint64_t trims_ = {};
+  uint64_t snapshot_requests_ = {};
+  uint64_t version_ = {};
+  std::vector<std::unique_ptr<Instrument>> instruments_;
+  utils::HashIndex lookup_;
+  std::vector<Instrument *> pending_;
+  std::vector<MBPUpdate> bids_;
+  std::vector<MBPUpdate> asks_;
+  std::array<std::vector<MBPUpdate>, 2> removals_;
+};
+
+}  // namespace tools
+}  // namespace roq
+
+template <>
+struct fmt::formatter<roq::tools::BookMonitor::Violation> {
+  constexpr auto parse(format_parse_context &context) { return std::begin(context); }
+  auto format(roq::tools::BookMonitor::Violation const &value, format_context &context) const {
+    using namespace std::literals;
+    return fmt::format_to(context.out(), "{}"sv, magic_enum::enum_name(value));
+  }
+};
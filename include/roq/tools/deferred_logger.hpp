@@ -0,0 +1,309 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include "roq/compat.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "roq/clock.hpp"
+#include "roq/format_str.hpp"
+
+namespace roq {
+namespace tools {
+
+// deferred (binary) logging
+// - the hot path (Producer) copies the format string (a view of the literal), the source location, a timestamp and the
+//   raw arguments into a single-producer/single-consumer ring, i.e. no formatting and no allocation
+// - formatting is done by the consumer (drain), either from a background thread (start) or explicitly
+// - each producer (thread) must create its own Producer, messages are ordered per producer (not across producers)
+// - string arguments (anything convertible to std::string_view) are deep copied
+// - the ring has a fixed capacity, messages are dropped (and counted) when the ring is full
+// note! other arguments must be trivially copyable and not reference external memory, e.g. messages holding views
+//   (such as OrderUpdate) must be decomposed into fields or formatted eagerly
+// note! the logger must outlive its producers, rings are only released when the logger is destroyed
+
+struct DeferredLogger final {
+  struct Message final {
+    std::chrono::nanoseconds timestamp = {};  // realtime, captured by the producer
+    std::string_view file_name;
+    uint32_t line = {};
+    std::string_view text;
+  };
+
+  struct Handler {
+    virtual void operator()(Message const &) = 0;
+  };
+
+  struct Config final {
+    size_t capacity = 1 << 20;  // bytes per producer (rounded up to a power of two)
+    std::chrono::nanoseconds poll_interval = std::chrono::milliseconds{1};
+  };
+
+  // single-producer/single-consumer ring of variable sized records
+  struct Queue final {
+    struct alignas(16) Slot final {
+      std::byte data[16];
+    };
+
+    using format_type = void (*)(std::byte const *, fmt::memory_buffer &, Message &);
+
+    struct Header final {
+      uint32_t size = {};            // number of slots (including the header)
+      format_type format = nullptr;  // note! nullptr means padding (wrap-around)
+    };
+
+    static_assert(sizeof(Header) <= sizeof(Slot));
+
+    explicit Queue(size_t capacity)
+        : capacity_{std::bit_ceil(std::max<size_t>(capacity / sizeof(Slot), 2))}, mask_{capacity_ - 1},
+          buffer_{std::make_unique<Slot[]>(capacity_)} {}
+
+    Queue(Queue const &) = delete;
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // producer
+    // note! callback receives a pointer to (size - 1) contiguous slots following the header
+    template <typename Callback>
+    bool push(size_t size, format_type format, Callback callback) {
+      auto head = head_.load(std::memory_order_relaxed);
+      auto offset = head & mask_;
+      auto contiguous = capacity_ - offset;
+      auto required = size <= contiguous ? size : (contiguous + size);
+      if (size > capacity_ || (head + required - cached_tail_) > capacity_) {
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+        if (size > capacity_ || (head + required - cached_tail_) > capacity_) [[unlikely]] {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+      }
+      if (size > contiguous) {
+        new (&buffer_[offset]) Header{.size = static_cast<uint32_t>(contiguous)};
+        head += contiguous;
+        offset = 0;
+      }
+      new (&buffer_[offset]) Header{.size = static_cast<uint32_t>(size), .format = format};
+      callback(reinterpret_cast<std::byte *>(&buffer_[offset + 1]));
+      head_.store(head + size, std::memory_order_release);
+      return true;
+    }
+
+    // consumer
+    // note! callback receives the header and a pointer to the data
+    template <typename Callback>
+    size_t pop(Callback callback) {
+      size_t result = {};
+      auto tail = tail_.load(std::memory_order_relaxed);
+      auto head = head_.load(std::memory_order_acquire);
+      while (tail != head) {
+        auto offset = tail & mask_;
+        auto &header = *std::launder(reinterpret_cast<Header const *>(&buffer_[offset]));
+        if (header.format) {
+          callback(header, reinterpret_cast<std::byte const *>(&buffer_[offset + 1]));
+          ++result;
+        }
+        tail += header.size;
+        tail_.store(tail, std::memory_order_release);
+      }
+      return result;
+    }
+
+   private:
+    size_t const capacity_;  // slots
+    size_t const mask_;
+    std::unique_ptr<Slot[]> const buffer_;
+    alignas(ROQ_CACHELINE_SIZE) std::atomic<uint64_t> head_ = {};
+    uint64_t cached_tail_ = {};
+    std::atomic<uint64_t> dropped_ = {};
+    alignas(ROQ_CACHELINE_SIZE) std::atomic<uint64_t> tail_ = {};
+  };
+
+  struct Producer final {
+    explicit Producer(Queue &queue) : queue_{&queue} {}
+
+    Producer(Producer &&) = default;
+    Producer(Producer const &) = delete;
+
+    // returns false if the message was dropped (ring full)
+    template <typename... Args>
+    bool operator()(format_str<Args...> const &fmt, Args &&...args) {
+      using record_type = Record<std::remove_cvref_t<Args>...>;
+      auto length = sizeof(record_type) + (size_t{} + ... + get_length(args));
+      auto size = 1 + (length + sizeof(Queue::Slot) - 1) / sizeof(Queue::Slot);
+      auto timestamp = clock::get_realtime();
+      return (*queue_).push(size, &record_type::format, [&](std::byte *data) {
+        [[maybe_unused]] auto offset = static_cast<uint32_t>(sizeof(record_type));
+        new (data) record_type{
+            .str = fmt.str,
+            .file_name = fmt.file_name,
+            .line = fmt.line,
+            .timestamp = timestamp,
+            .args = {encode(data, offset, args)...},
+        };
+      });
+    }
+
+    uint64_t dropped() const { return (*queue_).dropped(); }
+
+   private:
+    Queue *queue_;
+  };
+
+  DeferredLogger(Handler &handler, Config const &config)
+      : handler_{handler}, capacity_{config.capacity}, poll_interval_{config.poll_interval} {}
+
+  DeferredLogger(DeferredLogger &&) = delete;
+  DeferredLogger(DeferredLogger const &) = delete;
+
+  ~DeferredLogger() { stop(); }
+
+  // note! thread-safe
+  Producer create_producer() {
+    std::lock_guard lock{mutex_};
+    return Producer{*queues_.emplace_back(std::make_unique<Queue>(capacity_))};
+  }
+
+  // number of messages dropped (all producers)
+  uint64_t dropped() const {
+    std::lock_guard lock{mutex_};
+    uint64_t result = {};
+    for (auto &queue : queues_)
+      result += (*queue).dropped();
+    return result;
+  }
+
+  // format and dispatch pending messages, returns the number of messages
+  // note! consumer, must not be called concurrently (nor while the background thread is running)
+  size_t drain() {
+    std::lock_guard lock{mutex_};
+    size_t result = {};
+    for (auto &queue : queues_)
+      result += (*queue).pop([&](auto &header, auto data) {
+        buffer_.clear();
+        Message message;
+        (*header.format)(data, buffer_, message);
+        handler_(std::as_const(message));
+      });
+    return result;
+  }
+
+  // start the background thread
+  void start() {
+    if (thread_.joinable())
+      return;
+    thread_ = std::jthread{[this](std::stop_token stop_token) {
+      while (!stop_token.stop_requested())
+        if (drain() == 0)
+          std::this_thread::sleep_for(poll_interval_);
+    }};
+  }
+
+  // stop the background thread (if running) and drain pending messages
+  void stop() {
+    if (thread_.joinable()) {
+      thread_.request_stop();
+      thread_.join();
+    }
+    drain();
+  }
+
+ protected:
+  struct String final {
+    uint32_t offset = {};  // relative to the record
+    uint32_t length = {};
+  };
+
+  template <typename T>
+  static constexpr bool is_string = std::is_convertible_v<T const &, std::string_view>;
+
+  template <typename T>
+  using encoded_type = std::conditional_t<is_string<T>, String, T>;
+
+  template <typename... Args>
+  struct Record final {
+    fmt::string_view str;
+    basic_format_str<>::file_name_type file_name;
+    uint32_t line = {};
+    std::chrono::nanoseconds timestamp = {};
+    std::tuple<encoded_type<Args>...> args;
+
+    static void format(std::byte const *data, fmt::memory_buffer &buffer, Message &message) {
+      auto &record = *std::launder(reinterpret_cast<Record const *>(data));
+      auto values = std::apply([&](auto const &...args) { return std::tuple{decode(data, args)...}; }, record.args);
+      std::apply(
+          [&](auto &...values) {
+            fmt::vformat_to(std::back_inserter(buffer), record.str, fmt::make_format_args(values...));
+          },
+          values);
+      message.timestamp = record.timestamp;
+      message.file_name = record.file_name;
+      message.line = record.line;
+      message.text = {std::data(buffer), std::size(buffer)};
+    }
+  };
+
+  template <typename T>
+  static size_t get_length(T const &value) {
+    if constexpr (is_string<T>) {
+      return std::size(std::string_view{value});
+    } else {
+      return 0;
+    }
+  }
+
+  template <typename T>
+  static encoded_type<T> encode(std::byte *data, uint32_t &offset, T const &value) {
+    if constexpr (is_string<T>) {
+      std::string_view tmp{value};
+      std::copy(std::begin(tmp), std::end(tmp), reinterpret_cast<char *>(data + offset));
+      String result{
+          .offset = offset,
+          .length = static_cast<uint32_t>(std::size(tmp)),
+      };
+      offset += result.length;
+      return result;
+    } else {
+      static_assert(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>, "must be formatted eagerly");
+      return value;
+    }
+  }
+
+  static std::string_view decode(std::byte const *data, String const &value) {
+    return {reinterpret_cast<char const *>(data + value.offset), value.length};
+  }
+
+  template <typename T>
+  static T decode(std::byte const *, T const &value) {
+    return value;
+  }
+
+ private:
+  Handler &handler_;
+  size_t const capacity_;
+  std::chrono::nanoseconds const poll_interval_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  fmt::memory_buffer buffer_;
+  std::jthread thread_;
+};
+
+}  // namespace tools
+}  // namespace roq
@@ -0,0 +1,174 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <string_view>
+#include <vector>
+
+#include "roq/exceptions.hpp"
+#include "roq/fill.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/utils/hash.hpp"
+
+namespace roq {
+namespace tools {
+
+// time-bounded de-duplication of fills (keyed on external_trade_id)
+// - 64-bit fingerprints of (exchange, symbol, external_trade_id)
+// - entries are kept in insertion order (ring) and expire when older than exchange_time_utc - expiry
+// - the oldest entry is evicted when capacity is reached, i.e. memory is bounded
+// - the fingerprint index is an open-addressing (linear probing) table using backward-shift deletion
+// - confirm == true (default) will also store the external_trade_id and compare on fingerprint match (no false
+//   positives)
+// note! confirm == false trades memory for a (small) risk of a fingerprint collision dropping a real fill
+
+struct FillDeduplicator final {
+  struct Config final {
+    size_t capacity = 65536;
+    std::chrono::nanoseconds expiry = std::chrono::hours{24};
+    bool confirm = true;
+  };
+
+  FillDeduplicator() : FillDeduplicator{Config{}} {}
+
+  explicit FillDeduplicator(Config const &config)
+      : config_{config}, ring_(std::max<size_t>(config_.capacity, 1)),
+        table_(std::bit_ceil(2 * std::max<size_t>(config_.capacity, 1))), mask_{std::size(table_) - 1} {
+    if (config_.confirm)
+      trade_ids_.resize(std::size(ring_));
+  }
+
+  FillDeduplicator(FillDeduplicator &&) = default;
+  FillDeduplicator(FillDeduplicator const &) = delete;
+
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  size_t capacity() const { return std::size(ring_); }
+
+  void clear() {
+    std::fill(std::begin(table_), std::end(table_), Slot{});
+    head_ = {};
+    size_ = {};
+    latest_ = {};
+  }
+
+  bool contains(
+      std::string_view const &exchange, std::string_view const &symbol, std::string_view const &trade_id) const {
+    return find(fingerprint(exchange, symbol, trade_id), trade_id) != NOT_FOUND;
+  }
+
+  // returns true if the fill has not been seen before (and then remembers it)
+  bool operator()(std::string_view const &exchange, std::string_view const &symbol, Fill const &fill) {
+    return insert(exchange, symbol, fill.external_trade_id, fill.exchange_time_utc);
+  }
+
+  bool insert(
+      std::string_view const &exchange,
+      std::string_view const &symbol,
+      std::string_view const &trade_id,
+      std::chrono::nanoseconds exchange_time_utc) {
+    auto hash = fingerprint(exchange, symbol, trade_id);
+    if (find(hash, trade_id) != NOT_FOUND)
+      return false;
+    latest_ = std::max(latest_, exchange_time_utc);
+    expire(latest_ - config_.expiry);
+    if (size_ == std::size(ring_))
+      evict();
+    auto index = (head_ + size_) % std::size(ring_);
+    ring_[index] = {
+        .fingerprint = hash,
+        .exchange_time_utc = exchange_time_utc,
+    };
+    if (config_.confirm)
+      trade_ids_[index] = trade_id;
+    auto slot = hash & mask_;
+    while (table_[slot].fingerprint != 0)
+      slot = (slot + 1) & mask_;
+    table_[slot] = {
+        .fingerprint = hash,
+        .index = static_cast<uint32_t>(index),
+    };
+    ++size_;
+    return true;
+  }
+
+ protected:
+  static constexpr size_t const NOT_FOUND = static_cast<size_t>(-1);
+
+  struct Entry final {
+    uint64_t fingerprint = {};
+    std::chrono::nanoseconds exchange_time_utc = {};
+  };
+
+  struct Slot final {
+    uint64_t fingerprint = {};  // note! zero means empty
+    uint32_t index = {};        // ring
+  };
+
+  static uint64_t fingerprint(
+      std::string_view const &exchange, std::string_view const &symbol, std::string_view const &trade_id) {
+    return std::max<uint64_t>(utils::hash_all(exchange, symbol, trade_id), 1);
+  }
+
+  size_t find(uint64_t hash, std::string_view const &trade_id) const {
+    for (auto slot = hash & mask_; table_[slot].fingerprint != 0; slot = (slot + 1) & mask_) {
+      auto &tmp = table_[slot];
+      if (tmp.fingerprint != hash)
+        continue;
+      if (!config_.confirm || trade_ids_[tmp.index] == trade_id) [[likely]]
+        return slot;
+    }
+    return NOT_FOUND;
+  }
+
+  void expire(std::chrono::nanoseconds cutoff) {
+    while (size_ > 0 && ring_[head_].exchange_time_utc < cutoff)
+      evict();
+  }
+
+  void evict() {
+    auto &entry = ring_[head_];
+    for (auto slot = entry.fingerprint & mask_; table_[slot].fingerprint != 0; slot = (slot + 1) & mask_) {
+      if (table_[slot].index == head_) {
+        remove(slot);
+        break;
+      }
+    }
+    head_ = (head_ + 1) % std::size(ring_);
+    --size_;
+  }
+
+  // references:
+  //   https://en.wikipedia.org/wiki/Linear_probing#Deletion
+  void remove(size_t slot) {
+    auto hole = slot;
+    for (auto next = (hole + 1) & mask_; table_[next].fingerprint != 0; next = (next + 1) & mask_) {
+      auto home = table_[next].fingerprint & mask_;
+      // can the entry at next be moved to the hole? (i.e. home is not cyclically in (hole, next])
+      if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+        table_[hole] = table_[next];
+        hole = next;
+      }
+    }
+    table_[hole] = {};
+  }
+
+ private:
+  Config const config_;
+  std::vector<Entry> ring_;
+  std::vector<ExternalTradeId> trade_ids_;
+  std::vector<Slot> table_;
+  size_t const mask_;
+  size_t head_ = {};
+  size_t size_ = {};
+  std::chrono::nanoseconds latest_ = {};
+};
+
+}  // namespace tools
+}  // namespace roq
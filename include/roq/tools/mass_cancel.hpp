@@ -0,0 +1,130 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <limits>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/mask.hpp"
+
+#include "roq/cancel_all_orders.hpp"
+#include "roq/cancel_order.hpp"
+#include "roq/filter.hpp"
+#include "roq/gateway_settings.hpp"
+
+#include "roq/cache/order_cache.hpp"
+
+#include "roq/utils/common.hpp"
+
+namespace roq {
+namespace tools {
+
+// cancel all orders, either natively or by fan-out
+// - native: the gateway (source) supports all the filters required by the request (GatewaySettings)
+// - fan-out: one CancelOrder per matching working order of the source (is_last is only set for the final request)
+// - support is UNKNOWN until GatewaySettings has been received from the source, an empty oms_cancel_all_orders mask
+//   is then interpreted as UNSUPPORTED
+// note! fan-out is used whenever support is not SUPPORTED, i.e. also when UNKNOWN
+// note! cancel requests are also applied to the order cache (request version is incremented)
+// note! fan-out uses the order cache indexes (instrument or strategy) when possible, otherwise all orders are scanned
+
+struct MassCancel final {
+  enum class Support : uint8_t {
+    UNKNOWN,
+    UNSUPPORTED,
+    SUPPORTED,
+  };
+
+  struct Handler {
+    virtual void operator()(CancelAllOrders const &, uint8_t source) = 0;
+    virtual void operator()(CancelOrder const &, uint8_t source, bool is_last) = 0;
+  };
+
+  MassCancel(Handler &handler, cache::OrderCache &order_cache) : handler_{handler}, order_cache_{order_cache} {}
+
+  MassCancel(MassCancel &&) = default;
+  MassCancel(MassCancel const &) = delete;
+
+  void operator()(Event<GatewaySettings> const &event) {
+    auto source = event.message_info.source;
+    supports_[source] = event.value.oms_cancel_all_orders;
+    ready_.set(source);
+  }
+
+  Support get_support(CancelAllOrders const &cancel_all_orders, uint8_t source) const {
+    if (!ready_.test(source))
+      return Support::UNKNOWN;
+    auto required = utils::create_filter(cancel_all_orders);
+    auto &supports = supports_[source];
+    return !supports.empty() && supports.has_all(required) ? Support::SUPPORTED : Support::UNSUPPORTED;
+  }
+
+  bool is_native(CancelAllOrders const &cancel_all_orders, uint8_t source) const {
+    return get_support(cancel_all_orders, source) == Support::SUPPORTED;
+  }
+
+  // returns the number of requests sent
+  size_t operator()(CancelAllOrders const &cancel_all_orders, uint8_t source) {
+    if (is_native(cancel_all_orders, source)) {
+      handler_(cancel_all_orders, source);
+      return 1;
+    }
+    order_ids_.clear();
+    auto callback = [&](auto &order) {
+      if (order.source == source && matches(order, cancel_all_orders))
+        order_ids_.emplace_back(order.order_id);
+    };
+    if (!std::empty(cancel_all_orders.account) && !std::empty(cancel_all_orders.exchange) &&
+        !std::empty(cancel_all_orders.symbol)) {
+      auto for_each = [&](auto side) {
+        order_cache_.for_each(
+            cancel_all_orders.account, cancel_all_orders.exchange, cancel_all_orders.symbol, side, callback);
+      };
+      if (cancel_all_orders.side != Side::SELL)
+        for_each(Side::BUY);
+      if (cancel_all_orders.side != Side::BUY)
+        for_each(Side::SELL);
+    } else if (cancel_all_orders.strategy_id != 0) {
+      order_cache_.for_each_strategy(cancel_all_orders.strategy_id, callback);
+    } else {
+      order_cache_.for_each(callback);
+    }
+    auto size = std::size(order_ids_);
+    for (size_t i = 0; i < size; ++i) {
+      auto order = order_cache_.find(order_ids_[i]);
+      CancelOrder cancel_order{
+          .account = order->account,
+          .order_id = order->order_id,
+          .request_template = {},
+          .routing_id = {},
+          .version = order->max_request_version + 1,
+          .conditional_on_version = {},
+      };
+      order_cache_(cancel_order);
+      handler_(cancel_order, source, (i + 1) == size);
+    }
+    return size;
+  }
+
+ protected:
+  static bool matches(cache::OrderCache::Order const &order, CancelAllOrders const &cancel_all_orders) {
+    return (std::empty(cancel_all_orders.account) || order.account == cancel_all_orders.account) &&
+           (std::empty(cancel_all_orders.exchange) || order.exchange == cancel_all_orders.exchange) &&
+           (std::empty(cancel_all_orders.symbol) || order.symbol == cancel_all_orders.symbol) &&
+           (cancel_all_orders.strategy_id == 0 || order.strategy_id == cancel_all_orders.strategy_id) &&
+           (cancel_all_orders.side == Side::UNDEFINED || order.side == cancel_all_orders.side);
+  }
+
+ private:
+  Handler &handler_;
+  cache::OrderCache &order_cache_;
+  std::array<Mask<Filter>, std::numeric_limits<uint8_t>::max() + 1> supports_ = {};
+  std::bitset<std::numeric_limits<uint8_t>::max() + 1> ready_;
+  std::vector<uint64_t> order_ids_;
+};
+
+}  // namespace tools
+}  // namespace roq
@@ -0,0 +1,356 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <magic_enum.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/mask.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+#include "roq/timer.hpp"
+
+#include "roq/custom_metrics.hpp"
+#include "roq/custom_metrics_update.hpp"
+#include "roq/measurement.hpp"
+
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// aggregation (downsampling) of custom metrics
+// - series are keyed by (label, account, exchange, symbol, measurement key)
+// - each series has a fixed ring buffer of buckets (window), one bucket per interval
+// - samples are accumulated into the current bucket (min, max, sum, count, last)
+// - once per interval (Timer), a CustomMetricsUpdate is published per (label, account, exchange, symbol) and per
+//   configured statistic, only for groups having received samples since the last publication
+// - statistics are computed over the rolling window (all buckets)
+// - the window advances by the number of intervals elapsed since the last Timer, i.e. late or missed timers expire
+//   the corresponding buckets (samples received since the last Timer are kept as the most recent bucket)
+// note! publish() does not advance the window
+
+struct MetricsAggregator final {
+  enum class Statistic : uint8_t {
+    UNDEFINED = 0,
+    MIN = 0x1,
+    MAX = 0x2,
+    MEAN = 0x4,
+    LAST = 0x8,
+    COUNT = 0x10,
+  };
+
+  struct Handler {
+    // note! the handler decides how to route each statistic (e.g. a different label)
+    virtual void operator()(CustomMetricsUpdate const &, Statistic) = 0;
+  };
+
+  struct Config final {
+    std::chrono::nanoseconds interval = std::chrono::seconds{1};
+    size_t window = 60;  // number of intervals
+    Mask<Statistic> statistics = {Statistic::MEAN};
+  };
+
+  struct Aggregate final {
+    double min = NaN;
+    double max = NaN;
+    double mean = NaN;
+    double last = NaN;
+    size_t count = {};
+  };
+
+  MetricsAggregator(Handler &handler, Config const &config)
+      : handler_{handler}, interval_{std::max(config.interval, std::chrono::nanoseconds{1})},
+        window_{std::max<size_t>(config.window, 1)}, statistics_{config.statistics} {}
+
+  MetricsAggregator(MetricsAggregator &&) = default;
+  MetricsAggregator(MetricsAggregator const &) = delete;
+
+  // number of series
+  size_t size() const { return std::size(series_); }
+
+  // returns false if the series is unknown
+  bool get(
+      Aggregate &result,
+      std::string_view const &label,
+      std::string_view const &account,
+      std::string_view const &exchange,
+      std::string_view const &symbol,
+      std::string_view const &key) const {
+    auto group = find_group(label, account, exchange, symbol);
+    if (group == NOT_FOUND)
+      return false;
+    for (auto index : groups_[group].series) {
+      if (series_[index].key != key)
+        continue;
+      result = aggregate(index);
+      return true;
+    }
+    return false;
+  }
+
+  void operator()(CustomMetrics const &custom_metrics) { update(custom_metrics); }
+
+  void operator()(Event<CustomMetricsUpdate> const &event) { update(event.value); }
+
+  void operator()(Event<Timer> const &event) {
+    auto now = event.value.now;
+    if (now < next_)
+      return;
+    // note! intervals elapsed after the current bucket (late or missed timers)
+    auto missed = static_cast<size_t>((now - next_) / interval_);
+    if (missed > 0)
+      expire(missed);
+    publish();
+    advance();
+    next_ += static_cast<int64_t>(missed + 1) * interval_;
+  }
+
+  void publish() {
+    for (auto group : dirty_) {
+      auto &item = groups_[group];
+      item.dirty = false;
+      // note! one pass over the window per series, all statistics are derived from the result
+      aggregates_.clear();
+      for (auto index : item.series) {
+        auto result = aggregate(index);
+        if (result.count > 0)
+          aggregates_.emplace_back(index, result);
+      }
+      for (auto statistic : STATISTICS) {
+        if (!statistics_.has(statistic))
+          continue;
+        measurements_.clear();
+        for (auto &[index, result] : aggregates_)
+          measurements_.emplace_back(Measurement{
+              .name = series_[index].key,
+              .value = get_value(result, statistic),
+          });
+        if (std::empty(measurements_))
+          continue;
+        CustomMetricsUpdate custom_metrics_update{
+            .label = item.label,
+            .account = item.account,
+            .exchange = item.exchange,
+            .symbol = item.symbol,
+            .measurements = measurements_,
+            .update_type = UpdateType::INCREMENTAL,
+            .sending_time_utc = {},
+            .user = {},
+        };
+        handler_(custom_metrics_update, statistic);
+      }
+    }
+    dirty_.clear();
+  }
+
+ protected:
+  static constexpr size_t const NOT_FOUND = static_cast<size_t>(-1);
+
+  static constexpr std::array<Statistic, 5> const STATISTICS{{
+      Statistic::MIN,
+      Statistic::MAX,
+      Statistic::MEAN,
+      Statistic::LAST,
+      Statistic::COUNT,
+  }};
+
+  struct Bucket final {
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0.0;
+    double last = NaN;
+    size_t count = {};
+  };
+
+  struct Series final {
+    MeasurementKey key;
+    size_t group = {};
+  };
+
+  struct Group final {
+    Label label;
+    Account account;
+    Exchange exchange;
+    Symbol symbol;
+    std::vector<size_t> series;
+    bool dirty = false;
+  };
+
+  static double get_value(Aggregate const &aggregate, Statistic statistic) {
+    switch (statistic) {
+      using enum Statistic;
+      case UNDEFINED:
+        break;
+      case MIN:
+        return aggregate.min;
+      case MAX:
+        return aggregate.max;
+      case MEAN:
+        return aggregate.mean;
+      case LAST:
+        return aggregate.last;
+      case COUNT:
+        return static_cast<double>(aggregate.count);
+    }
+    return NaN;
+  }
+
+  void advance() {
+    head_ = (head_ + 1) % window_;
+    for (size_t i = 0; i < std::size(series_); ++i)
+      buckets_[i * window_ + head_] = {};
+  }
+
+  // note! ages the previous buckets by count intervals, the current bucket is kept as the most recent
+  void expire(size_t count) {
+    if (count >= window_) {
+      for (size_t i = 0; i < std::size(series_); ++i)
+        for (size_t j = 1; j < window_; ++j)
+          buckets_[i * window_ + (head_ + j) % window_] = {};
+      return;
+    }
+    // note! the oldest count buckets follow the current bucket
+    auto head = (head_ + count) % window_;
+    for (size_t i = 0; i < std::size(series_); ++i) {
+      auto buckets = std::data(buckets_) + i * window_;
+      auto current = buckets[head_];
+      for (size_t j = 0; j < count; ++j)
+        buckets[(head_ + j) % window_] = {};
+      buckets[head] = current;
+    }
+    head_ = head;
+  }
+
+  // note! most recent bucket first (last)
+  Aggregate aggregate(size_t index) const {
+    Aggregate result;
+    auto min = std::numeric_limits<double>::infinity();
+    auto max = -std::numeric_limits<double>::infinity();
+    auto sum = 0.0;
+    auto buckets = std::data(buckets_) + index * window_;
+    for (size_t i = 0; i < window_; ++i) {
+      auto &bucket = buckets[(head_ + window_ - i) % window_];
+      if (bucket.count == 0)
+        continue;
+      if (result.count == 0)
+        result.last = bucket.last;
+      min = std::min(min, bucket.min);
+      max = std::max(max, bucket.max);
+      sum += bucket.sum;
+      result.count += bucket.count;
+    }
+    if (result.count > 0) {
+      result.min = min;
+      result.max = max;
+      result.mean = sum / static_cast<double>(result.count);
+    }
+    return result;
+  }
+
+  template <typename T>
+  void update(T const &value) {
+    auto group = get_group(value.label, value.account, value.exchange, value.symbol);
+    for (auto &measurement : value.measurements) {
+      if (std::isnan(measurement.value)) [[unlikely]]
+        continue;
+      auto index = get_series(group, measurement.name);
+      auto &bucket = buckets_[index * window_ + head_];
+      bucket.min = std::min(bucket.min, measurement.value);
+      bucket.max = std::max(bucket.max, measurement.value);
+      bucket.sum += measurement.value;
+      bucket.last = measurement.value;
+      ++bucket.count;
+    }
+    auto &item = groups_[group];
+    if (!item.dirty) {
+      item.dirty = true;
+      dirty_.emplace_back(group);
+    }
+  }
+
+  size_t get_series(size_t group, std::string_view const &key) {
+    auto &item = groups_[group];
+    for (auto index : item.series)
+      if (series_[index].key == key) [[likely]]
+        return index;
+    auto index = std::size(series_);
+    auto &series = series_.emplace_back();
+    series.key = key;
+    series.group = group;
+    item.series.emplace_back(index);
+    buckets_.resize(std::size(buckets_) + window_);
+    return index;
+  }
+
+  size_t find_group(
+      std::string_view const &label,
+      std::string_view const &account,
+      std::string_view const &exchange,
+      std::string_view const &symbol) const {
+    return lookup_.find(utils::hash_all(label, account, exchange, symbol), [&](auto index) {
+      auto &group = groups_[index];
+      return group.label == label && group.account == account && group.exchange == exchange && group.symbol == symbol;
+    });
+  }
+
+  size_t get_group(
+      std::string_view const &label,
+      std::string_view const &account,
+      std::string_view const &exchange,
+      std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &group = groups_[index];
+      return group.label == label && group.account == account && group.exchange == exchange && group.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(groups_);
+      auto &group = groups_.emplace_back();
+      group.label = label;
+      group.account = account;
+      group.exchange = exchange;
+      group.symbol = symbol;
+      return index;
+    };
+    return lookup_.get(utils::hash_all(label, account, exchange, symbol), is_match, create);
+  }
+
+ private:
+  Handler &handler_;
+  std::chrono::nanoseconds const interval_;
+  size_t const window_;
+  Mask<Statistic> const statistics_;
+  std::vector<Series> series_;
+  std::vector<Bucket> buckets_;  // note! window_ buckets per series
+  std::vector<Group> groups_;
+  utils::HashIndex lookup_;
+  std::vector<size_t> dirty_;
+  std::vector<std::pair<size_t, Aggregate>> aggregates_;
+  std::vector<Measurement> measurements_;
+  size_t head_ = {};
+  std::chrono::nanoseconds next_ = {};
+};
+
+}  // namespace tools
+}  // namespace roq
+
+template <>
+struct fmt::formatter<roq::tools::MetricsAggregator::Statistic> {
+  constexpr auto parse(format_parse_context &context) { return std::begin(context); }
+  auto format(roq::tools::MetricsAggregator::Statistic const &value, format_context &context) const {
+    using namespace std::literals;
+    return fmt::format_to(context.out(), "{}"sv, magic_enum::enum_name(value));
+  }
+};
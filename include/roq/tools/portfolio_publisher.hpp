@@ -0,0 +1,184 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <chrono>
+#include <string_view>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+#include "roq/timer.hpp"
+
+#include "roq/portfolio.hpp"
+#include "roq/position.hpp"
+
+#include "roq/cache/position_cache.hpp"
+
+#include "roq/utils/compare.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// coalescing publisher of positions (one Portfolio per account, INCREMENTAL)
+// - position updates are accumulated and only instruments changed since the last publication are sent
+// - interval == 0: publish at the end of each batch (MessageInfo::is_last)
+// - interval > 0: publish from Timer events, at most once per interval
+// - the Portfolio is sent to config.source (see client::Dispatcher::send), through the handler
+// - the Position buffer is reused (no allocation once it has grown to the largest publication)
+// note! MessageInfo::is_last is ignored when interval > 0, i.e. changes are held until the next Timer event (or an
+//   explicit flush)
+// note! the first update for an instrument is always published
+
+struct PortfolioPublisher final {
+  struct Handler {
+    virtual void operator()(Portfolio const &, uint8_t source) = 0;
+  };
+
+  struct Config final {
+    std::chrono::nanoseconds interval = {};
+    std::string_view user;
+    uint32_t strategy_id = {};
+    uint8_t source = {};
+  };
+
+  PortfolioPublisher(Handler &handler, Config const &config)
+      : handler_{handler}, interval_{config.interval}, user_{config.user}, strategy_id_{config.strategy_id},
+        source_{config.source} {}
+
+  PortfolioPublisher(PortfolioPublisher &&) = default;
+  PortfolioPublisher(PortfolioPublisher const &) = delete;
+
+  // number of instruments with pending changes
+  size_t pending() const { return pending_; }
+
+  void update(
+      std::string_view const &account,
+      std::string_view const &exchange,
+      std::string_view const &symbol,
+      double long_position,
+      double short_position) {
+    auto &item = get(account, exchange, symbol);
+    item.position.long_position = long_position;
+    item.position.short_position = short_position;
+    if (item.dirty)
+      return;
+    item.dirty = true;
+    accounts_[item.account].dirty.emplace_back(static_cast<size_t>(&item - std::data(items_)));
+    ++pending_;
+  }
+
+  // note! typically used with the result from cache::PositionCache
+  void operator()(cache::PositionCache::Position const &position, MessageInfo const &message_info) {
+    update(position.account, position.exchange, position.symbol, position.long_quantity, position.short_quantity);
+    if (interval_.count() == 0 && message_info.is_last)
+      flush();
+  }
+
+  void operator()(Event<Timer> const &event) {
+    auto now = event.value.now;
+    if (interval_.count() == 0 || now < next_)
+      return;
+    flush();
+    next_ = now + interval_;
+  }
+
+  // returns the number of Portfolio messages sent
+  size_t flush() {
+    if (pending_ == 0)
+      return 0;
+    size_t result = {};
+    for (auto &account : accounts_) {
+      if (std::empty(account.dirty))
+        continue;
+      buffer_.clear();
+      for (auto index : account.dirty) {
+        auto &item = items_[index];
+        item.dirty = false;
+        // note! changes may have been reverted since the last publication
+        if (utils::is_equal(item.position.long_position, item.published_long_position) &&
+            utils::is_equal(item.position.short_position, item.published_short_position))
+          continue;
+        item.published_long_position = item.position.long_position;
+        item.published_short_position = item.position.short_position;
+        buffer_.emplace_back(item.position);
+      }
+      account.dirty.clear();
+      if (std::empty(buffer_))
+        continue;
+      Portfolio portfolio{
+          .user = user_,
+          .strategy_id = strategy_id_,
+          .account = account.name,
+          .positions = buffer_,
+          .update_type = UpdateType::INCREMENTAL,
+          .exchange_time_utc = {},
+          .session_id = {},
+          .seqno = {},
+      };
+      handler_(portfolio, source_);
+      ++result;
+    }
+    pending_ = {};
+    return result;
+  }
+
+ protected:
+  struct Item final {
+    size_t account = {};
+    Position position;
+    double published_long_position = NaN;
+    double published_short_position = NaN;
+    bool dirty = false;
+  };
+
+  struct Group final {
+    Account name;
+    std::vector<size_t> dirty;
+  };
+
+  Item &get(std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &item = items_[index];
+      return accounts_[item.account].name == account && item.position.exchange == exchange &&
+             item.position.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(items_);
+      auto &item = items_.emplace_back();
+      item.account = get_account(account);
+      item.position.exchange = exchange;
+      item.position.symbol = symbol;
+      return index;
+    };
+    return items_[lookup_.get(utils::hash_all(account, exchange, symbol), is_match, create)];
+  }
+
+  size_t get_account(std::string_view const &account) {
+    for (size_t i = 0; i < std::size(accounts_); ++i)
+      if (accounts_[i].name == account)
+        return i;
+    auto index = std::size(accounts_);
+    accounts_.emplace_back().name = account;
+    return index;
+  }
+
+ private:
+  Handler &handler_;
+  std::chrono::nanoseconds const interval_;
+  User const user_;
+  uint32_t const strategy_id_;
+  uint8_t const source_;
+  std::vector<Item> items_;
+  utils::HashIndex lookup_;
+  std::vector<Group> accounts_;
+  std::vector<Position> buffer_;
+  size_t pending_ = {};
+  std::chrono::nanoseconds next_ = {};
+};
+
+}  // namespace tools
+}  // namespace roq
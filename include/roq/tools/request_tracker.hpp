@@ -0,0 +1,364 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/string_types.hpp"
+#include "roq/timer.hpp"
+#include "roq/trace_info.hpp"
+
+#include "roq/cancel_order.hpp"
+#include "roq/create_order.hpp"
+#include "roq/modify_order.hpp"
+
+#include "roq/order_ack.hpp"
+
+#include "roq/metrics/histogram.hpp"
+
+#include "roq/utils/common.hpp"
+
+namespace roq {
+namespace tools {
+
+// tracks pending order requests (create/modify/cancel) until a final OrderAck or a timeout
+// - requests are matched by (order_id, version), create requests have version 1
+// - timeouts are managed by a hierarchical timing wheel (4 levels of 64 slots) driven by Timer events
+// - register, ack and expire are O(1) (expire is amortized over the cascading between wheel levels)
+// - occupied slots are tracked by a bitmap per level, advance jumps directly to the next occupied slot, i.e. the cost
+//   does not depend on the number of elapsed ticks
+// - request latency (origin create time to receive time of the final ack) is recorded into a histogram
+// note! TraceInfo::origin_create_time is the start of the request lifecycle (monotonic clock)
+// note! the timeout resolution is Config::resolution (or the timer frequency, if less frequent)
+
+struct RequestTracker final {
+  struct Request final {
+    uint64_t order_id = {};
+    uint32_t version = {};
+    RequestType request_type = {};
+    RequestStatus request_status = {};
+    Account account;
+    std::chrono::nanoseconds create_time = {};  // monotonic
+  };
+
+  struct Handler {
+    // note! request_status is TIMEOUT
+    virtual void operator()(Request const &) = 0;
+  };
+
+  struct Config final {
+    std::chrono::nanoseconds timeout = std::chrono::seconds{5};
+    std::chrono::nanoseconds resolution = std::chrono::milliseconds{1};
+  };
+
+  RequestTracker(Handler &handler, Config const &config) : handler_{handler}, config_{config} {}
+
+  RequestTracker(RequestTracker &&) = default;
+  RequestTracker(RequestTracker const &) = delete;
+
+  // number of pending requests
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  uint64_t timeouts() const { return timeouts_; }
+
+  metrics::Histogram const &latency() const { return latency_; }
+
+  Request const *find(uint64_t order_id, uint32_t version) const {
+    auto index = find_index(order_id, version);
+    if (index == NONE)
+      return nullptr;
+    return &entries_[index].request;
+  }
+
+  // requests
+
+  void operator()(CreateOrder const &create_order, TraceInfo const &trace_info) {
+    add(create_order.order_id, 1, RequestType::CREATE_ORDER, create_order.account, trace_info);
+  }
+
+  void operator()(ModifyOrder const &modify_order, TraceInfo const &trace_info) {
+    add(modify_order.order_id, modify_order.version, RequestType::MODIFY_ORDER, modify_order.account, trace_info);
+  }
+
+  void operator()(CancelOrder const &cancel_order, TraceInfo const &trace_info) {
+    add(cancel_order.order_id, cancel_order.version, RequestType::CANCEL_ORDER, cancel_order.account, trace_info);
+  }
+
+  // responses
+
+  // returns true if the ack matched a pending request
+  bool operator()(Event<OrderAck> const &event) {
+    auto &order_ack = event.value;
+    auto index = find_index(order_ack.order_id, order_ack.version);
+    if (index == NONE)
+      return false;
+    auto &entry = entries_[index];
+    entry.request.request_status = order_ack.request_status;
+    if (utils::has_request_maybe_completed(order_ack.request_status)) {
+      latency_.update(event.message_info.receive_time - entry.request.create_time);
+      remove(index);
+    }
+    return true;
+  }
+
+  void operator()(Event<Timer> const &event) { advance(event.value.now); }
+
+ protected:
+  static constexpr uint32_t const NONE = std::numeric_limits<uint32_t>::max();
+
+  static constexpr size_t const BITS = 6;
+  static constexpr size_t const SLOTS = size_t{1} << BITS;
+  static constexpr size_t const LEVELS = 4;
+
+  static_assert(SLOTS == 64, "occupied_ uses one uint64_t per level");
+
+  struct Entry final {
+    Request request;
+    uint64_t expire_tick = {};
+    uint32_t prev = NONE;  // wheel slot
+    uint32_t next = NONE;  // wheel slot (or free list)
+    uint32_t slot = NONE;
+    uint32_t next_order = NONE;  // pending requests for the same order_id
+  };
+
+  uint64_t to_tick(std::chrono::nanoseconds value) const {
+    return static_cast<uint64_t>(std::max<int64_t>(value.count(), 0)) /
+           static_cast<uint64_t>(std::max<int64_t>(config_.resolution.count(), 1));
+  }
+
+  uint32_t find_index(uint64_t order_id, uint32_t version) const {
+    auto iter = orders_.find(order_id);
+    if (iter == std::end(orders_))
+      return NONE;
+    for (auto index = (*iter).second; index != NONE; index = entries_[index].next_order)
+      if (entries_[index].request.version == version)
+        return index;
+    return NONE;
+  }
+
+  void add(
+      uint64_t order_id,
+      uint32_t version,
+      RequestType request_type,
+      std::string_view const &account,
+      TraceInfo const &trace_info) {
+    // note! a request re-using (order_id, version) replaces the previous one
+    if (auto index = find_index(order_id, version); index != NONE)
+      remove(index);
+    auto create_time = trace_info.origin_create_time;
+    if (!initialized_) {
+      current_tick_ = to_tick(create_time);
+      initialized_ = true;
+    }
+    auto index = allocate();
+    auto &entry = entries_[index];
+    entry.request = {
+        .order_id = order_id,
+        .version = version,
+        .request_type = request_type,
+        .request_status = RequestStatus::FORWARDED,
+        .account = account,
+        .create_time = create_time,
+    };
+    // note! rounding up, i.e. never early
+    entry.expire_tick = to_tick(create_time + config_.timeout - std::chrono::nanoseconds{1}) + 1;
+    auto &head = (*orders_.try_emplace(order_id, NONE).first).second;
+    entry.next_order = head;
+    head = index;
+    schedule(index, current_tick_ + 1);
+    ++size_;
+  }
+
+  void remove(uint32_t index) {
+    auto &entry = entries_[index];
+    unlink(index);
+    auto iter = orders_.find(entry.request.order_id);
+    if (iter != std::end(orders_)) {
+      auto &head = (*iter).second;
+      if (head == index) {
+        head = entry.next_order;
+        if (head == NONE)
+          orders_.erase(iter);
+      } else {
+        for (auto tmp = head; tmp != NONE; tmp = entries_[tmp].next_order) {
+          if (entries_[tmp].next_order == index) {
+            entries_[tmp].next_order = entry.next_order;
+            break;
+          }
+        }
+      }
+    }
+    release(index);
+    --size_;
+  }
+
+  // timing wheel
+
+  // note! min_tick is the first tick not yet processed
+  void schedule(uint32_t index, uint64_t min_tick) {
+    auto &entry = entries_[index];
+    auto expire = std::max(entry.expire_tick, min_tick);
+    size_t level = 0;
+    while (level < (LEVELS - 1) && (expire >> (BITS * (level + 1))) != (current_tick_ >> (BITS * (level + 1))))
+      ++level;
+    size_t digit = (expire >> (BITS * level)) & (SLOTS - 1);
+    // note! beyond the range of the wheel: park in the top-level slot cascaded last (will be re-scheduled)
+    if ((expire >> (BITS * LEVELS)) != (current_tick_ >> (BITS * LEVELS)))
+      digit = ((current_tick_ >> (BITS * level)) - 1) & (SLOTS - 1);
+    link(static_cast<uint32_t>(level * SLOTS + digit), index);
+  }
+
+  void advance(std::chrono::nanoseconds now) {
+    auto tick = to_tick(now);
+    if (!initialized_ || size_ == 0) {
+      current_tick_ = std::max(current_tick_, tick);
+      initialized_ = true;
+      return;
+    }
+    while (current_tick_ < tick && size_ > 0) {
+      // note! empty slots are skipped (processing those would be a no-op)
+      auto next = next_tick();
+      if (next > tick)
+        break;
+      current_tick_ = next;
+      // cascade (highest level first)
+      for (auto level = LEVELS - 1; level > 0; --level) {
+        if ((current_tick_ & ((uint64_t{1} << (BITS * level)) - 1)) != 0)
+          continue;
+        auto slot = static_cast<uint32_t>(level * SLOTS + ((current_tick_ >> (BITS * level)) & (SLOTS - 1)));
+        for (auto index = detach(slot); index != NONE;) {
+          auto next = entries_[index].next;
+          schedule(index, current_tick_);
+          index = next;
+        }
+      }
+      // expire
+      auto slot = static_cast<uint32_t>(current_tick_ & (SLOTS - 1));
+      for (auto index = detach(slot); index != NONE;) {
+        auto next = entries_[index].next;
+        if (entries_[index].expire_tick <= current_tick_) {
+          auto &request = expired_.emplace_back(entries_[index].request);
+          request.request_status = RequestStatus::TIMEOUT;
+          remove(index);
+        } else {
+          schedule(index, current_tick_ + 1);
+        }
+        index = next;
+      }
+      // note! dispatch when the wheel is consistent (the handler may send new requests)
+      for (auto &request : expired_) {
+        ++timeouts_;
+        handler_(request);
+      }
+      expired_.clear();
+    }
+    current_tick_ = std::max(current_tick_, tick);
+  }
+
+  // first tick (after current_tick_) processing an occupied slot
+  uint64_t next_tick() const {
+    auto result = std::numeric_limits<uint64_t>::max();
+    for (size_t level = 0; level < LEVELS; ++level) {
+      auto occupied = occupied_[level];
+      if (occupied == 0)
+        continue;
+      // note! level 0 slots are processed on every tick, higher levels only on their boundary
+      auto base = (current_tick_ >> (BITS * level)) + 1;
+      auto offset = static_cast<int>(base & (SLOTS - 1));
+      auto tmp = (base + std::countr_zero(std::rotr(occupied, offset))) << (BITS * level);
+      result = std::min(result, tmp);
+    }
+    return result;
+  }
+
+  void link(uint32_t slot, uint32_t index) {
+    auto &entry = entries_[index];
+    auto &head = wheel_[slot];
+    occupied_[slot / SLOTS] |= uint64_t{1} << (slot % SLOTS);
+    entry.slot = slot;
+    entry.prev = NONE;
+    entry.next = head;
+    if (head != NONE)
+      entries_[head].prev = index;
+    head = index;
+  }
+
+  void unlink(uint32_t index) {
+    auto &entry = entries_[index];
+    if (entry.slot == NONE)
+      return;
+    if (entry.prev != NONE)
+      entries_[entry.prev].next = entry.next;
+    else
+      wheel_[entry.slot] = entry.next;
+    if (wheel_[entry.slot] == NONE)
+      occupied_[entry.slot / SLOTS] &= ~(uint64_t{1} << (entry.slot % SLOTS));
+    if (entry.next != NONE)
+      entries_[entry.next].prev = entry.prev;
+    entry.slot = NONE;
+    entry.prev = NONE;
+    entry.next = NONE;
+  }
+
+  // note! entries keep their next link (used for iteration)
+  uint32_t detach(uint32_t slot) {
+    auto head = wheel_[slot];
+    wheel_[slot] = NONE;
+    occupied_[slot / SLOTS] &= ~(uint64_t{1} << (slot % SLOTS));
+    for (auto index = head; index != NONE; index = entries_[index].next)
+      entries_[index].slot = NONE;
+    return head;
+  }
+
+  // storage
+
+  uint32_t allocate() {
+    if (free_ != NONE) {
+      auto index = free_;
+      free_ = entries_[index].next;
+      entries_[index] = {};
+      return index;
+    }
+    auto index = static_cast<uint32_t>(std::size(entries_));
+    entries_.emplace_back();
+    return index;
+  }
+
+  void release(uint32_t index) {
+    entries_[index].next = free_;
+    free_ = index;
+  }
+
+ private:
+  Handler &handler_;
+  Config const config_;
+  std::vector<Entry> entries_;
+  uint32_t free_ = NONE;
+  std::unordered_map<uint64_t, uint32_t> orders_;
+  std::array<uint32_t, LEVELS * SLOTS> wheel_ = make_wheel();
+  std::array<uint64_t, LEVELS> occupied_ = {};  // note! one bit per slot
+  uint64_t current_tick_ = {};
+  bool initialized_ = false;
+  size_t size_ = {};
+  uint64_t timeouts_ = {};
+  metrics::Histogram latency_;
+  std::vector<Request> expired_;
+
+  static constexpr std::array<uint32_t, LEVELS * SLOTS> make_wheel() {
+    std::array<uint32_t, LEVELS * SLOTS> result;
+    result.fill(NONE);
+    return result;
+  }
+};
+
+}  // namespace tools
+}  // namespace roq
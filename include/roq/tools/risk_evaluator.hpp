@@ -0,0 +1,310 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "roq/error.hpp"
+#include "roq/event.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/create_order.hpp"
+#include "roq/modify_order.hpp"
+
+#include "roq/order_ack.hpp"
+#include "roq/order_update.hpp"
+#include "roq/risk_limits_update.hpp"
+#include "roq/trade_update.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+#include "roq/utils/update.hpp"
+
+#include "roq/tools/fill_deduplicator.hpp"
+
+namespace roq {
+namespace tools {
+
+// pre-trade risk evaluation of create/modify order requests against RiskLimit's
+// - running totals per (account, exchange, symbol): position (from fills) and working quantity (from order updates)
+// - a check is a couple of additions and comparisons, a NaN limit means "no limit"
+// - position limit: position + order quantity
+// - risk exposure limit: position + working quantity + change to working quantity
+// - allow_netting means the opposite position is deducted
+// - fills are de-duplicated using external_trade_id (time-bounded, see tools::FillDeduplicator)
+// note! accepted requests immediately reserve working quantity, the reservation is released (create) or reverted
+//   (modify) if the request fails (OrderAck) before an OrderUpdate has been received
+// note! NaN or non-positive order quantities are rejected (INVALID_QUANTITY) before any totals are updated
+// note! create requests are rejected if the side is undefined (INVALID_SIDE) or the order_id is already known
+//   (INVALID_ORDER_ID)
+// note! limits from RiskLimitsUpdate are applied as a single batch on the dispatching thread, i.e. a check will
+//   never observe a partially applied update and no locking is required
+// note! a NaN position from RiskLimitsUpdate means "unchanged" (a NaN position would make every limit check pass)
+
+struct RiskEvaluator final {
+  struct Limits final {
+    double long_position_limit = NaN;
+    double short_position_limit = NaN;
+    double long_risk_exposure_limit = NaN;
+    double short_risk_exposure_limit = NaN;
+    bool allow_netting = false;
+  };
+
+  struct Instrument final {
+    Account account;
+    Exchange exchange;
+    Symbol symbol;
+    Limits limits;
+    double long_position = 0.0;
+    double short_position = 0.0;
+    double buy_working = 0.0;
+    double sell_working = 0.0;
+  };
+
+  RiskEvaluator() = default;
+
+  explicit RiskEvaluator(FillDeduplicator::Config const &config) : fill_deduplicator_{config} {}
+
+  RiskEvaluator(RiskEvaluator &&) = default;
+  RiskEvaluator(RiskEvaluator const &) = delete;
+
+  Instrument const *find(
+      std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol) const {
+    auto index = lookup_.find(utils::hash_all(account, exchange, symbol), [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.account == account && instrument.exchange == exchange && instrument.symbol == symbol;
+    });
+    return index == utils::HashIndex::NOT_FOUND ? nullptr : &instruments_[index];
+  }
+
+  // requests (returns Error::UNDEFINED if accepted)
+
+  Error operator()(CreateOrder const &create_order) {
+    if (!is_valid_quantity(create_order.quantity)) [[unlikely]]
+      return Error::INVALID_QUANTITY;
+    if (create_order.side == Side::UNDEFINED) [[unlikely]]
+      return Error::INVALID_SIDE;
+    // note! the working quantity of a known order has already been reserved
+    if (orders_.contains(create_order.order_id)) [[unlikely]]
+      return Error::INVALID_ORDER_ID;
+    auto index = get(create_order.account, create_order.exchange, create_order.symbol);
+    auto &instrument = instruments_[index];
+    if (!check(instrument, create_order.side, create_order.quantity, create_order.quantity))
+      return Error::RISK_LIMIT_REACHED;
+    orders_.emplace(
+        create_order.order_id,
+        Order{
+            .index = index,
+            .side = create_order.side,
+            .working = create_order.quantity,
+            .revert = 0.0,
+        });
+    working(instrument, create_order.side) += create_order.quantity;
+    return {};
+  }
+
+  Error operator()(ModifyOrder const &modify_order) {
+    auto iter = orders_.find(modify_order.order_id);
+    if (iter == std::end(orders_))
+      return Error::UNKNOWN_ORDER_ID;
+    auto &order = (*iter).second;
+    if (std::isnan(modify_order.quantity))
+      return {};
+    if (!is_valid_quantity(modify_order.quantity)) [[unlikely]]
+      return Error::INVALID_QUANTITY;
+    auto &instrument = instruments_[order.index];
+    auto delta = modify_order.quantity - order.working;
+    if (delta > 0.0 && !check(instrument, order.side, modify_order.quantity, delta))
+      return Error::RISK_LIMIT_REACHED;
+    if (std::isnan(order.revert))
+      order.revert = order.working;
+    working(instrument, order.side) += delta;
+    order.working = modify_order.quantity;
+    return {};
+  }
+
+  // responses
+
+  void operator()(Event<OrderAck> const &event) {
+    auto &order_ack = event.value;
+    auto iter = orders_.find(order_ack.order_id);
+    if (iter == std::end(orders_))
+      return;
+    auto &order = (*iter).second;
+    // note! an order update (if any) has already established the working quantity
+    if (std::isnan(order.revert))
+      return;
+    if (order_ack.request_status == RequestStatus::ACCEPTED) {
+      order.revert = NaN;
+      return;
+    }
+    if (!utils::has_request_failed(order_ack.request_status))
+      return;
+    switch (order_ack.request_type) {
+      using enum RequestType;
+      case UNDEFINED:
+        break;
+      case CREATE_ORDER:
+        working(instruments_[order.index], order.side) -= order.working;
+        orders_.erase(iter);
+        break;
+      case MODIFY_ORDER:
+        working(instruments_[order.index], order.side) += order.revert - order.working;
+        order.working = order.revert;
+        order.revert = NaN;
+        break;
+      case CANCEL_ORDER:
+        break;
+    }
+  }
+
+  void operator()(Event<OrderUpdate> const &event) {
+    auto &order_update = event.value;
+    auto iter = orders_.find(order_update.order_id);
+    if (iter == std::end(orders_)) {
+      // note! download or orders created by another process
+      if (utils::is_order_complete(order_update.order_status) || std::isnan(order_update.remaining_quantity))
+        return;
+      auto index = get(order_update.account, order_update.exchange, order_update.symbol);
+      iter = orders_
+                 .emplace(
+                     order_update.order_id,
+                     Order{
+                         .index = index,
+                         .side = order_update.side,
+                         .working = 0.0,
+                     })
+                 .first;
+    }
+    auto &order = (*iter).second;
+    auto &instrument = instruments_[order.index];
+    auto remaining_quantity = utils::is_order_complete(order_update.order_status) ? 0.0
+                              : std::isnan(order_update.remaining_quantity)    ? order.working
+                                                                               : order_update.remaining_quantity;
+    working(instrument, order.side) += remaining_quantity - order.working;
+    order.working = remaining_quantity;
+    order.revert = NaN;
+    if (utils::is_order_complete(order_update.order_status))
+      orders_.erase(iter);
+  }
+
+  void operator()(Event<TradeUpdate> const &event) {
+    auto &trade_update = event.value;
+    auto &instrument = instruments_[get(trade_update.account, trade_update.exchange, trade_update.symbol)];
+    for (auto &fill : trade_update.fills) {
+      if (std::isnan(fill.quantity)) [[unlikely]]
+        continue;
+      // note! replayed fills (e.g. after reconnect or download) must not be applied twice
+      if (!std::empty(fill.external_trade_id) && !fill_deduplicator_(trade_update.exchange, trade_update.symbol, fill))
+        continue;
+      switch (trade_update.side) {
+        using enum Side;
+        case UNDEFINED:
+          break;
+        case BUY:
+          apply(instrument.long_position, instrument.short_position, instrument.limits.allow_netting, fill.quantity);
+          break;
+        case SELL:
+          apply(instrument.short_position, instrument.long_position, instrument.limits.allow_netting, fill.quantity);
+          break;
+      }
+    }
+  }
+
+  void operator()(Event<RiskLimitsUpdate> const &event) {
+    auto &risk_limits_update = event.value;
+    if (utils::is_snapshot(risk_limits_update.update_type))
+      for (auto &instrument : instruments_)
+        if (instrument.account == risk_limits_update.account)
+          instrument.limits = {};
+    for (auto &risk_limit : risk_limits_update.limits) {
+      auto &instrument = instruments_[get(risk_limits_update.account, risk_limit.exchange, risk_limit.symbol)];
+      instrument.limits = {
+          .long_position_limit = risk_limit.long_position_limit,
+          .short_position_limit = risk_limit.short_position_limit,
+          .long_risk_exposure_limit = risk_limit.long_risk_exposure_limit,
+          .short_risk_exposure_limit = risk_limit.short_risk_exposure_limit,
+          .allow_netting = risk_limit.allow_netting,
+      };
+      utils::update(instrument.long_position, risk_limit.long_position);
+      utils::update(instrument.short_position, risk_limit.short_position);
+    }
+  }
+
+ protected:
+  struct Order final {
+    size_t index = {};
+    Side side = {};
+    double working = 0.0;
+    double revert = NaN;  // working quantity to revert to if the pending request fails
+  };
+
+  static bool is_valid_quantity(double quantity) { return !std::isnan(quantity) && quantity > 0.0; }
+
+  // note! comparisons are false for NaN, i.e. a missing limit will always pass
+  // note! delta is the change to working quantity (differs from quantity when modifying an order)
+  static bool check(Instrument const &instrument, Side side, double quantity, double delta) {
+    auto &limits = instrument.limits;
+    switch (side) {
+      using enum Side;
+      case UNDEFINED:
+        break;
+      case BUY: {
+        auto position = limits.allow_netting ? (instrument.long_position - instrument.short_position)
+                                             : instrument.long_position;
+        return !((position + quantity) > limits.long_position_limit) &&
+               !((position + instrument.buy_working + delta) > limits.long_risk_exposure_limit);
+      }
+      case SELL: {
+        auto position = limits.allow_netting ? (instrument.short_position - instrument.long_position)
+                                             : instrument.short_position;
+        return !((position + quantity) > limits.short_position_limit) &&
+               !((position + instrument.sell_working + delta) > limits.short_risk_exposure_limit);
+      }
+    }
+    return false;
+  }
+
+  static double &working(Instrument &instrument, Side side) {
+    return side == Side::SELL ? instrument.sell_working : instrument.buy_working;
+  }
+
+  static void apply(double &position, double &opposite, bool allow_netting, double quantity) {
+    if (allow_netting) {
+      auto reduce = std::min(quantity, opposite);
+      opposite -= reduce;
+      quantity -= reduce;
+    }
+    position += quantity;
+  }
+
+  size_t get(std::string_view const &account, std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.account == account && instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = instruments_.emplace_back();
+      instrument.account = account;
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      return index;
+    };
+    return lookup_.get(utils::hash_all(account, exchange, symbol), is_match, create);
+  }
+
+ private:
+  std::vector<Instrument> instruments_;
+  utils::HashIndex lookup_;
+  std::unordered_map<uint64_t, Order> orders_;
+  FillDeduplicator fill_deduplicator_;
+};
+
+}  // namespace tools
+}  // namespace roq
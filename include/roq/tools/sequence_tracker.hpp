@@ -0,0 +1,276 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/string_types.hpp"
+#include "roq/timer.hpp"
+
+#include "roq/utils/common.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// sequence tracking (gap detection and re-ordering) per (source, stream_id, exchange, symbol)
+// - messages are released (callback) in sequence order
+// - messages arriving ahead of the expected sequence are buffered (as T) in a fixed window
+// - a gap is declared (handler) when a message falls beyond the window, or when a buffered message has been waiting
+//   longer than the timeout (Timer), buffered messages following the gap are then released
+// - a message beyond the window resets the window, i.e. buffered messages are released and everything missing up to
+//   that message is declared as gap (once), the message is then released
+// - a SNAPSHOT (if the message has an update_type) resets the expected sequence
+// - duplicates (older than expected, including stale snapshots) are dropped
+// note! T must be constructible from the message, i.e. an owning copy (messages only hold views)
+// note! the callback is either called with the message (in order) or with T (previously buffered)
+// note! a sequence number of zero means "unknown" and the message is released immediately
+
+template <typename T>
+struct SequenceTracker final {
+  struct Gap final {
+    uint8_t source = {};
+    uint16_t stream_id = {};
+    std::string_view exchange;
+    std::string_view symbol;
+    uint64_t first = {};  // first missing
+    uint64_t last = {};   // last missing
+  };
+
+  struct Handler {
+    virtual void operator()(Gap const &) = 0;
+  };
+
+  struct Config final {
+    size_t window = 16;
+    std::chrono::nanoseconds timeout = std::chrono::milliseconds{1};
+  };
+
+  SequenceTracker(Handler &handler, Config const &config)
+      : handler_{handler}, window_{std::max<size_t>(config.window, 1)}, timeout_{config.timeout} {}
+
+  SequenceTracker(SequenceTracker &&) = default;
+  SequenceTracker(SequenceTracker const &) = delete;
+
+  // number of missing messages
+  uint64_t missing() const { return missing_; }
+
+  // number of dropped messages
+  uint64_t duplicates() const { return duplicates_; }
+
+  // number of buffered messages (out of order)
+  uint64_t reordered() const { return reordered_; }
+
+  // note! U must have stream_id, exchange, symbol and exchange_sequence
+  template <typename U, typename Callback>
+  void operator()(Event<U> const &event, Callback callback) {
+    auto &[message_info, value] = event;
+    auto snapshot = false;
+    if constexpr (requires { value.update_type; })
+      snapshot = utils::is_snapshot(value.update_type);
+    (*this)(
+        message_info.source,
+        value.stream_id,
+        value.exchange,
+        value.symbol,
+        value.exchange_sequence,
+        snapshot,
+        message_info.receive_time,
+        value,
+        callback);
+  }
+
+  template <typename U, typename Callback>
+  void operator()(
+      uint8_t source,
+      uint16_t stream_id,
+      std::string_view const &exchange,
+      std::string_view const &symbol,
+      uint64_t sequence,
+      bool snapshot,
+      std::chrono::nanoseconds now,
+      U const &value,
+      Callback callback) {
+    if (sequence == 0) {
+      callback(value);
+      return;
+    }
+    auto &stream = get_stream(source, stream_id, exchange, symbol);
+    if (stream.next == 0) {
+      stream.next = sequence;
+    } else if (sequence < stream.next) {
+      // note! also a stale snapshot, buffered messages would otherwise be released out of order
+      ++duplicates_;
+      return;
+    } else if (snapshot) {
+      discard(stream, sequence + 1);
+      stream.next = sequence;
+    } else if (sequence >= (stream.next + window_)) {
+      // note! reset, release (or skip) everything up to sequence
+      release(stream, sequence, true, callback);
+    }
+    if (sequence == stream.next) [[likely]] {
+      callback(value);
+      ++stream.next;
+      drain(stream, callback);
+      return;
+    }
+    auto &slot = stream.slots[sequence % window_];
+    if (slot) {
+      ++duplicates_;
+      return;
+    }
+    slot.emplace(value);
+    ++reordered_;
+    if (stream.buffered++ == 0)
+      stream.since = now;
+    if (!stream.pending) {
+      stream.pending = true;
+      pending_.emplace_back(&stream);
+    }
+  }
+
+  // release buffered messages having timed out
+  template <typename Callback>
+  void operator()(Event<Timer> const &event, Callback callback) {
+    auto now = event.value.now;
+    for (size_t i = 0; i < std::size(pending_);) {
+      auto &stream = *pending_[i];
+      if (stream.buffered > 0 && now < (stream.since + timeout_)) {
+        ++i;
+        continue;
+      }
+      if (stream.buffered > 0)
+        release(stream, stream.next + window_, false, callback);
+      stream.pending = false;
+      pending_[i] = pending_.back();
+      pending_.pop_back();
+    }
+  }
+
+ protected:
+  struct Stream final {
+    uint8_t source = {};
+    uint16_t stream_id = {};
+    Exchange exchange;
+    Symbol symbol;
+    uint64_t next = {};  // expected sequence
+    std::vector<std::optional<T>> slots;
+    size_t buffered = {};
+    std::chrono::nanoseconds since = {};
+    bool pending = false;
+  };
+
+  // release buffered messages in order (and skip missing) until next == sequence
+  // note! skip == false stops after the last buffered message
+  template <typename Callback>
+  void release(Stream &stream, uint64_t sequence, bool skip, Callback callback) {
+    uint64_t first = {};
+    while (stream.next < sequence && stream.buffered > 0) {
+      auto &slot = stream.slots[stream.next % window_];
+      if (slot) {
+        if (first)
+          gap(stream, first, stream.next - 1);
+        first = {};
+        callback(std::as_const(*slot));
+        slot.reset();
+        --stream.buffered;
+      } else if (!first) {
+        first = stream.next;
+      }
+      ++stream.next;
+    }
+    if (skip && stream.next < sequence) {
+      if (!first)
+        first = stream.next;
+      stream.next = sequence;
+    }
+    if (first)
+      gap(stream, first, stream.next - 1);
+    drain(stream, callback);
+  }
+
+  template <typename Callback>
+  void drain(Stream &stream, Callback callback) {
+    while (stream.buffered > 0) {
+      auto &slot = stream.slots[stream.next % window_];
+      if (!slot)
+        break;
+      callback(std::as_const(*slot));
+      slot.reset();
+      --stream.buffered;
+      ++stream.next;
+    }
+  }
+
+  // drop buffered messages older than sequence
+  void discard(Stream &stream, uint64_t sequence) {
+    for (auto &slot : stream.slots) {
+      if (stream.buffered == 0)
+        break;
+      if (!slot)
+        continue;
+      // note! buffered messages are in [next, next + window)
+      auto offset = (&slot - std::data(stream.slots) + window_ - stream.next % window_) % window_;
+      if (stream.next + offset < sequence) {
+        slot.reset();
+        --stream.buffered;
+      }
+    }
+  }
+
+  void gap(Stream &stream, uint64_t first, uint64_t last) {
+    missing_ += last - first + 1;
+    Gap gap{
+        .source = stream.source,
+        .stream_id = stream.stream_id,
+        .exchange = stream.exchange,
+        .symbol = stream.symbol,
+        .first = first,
+        .last = last,
+    };
+    handler_(std::as_const(gap));
+  }
+
+  Stream &get_stream(
+      uint8_t source, uint16_t stream_id, std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &stream = *streams_[index];
+      return stream.source == source && stream.stream_id == stream_id && stream.exchange == exchange &&
+             stream.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(streams_);
+      auto &stream = *streams_.emplace_back(std::make_unique<Stream>());
+      stream.source = source;
+      stream.stream_id = stream_id;
+      stream.exchange = exchange;
+      stream.symbol = symbol;
+      stream.slots.resize(window_);
+      return index;
+    };
+    return *streams_[lookup_.get(utils::hash_all(source, stream_id, exchange, symbol), is_match, create)];
+  }
+
+ private:
+  Handler &handler_;
+  size_t const window_;
+  std::chrono::nanoseconds const timeout_;
+  std::vector<std::unique_ptr<Stream>> streams_;
+  utils::HashIndex lookup_;
+  std::vector<Stream *> pending_;  // note! streams having buffered messages
+  uint64_t missing_ = {};
+  uint64_t duplicates_ = {};
+  uint64_t reordered_ = {};
+};
+
+}  // namespace tools
+}  // namespace roq
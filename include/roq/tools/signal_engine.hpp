@@ -0,0 +1,219 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <new>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "roq/compat.hpp"
+#include "roq/event.hpp"
+#include "roq/layer.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/reference_data.hpp"
+#include "roq/top_of_book.hpp"
+
+#include "roq/cache/market_by_price.hpp"
+
+#include "roq/utils/compare.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// derived signals per instrument, computed from TopOfBook or the first levels of MarketByPrice
+// - instruments must be added (subscribed) once, events for other instruments are ignored
+// - signals are only recomputed when the inputs (prices and quantities of the first levels) have changed
+// - results are stored as a table of columns (SoA) indexed by instrument, each column is aligned to the cache line
+//   and padded to a multiple of the cache line (padding is NaN), i.e. a scan can be vectorized without a remainder
+// signals:
+// - mid: (bid + ask) / 2
+// - microprice: (bid * ask_quantity + ask * bid_quantity) / (bid_quantity + ask_quantity)
+// - spread: (ask - bid) in ticks (NaN if the tick size is unknown)
+// - imbalance: (B - A) / (B + A) where B and A are the total quantities of the first depth levels, range [-1, 1]
+// - ema_mid: exponential moving average of mid, sampled on change
+// note! column pointers are invalidated when a new instrument is added
+
+struct SignalEngine final {
+  static constexpr size_t const LANES = ROQ_CACHELINE_SIZE / sizeof(double);
+  static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+  struct Config final {
+    size_t depth = 5;    // number of levels used for imbalance (MarketByPrice)
+    double alpha = 0.1;  // ema
+  };
+
+  template <typename T>
+  struct Allocator {
+    using value_type = T;
+
+    Allocator() = default;
+
+    template <typename U>
+    Allocator(Allocator<U> const &) {}
+
+    T *allocate(size_t n) {
+      return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{ROQ_CACHELINE_SIZE}));
+    }
+
+    void deallocate(T *ptr, size_t) { ::operator delete(ptr, std::align_val_t{ROQ_CACHELINE_SIZE}); }
+
+    template <typename U>
+    bool operator==(Allocator<U> const &) const {
+      return true;
+    }
+  };
+
+  using Column = std::vector<double, Allocator<double>>;
+
+  explicit SignalEngine(Config const &config) : depth_{std::max<size_t>(config.depth, 1)}, alpha_{config.alpha} {}
+
+  SignalEngine(SignalEngine &&) = default;
+  SignalEngine(SignalEngine const &) = delete;
+
+  // number of instruments
+  size_t size() const { return std::size(instruments_); }
+
+  // size of each column (padded)
+  size_t padded_size() const { return std::size(mid_); }
+
+  // note! returns the existing index if the instrument has already been added
+  size_t add(std::string_view const &exchange, std::string_view const &symbol, double tick_size = NaN) {
+    auto is_match = [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = instruments_.emplace_back();
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      set_tick_size(instrument, tick_size);
+      if (index == std::size(mid_)) {
+        auto size = index + LANES;
+        for (auto column : {&bid_price_, &ask_price_, &mid_, &microprice_, &spread_, &imbalance_, &ema_mid_})
+          (*column).resize(size, NaN);
+      }
+      return index;
+    };
+    return lookup_.get(utils::hash_all(exchange, symbol), is_match, create);
+  }
+
+  // returns NOT_FOUND if the instrument has not been added
+  size_t find(std::string_view const &exchange, std::string_view const &symbol) const {
+    return lookup_.find(utils::hash_all(exchange, symbol), [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    });
+  }
+
+  // columns
+  std::span<double const> bid_price() const { return {std::data(bid_price_), size()}; }
+  std::span<double const> ask_price() const { return {std::data(ask_price_), size()}; }
+  std::span<double const> mid() const { return {std::data(mid_), size()}; }
+  std::span<double const> microprice() const { return {std::data(microprice_), size()}; }
+  std::span<double const> spread() const { return {std::data(spread_), size()}; }
+  std::span<double const> imbalance() const { return {std::data(imbalance_), size()}; }
+  std::span<double const> ema_mid() const { return {std::data(ema_mid_), size()}; }
+
+  void operator()(Event<ReferenceData> const &event) {
+    auto &reference_data = event.value;
+    auto index = find(reference_data.exchange, reference_data.symbol);
+    if (index == NOT_FOUND || std::isnan(reference_data.tick_size))
+      return;
+    auto &instrument = instruments_[index];
+    set_tick_size(instrument, reference_data.tick_size);
+    spread_[index] = (ask_price_[index] - bid_price_[index]) * instrument.inverse_tick_size;
+  }
+
+  // returns true if signals were recomputed
+  bool operator()(Event<TopOfBook> const &event) {
+    auto &top_of_book = event.value;
+    auto index = find(top_of_book.exchange, top_of_book.symbol);
+    if (index == NOT_FOUND)
+      return false;
+    return update(index, {&top_of_book.layer, 1});
+  }
+
+  // returns true if signals were recomputed
+  bool operator()(cache::MarketByPrice const &market_by_price) {
+    auto index = find(market_by_price.exchange(), market_by_price.symbol());
+    if (index == NOT_FOUND)
+      return false;
+    layers_.resize(depth_);
+    auto layers = market_by_price.extract(layers_, true);
+    return update(index, layers);
+  }
+
+  // note! layers are best first, the first layer is the top of book
+  bool update(size_t index, std::span<Layer const> const &layers) {
+    auto &instrument = instruments_[index];
+    auto depth = std::min(std::size(layers), depth_);
+    if (depth == 0) [[unlikely]]
+      return false;
+    auto &previous = instrument.layers;
+    if (std::size(previous) == depth &&
+        std::equal(std::begin(previous), std::end(previous), std::begin(layers), utils::is_equal<Layer>))
+      return false;
+    instrument.layers.assign(std::begin(layers), std::begin(layers) + depth);
+    auto &top = layers[0];
+    auto bid_price = top.bid_price, ask_price = top.ask_price;
+    bid_price_[index] = bid_price;
+    ask_price_[index] = ask_price;
+    auto mid = 0.5 * (bid_price + ask_price);
+    mid_[index] = mid;
+    auto total = top.bid_quantity + top.ask_quantity;
+    microprice_[index] = total > 0.0 ? (bid_price * top.ask_quantity + ask_price * top.bid_quantity) / total : mid;
+    spread_[index] = (ask_price - bid_price) * instrument.inverse_tick_size;
+    auto bid_quantity = 0.0, ask_quantity = 0.0;
+    for (size_t i = 0; i < depth; ++i) {
+      auto &layer = layers[i];
+      if (!std::isnan(layer.bid_price))
+        bid_quantity += layer.bid_quantity;
+      if (!std::isnan(layer.ask_price))
+        ask_quantity += layer.ask_quantity;
+    }
+    total = bid_quantity + ask_quantity;
+    imbalance_[index] = total > 0.0 ? (bid_quantity - ask_quantity) / total : NaN;
+    auto &ema_mid = ema_mid_[index];
+    if (!std::isnan(mid))
+      ema_mid = std::isnan(ema_mid) ? mid : (ema_mid + alpha_ * (mid - ema_mid));
+    return true;
+  }
+
+ protected:
+  struct Instrument final {
+    Exchange exchange;
+    Symbol symbol;
+    double inverse_tick_size = NaN;
+    std::vector<Layer> layers;  // note! previous inputs, used to detect change
+  };
+
+  static void set_tick_size(Instrument &instrument, double tick_size) {
+    instrument.inverse_tick_size = tick_size > 0.0 ? (1.0 / tick_size) : NaN;
+  }
+
+ private:
+  size_t const depth_;
+  double const alpha_;
+  std::vector<Instrument> instruments_;
+  utils::HashIndex lookup_;
+  std::vector<Layer> layers_;
+  Column bid_price_;
+  Column ask_price_;
+  Column mid_;
+  Column microprice_;
+  Column spread_;
+  Column imbalance_;
+  Column ema_mid_;
+};
+
+}  // namespace tools
+}  // namespace roq
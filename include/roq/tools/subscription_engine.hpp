@@ -0,0 +1,254 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <cctype>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/exceptions.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/reference_data.hpp"
+
+#include "roq/client/config.hpp"
+
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// subscription matching (client::Config)
+// - used as client::Config::Handler, i.e. config.dispatch(engine)
+// - patterns are compiled once
+//   - literal (optionally anchored, escaped punctuation allowed): hash lookup
+//   - prefix (literal followed by ".*"): string compare
+//   - anything else: std::regex (full match)
+// - instruments are assigned a dense id the first time they're seen (add or ReferenceData)
+// - patterns are evaluated once per instrument (or once per new pattern), the result is cached as one bit per
+//   instrument, i.e. is_subscribed(id) is a single bit test
+// note! an empty exchange means any exchange
+// note! accounts are few and evaluated directly
+
+struct SubscriptionEngine final : public client::Config::Handler {
+  static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+  SubscriptionEngine() = default;
+
+  SubscriptionEngine(SubscriptionEngine &&) = default;
+  SubscriptionEngine(SubscriptionEngine const &) = delete;
+
+  // number of instruments
+  size_t size() const { return std::size(instruments_); }
+
+  // client::Config::Handler
+
+  void operator()(client::Account const &account) override {
+    add_pattern(accounts_, account_literals_, {}, account.regex);
+  }
+
+  // note! instruments already known are re-evaluated against the new pattern only
+  void operator()(client::Symbol const &symbol) override {
+    auto literal = add_pattern(symbols_, symbol_literals_, symbol.exchange, symbol.regex);
+    for (size_t i = 0; i < std::size(instruments_); ++i) {
+      if (is_subscribed(i))
+        continue;
+      auto &instrument = instruments_[i];
+      if (std::empty(symbol.exchange) || instrument.exchange == symbol.exchange) {
+        if (literal ? (instrument.symbol == literal_) : symbols_.back()(instrument.symbol))
+          set(i);
+      }
+    }
+  }
+
+  // returns the instrument id
+  size_t operator()(Event<ReferenceData> const &event) {
+    auto &reference_data = event.value;
+    return add(reference_data.exchange, reference_data.symbol);
+  }
+
+  // returns the instrument id
+  size_t add(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      instruments_.emplace_back(Instrument{
+          .exchange = exchange,
+          .symbol = symbol,
+      });
+      if ((index % 64) == 0)
+        subscribed_.emplace_back();
+      if (match_symbol(exchange, symbol))
+        set(index);
+      return index;
+    };
+    return lookup_.get(utils::hash_all(exchange, symbol), is_match, create);
+  }
+
+  // returns NOT_FOUND if the instrument is unknown
+  size_t find(std::string_view const &exchange, std::string_view const &symbol) const {
+    return lookup_.find(utils::hash_all(exchange, symbol), [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    });
+  }
+
+  // note! hot path
+  bool is_subscribed(size_t id) const { return (subscribed_[id / 64] >> (id % 64)) & 1; }
+
+  bool is_subscribed(std::string_view const &exchange, std::string_view const &symbol) const {
+    auto id = find(exchange, symbol);
+    return id == NOT_FOUND ? match_symbol(exchange, symbol) : is_subscribed(id);
+  }
+
+  bool is_subscribed_account(std::string_view const &account) const {
+    if (find_literal(account_literals_, {}, account))
+      return true;
+    for (auto &pattern : accounts_)
+      if (pattern(account))
+        return true;
+    return false;
+  }
+
+ protected:
+  struct Instrument final {
+    Exchange exchange;
+    Symbol symbol;
+  };
+
+  struct Pattern final {
+    Exchange exchange;   // note! empty means any
+    std::string prefix;  // note! empty (and no regex) means any
+    std::regex regex;
+    bool is_regex = false;
+
+    bool operator()(std::string_view const &value) const {
+      if (is_regex)
+        return std::regex_match(std::begin(value), std::end(value), regex);
+      return value.starts_with(prefix);
+    }
+  };
+
+  struct Literals final {
+    std::vector<std::pair<std::string, std::string>> values;  // {exchange, literal}
+    utils::HashIndex lookup;
+  };
+
+  void set(size_t id) { subscribed_[id / 64] |= uint64_t{1} << (id % 64); }
+
+  bool match_symbol(std::string_view const &exchange, std::string_view const &symbol) const {
+    if (find_literal(symbol_literals_, exchange, symbol) || find_literal(symbol_literals_, {}, symbol))
+      return true;
+    for (auto &pattern : symbols_)
+      if ((std::empty(pattern.exchange) || pattern.exchange == exchange) && pattern(symbol))
+        return true;
+    return false;
+  }
+
+  static bool find_literal(Literals const &literals, std::string_view const &exchange, std::string_view const &value) {
+    auto index = literals.lookup.find(utils::hash_all(exchange, value), [&](auto index) {
+      auto &[exchange_2, value_2] = literals.values[index];
+      return exchange_2 == exchange && value_2 == value;
+    });
+    return index != utils::HashIndex::NOT_FOUND;
+  }
+
+  // returns true if the pattern was a literal (available as literal_)
+  bool add_pattern(
+      std::vector<Pattern> &patterns,
+      Literals &literals,
+      std::string_view const &exchange,
+      std::string_view const &regex) {
+    if (parse_literal(regex, false)) {
+      if (!find_literal(literals, exchange, literal_)) {
+        literals.lookup.insert(utils::hash_all(exchange, literal_), std::size(literals.values));
+        literals.values.emplace_back(exchange, literal_);
+      }
+      return true;
+    }
+    auto &pattern = patterns.emplace_back();
+    pattern.exchange = exchange;
+    if (parse_literal(regex, true)) {
+      pattern.prefix = literal_;
+      return false;
+    }
+    try {
+      pattern.regex = std::regex{std::begin(regex), std::end(regex), std::regex::ECMAScript | std::regex::optimize};
+    } catch (std::regex_error &) {
+      patterns.pop_back();
+      using namespace std::literals;
+      throw InvalidArgument{R"(unexpected: regex="{}")"sv, regex};
+    }
+    pattern.is_regex = true;
+    return false;
+  }
+
+  // literal (or prefix, i.e. followed by ".*"), optionally anchored, into literal_
+  bool parse_literal(std::string_view regex, bool prefix) {
+    literal_.clear();
+    if (regex.starts_with('^'))
+      regex.remove_prefix(1);
+    if (regex.ends_with('$') && !regex.ends_with("\\$"))
+      regex.remove_suffix(1);
+    if (prefix) {
+      if (!regex.ends_with(".*") || regex.ends_with("\\.*"))
+        return false;
+      regex.remove_suffix(2);
+    }
+    for (size_t i = 0; i < std::size(regex); ++i) {
+      auto c = regex[i];
+      if (c == '\\') {
+        // note! only escaped punctuation, e.g. "\." or "\-"
+        if (++i == std::size(regex) || !std::ispunct(static_cast<unsigned char>(regex[i])))
+          return false;
+        c = regex[i];
+      } else if (is_special(c)) {
+        return false;
+      }
+      literal_.push_back(c);
+    }
+    return true;
+  }
+
+  static bool is_special(char c) {
+    switch (c) {
+      case '.':
+      case '*':
+      case '+':
+      case '?':
+      case '|':
+      case '^':
+      case '$':
+      case '(':
+      case ')':
+      case '[':
+      case ']':
+      case '{':
+      case '}':
+        return true;
+      default:
+        return false;
+    }
+  }
+
+ private:
+  std::vector<Instrument> instruments_;
+  utils::HashIndex lookup_;
+  std::vector<uint64_t> subscribed_;  // note! one bit per instrument
+  std::vector<Pattern> symbols_;
+  Literals symbol_literals_;
+  std::vector<Pattern> accounts_;
+  Literals account_literals_;
+  std::string literal_;
+};
+
+}  // namespace tools
+}  // namespace roq
@@ -0,0 +1,293 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/exceptions.hpp"
+#include "roq/layer.hpp"
+#include "roq/numbers.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/top_of_book.hpp"
+
+#include "roq/cache/market_by_price.hpp"
+
+#include "roq/utils/compare.hpp"
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// implied books of synthetic instruments (calendar spreads, baskets, ...)
+// - a synthetic is a linear combination of legs, i.e. sum(weight * leg)
+// - legs hold the first depth levels (from TopOfBook, MarketByPrice or directly as layers)
+// - a leg update only marks the synthetics depending on that leg as dirty (and only if the leg has changed)
+// - refresh() recomputes the implied top depth levels of dirty synthetics, other synthetics are never touched
+// implied levels:
+// - buying the synthetic means buying legs with positive weight (asks) and selling legs with negative weight (bids)
+// - the quantity of an implied level is the minimum of leg quantity / |weight| (the binding leg advances to its next
+//   level, the other legs keep the remaining quantity)
+// - leftovers within rounding noise (relative to the leg quantity) are treated as consumed, i.e. no dust levels
+// - implied levels below min_trade_vol are not published (the binding leg still advances)
+// - consecutive steps with the same price are merged into one level (never across a step not published)
+// note! weights are in units of the leg quantity, the implied quantity is in units of the synthetic
+
+struct SyntheticEngine final {
+  struct Config final {
+    size_t depth = 5;
+    double min_trade_vol = 0.0;  // in units of the synthetic
+  };
+
+  // fraction of a leg quantity considered to be rounding noise
+  static constexpr double const TOLERANCE = 1.0e-9;
+
+  struct Leg final {
+    std::string_view exchange;
+    std::string_view symbol;
+    double weight = NaN;
+  };
+
+  struct Synthetic final {
+    Symbol name;
+    std::vector<Layer> layers;  // implied, best first
+    bool dirty = false;
+  };
+
+  static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+  explicit SyntheticEngine(Config const &config)
+      : depth_{std::max<size_t>(config.depth, 1)}, min_trade_vol_{config.min_trade_vol} {}
+
+  SyntheticEngine(SyntheticEngine &&) = default;
+  SyntheticEngine(SyntheticEngine const &) = delete;
+
+  size_t size() const { return std::size(synthetics_); }
+
+  // note! legs can be shared by several synthetics
+  // note! names must be unique and a leg can only be used once per synthetic
+  size_t add(std::string_view const &name, std::span<Leg const> const &legs) {
+    using namespace std::literals;
+    if (find(name) != NOT_FOUND)
+      throw InvalidArgument{R"(unexpected: duplicate (name="{}"))"sv, name};
+    if (std::empty(legs))
+      throw InvalidArgument{R"(unexpected: no legs (name="{}"))"sv, name};
+    for (size_t i = 0; i < std::size(legs); ++i) {
+      auto &leg = legs[i];
+      if (std::isnan(leg.weight) || utils::is_zero(leg.weight))
+        throw InvalidArgument{R"(unexpected: weight={} (name="{}", symbol="{}"))"sv, leg.weight, name, leg.symbol};
+      for (size_t j = 0; j < i; ++j)
+        if (legs[j].exchange == leg.exchange && legs[j].symbol == leg.symbol)
+          throw InvalidArgument{
+              R"(unexpected: duplicate leg (name="{}", exchange="{}", symbol="{}"))"sv, name, leg.exchange, leg.symbol};
+    }
+    auto index = std::size(synthetics_);
+    auto &item = synthetics_.emplace_back();
+    item.synthetic.name = name;
+    item.synthetic.layers.resize(depth_);
+    for (auto &leg : legs) {
+      auto leg_index = get_leg(leg.exchange, leg.symbol);
+      item.legs.emplace_back(leg_index, leg.weight);
+      legs_[leg_index].synthetics.emplace_back(index);
+    }
+    names_.insert(utils::hash_all(name), index);
+    mark_dirty(index);
+    return index;
+  }
+
+  Synthetic const &operator[](size_t index) const { return synthetics_[index].synthetic; }
+
+  // returns NOT_FOUND if the synthetic is unknown
+  size_t find(std::string_view const &name) const {
+    return names_.find(utils::hash_all(name), [&](auto index) { return synthetics_[index].synthetic.name == name; });
+  }
+
+  // returns NOT_FOUND if the leg is unknown
+  size_t find_leg(std::string_view const &exchange, std::string_view const &symbol) const {
+    return lookup_.find(utils::hash_all(exchange, symbol), [&](auto index) {
+      auto &leg = legs_[index];
+      return leg.exchange == exchange && leg.symbol == symbol;
+    });
+  }
+
+  // returns true if any synthetic was marked dirty
+  bool operator()(Event<TopOfBook> const &event) {
+    auto &top_of_book = event.value;
+    auto index = find_leg(top_of_book.exchange, top_of_book.symbol);
+    if (index == NOT_FOUND)
+      return false;
+    return update(index, {&top_of_book.layer, 1});
+  }
+
+  // returns true if any synthetic was marked dirty
+  bool operator()(cache::MarketByPrice const &market_by_price) {
+    auto index = find_leg(market_by_price.exchange(), market_by_price.symbol());
+    if (index == NOT_FOUND)
+      return false;
+    buffer_.resize(depth_);
+    auto layers = market_by_price.extract(buffer_, true);
+    return update(index, layers);
+  }
+
+  // note! layers are best first, missing levels are treated as empty
+  bool update(size_t index, std::span<Layer const> const &layers) {
+    auto &leg = legs_[index];
+    auto depth = std::min(std::size(layers), depth_);
+    auto changed = false;
+    for (size_t i = 0; i < depth_; ++i) {
+      auto layer = i < depth ? layers[i] : Layer{};
+      changed |= !utils::is_equal(leg.layers[i], layer);
+      leg.layers[i] = layer;
+    }
+    if (!changed)
+      return false;
+    for (auto synthetic : leg.synthetics)
+      mark_dirty(synthetic);
+    return true;
+  }
+
+  // recompute dirty synthetics
+  template <typename Callback>
+  void refresh(Callback callback) {
+    for (auto index : dirty_) {
+      auto &item = synthetics_[index];
+      compute(item);
+      item.synthetic.dirty = false;
+      callback(std::as_const(item.synthetic));
+    }
+    dirty_.clear();
+  }
+
+ protected:
+  struct LegState final {
+    Exchange exchange;
+    Symbol symbol;
+    std::vector<Layer> layers;
+    std::vector<size_t> synthetics;
+  };
+
+  struct Item final {
+    Synthetic synthetic;
+    std::vector<std::pair<size_t, double>> legs;  // {leg, weight}
+  };
+
+  struct Cursor final {
+    std::span<Layer const> layers;
+    double weight = NaN;
+    bool bid = false;  // side of the leg book used
+    size_t level = {};
+    double remaining = 0.0;
+
+    double price() const { return bid ? layers[level].bid_price : layers[level].ask_price; }
+    double quantity() const { return bid ? layers[level].bid_quantity : layers[level].ask_quantity; }
+
+    bool load() {
+      for (; level < std::size(layers); ++level) {
+        if (std::isnan(price()))
+          return false;
+        remaining = quantity();
+        if (remaining > 0.0)
+          return true;
+      }
+      return false;
+    }
+  };
+
+  void mark_dirty(size_t index) {
+    auto &synthetic = synthetics_[index].synthetic;
+    if (synthetic.dirty)
+      return;
+    synthetic.dirty = true;
+    dirty_.emplace_back(index);
+  }
+
+  void compute(Item &item) {
+    for (auto &layer : item.synthetic.layers)
+      layer = {};
+    // note! implied bids sell legs with positive weight (bids) and buy legs with negative weight (asks)
+    compute(item, true);
+    compute(item, false);
+  }
+
+  void compute(Item &item, bool bid) {
+    cursors_.clear();
+    for (auto &[leg, weight] : item.legs) {
+      auto &cursor = cursors_.emplace_back();
+      cursor.layers = legs_[leg].layers;
+      cursor.weight = weight;
+      cursor.bid = bid == (weight > 0.0);
+      if (!cursor.load())
+        return;
+    }
+    auto &layers = item.synthetic.layers;
+    size_t count = {};
+    auto merge = false;  // the previous step published layers[count - 1]
+    while (count < std::size(layers)) {
+      auto quantity = std::numeric_limits<double>::infinity();
+      auto price = 0.0;
+      for (auto &cursor : cursors_) {
+        quantity = std::min(quantity, cursor.remaining / std::fabs(cursor.weight));
+        price += cursor.weight * cursor.price();
+      }
+      if (merge && utils::is_equal(price, get_price(layers[count - 1], bid))) {
+        get_quantity(layers[count - 1], bid) += quantity;
+      } else if (quantity >= min_trade_vol_) {
+        get_price(layers[count], bid) = price;
+        get_quantity(layers[count], bid) = quantity;
+        ++count;
+        merge = true;
+      } else {
+        merge = false;
+      }
+      for (auto &cursor : cursors_) {
+        cursor.remaining -= quantity * std::fabs(cursor.weight);
+        if (cursor.remaining <= TOLERANCE * cursor.quantity()) {
+          ++cursor.level;
+          if (!cursor.load())
+            return;
+        }
+      }
+    }
+  }
+
+  static double &get_price(Layer &layer, bool bid) { return bid ? layer.bid_price : layer.ask_price; }
+  static double &get_quantity(Layer &layer, bool bid) { return bid ? layer.bid_quantity : layer.ask_quantity; }
+
+  size_t get_leg(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &leg = legs_[index];
+      return leg.exchange == exchange && leg.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(legs_);
+      auto &leg = legs_.emplace_back();
+      leg.exchange = exchange;
+      leg.symbol = symbol;
+      leg.layers.resize(depth_);
+      return index;
+    };
+    return lookup_.get(utils::hash_all(exchange, symbol), is_match, create);
+  }
+
+ private:
+  size_t const depth_;
+  double const min_trade_vol_;
+  std::vector<LegState> legs_;
+  utils::HashIndex lookup_;
+  std::vector<Item> synthetics_;
+  utils::HashIndex names_;
+  std::vector<size_t> dirty_;
+  std::vector<Cursor> cursors_;
+  std::vector<Layer> buffer_;
+};
+
+}  // namespace tools
+}  // namespace roq
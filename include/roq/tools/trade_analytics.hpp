@@ -0,0 +1,231 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string_view>
+#include <vector>
+
+#include "roq/event.hpp"
+#include "roq/numbers.hpp"
+#include "roq/side.hpp"
+#include "roq/string_types.hpp"
+
+#include "roq/top_of_book.hpp"
+#include "roq/trade_summary.hpp"
+
+#include "roq/utils/hash.hpp"
+#include "roq/utils/hash_index.hpp"
+
+namespace roq {
+namespace tools {
+
+// rolling trade analytics per (exchange, symbol)
+// - trades are accumulated into circular time buckets keyed on exchange_time_utc (receive_time_utc if missing)
+// - a running total over the window is maintained incrementally: buckets leaving the window are subtracted, i.e.
+//   each trade and each query is O(1) (amortized, advancing the window is bounded by the number of buckets)
+// - trades without a taker side are included in volume, count and vwap (as unattributed)
+// - trade-through: a taker trade priced beyond the last known top of book (BUY above ask, SELL below bid)
+// - get(index, now) expires buckets using the time base of the trades, i.e. now (local, receive_time_utc) is shifted
+//   by the most recent offset between exchange_time_utc and receive_time_utc (clock skew and latency)
+// note! trades older than the window are dropped (and counted as late), they do not update the offset
+// note! the running total is reset to zero (exactly) when the window becomes empty
+
+struct TradeAnalytics final {
+  struct Config final {
+    std::chrono::nanoseconds bucket_size = std::chrono::seconds{1};
+    size_t window = 60;  // number of buckets
+  };
+
+  struct Summary final {
+    double buy_volume = 0.0;
+    double sell_volume = 0.0;
+    double unattributed_volume = 0.0;  // taker side unknown
+    double notional = 0.0;  // sum of price * quantity
+    size_t buy_count = {};
+    size_t sell_count = {};
+    size_t unattributed_count = {};
+    size_t trade_throughs = {};
+
+    double volume() const { return buy_volume + sell_volume + unattributed_volume; }
+    size_t count() const { return buy_count + sell_count + unattributed_count; }
+    double vwap() const {
+      auto tmp = volume();
+      return tmp > 0.0 ? (notional / tmp) : NaN;
+    }
+
+    Summary &operator+=(Summary const &rhs) {
+      buy_volume += rhs.buy_volume;
+      sell_volume += rhs.sell_volume;
+      unattributed_volume += rhs.unattributed_volume;
+      notional += rhs.notional;
+      buy_count += rhs.buy_count;
+      sell_count += rhs.sell_count;
+      unattributed_count += rhs.unattributed_count;
+      trade_throughs += rhs.trade_throughs;
+      return *this;
+    }
+
+    Summary &operator-=(Summary const &rhs) {
+      buy_volume -= rhs.buy_volume;
+      sell_volume -= rhs.sell_volume;
+      unattributed_volume -= rhs.unattributed_volume;
+      notional -= rhs.notional;
+      buy_count -= rhs.buy_count;
+      sell_count -= rhs.sell_count;
+      unattributed_count -= rhs.unattributed_count;
+      trade_throughs -= rhs.trade_throughs;
+      return *this;
+    }
+  };
+
+  static constexpr size_t const NOT_FOUND = utils::HashIndex::NOT_FOUND;
+
+  explicit TradeAnalytics(Config const &config)
+      : bucket_size_{std::max(config.bucket_size, std::chrono::nanoseconds{1})},
+        window_{std::max<size_t>(config.window, 1)} {}
+
+  TradeAnalytics(TradeAnalytics &&) = default;
+  TradeAnalytics(TradeAnalytics const &) = delete;
+
+  size_t size() const { return std::size(instruments_); }
+
+  // number of trades dropped (older than the window)
+  size_t late() const { return late_; }
+
+  size_t find(std::string_view const &exchange, std::string_view const &symbol) const {
+    return lookup_.find(utils::hash_all(exchange, symbol), [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    });
+  }
+
+  // window ending with the most recent trade
+  // note! the reference is invalidated when a new instrument is added (TopOfBook or TradeSummary)
+  Summary const &operator[](size_t index) const { return instruments_[index].total; }
+
+  // window ending at now (expires buckets)
+  // note! now is local time (comparable to receive_time_utc), no buckets are expired before the first trade
+  // note! the reference is invalidated when a new instrument is added (TopOfBook or TradeSummary)
+  Summary const &get(size_t index, std::chrono::nanoseconds now) {
+    auto &instrument = instruments_[index];
+    if (instrument.head >= 0)
+      advance(index, to_bucket(now + instrument.offset));
+    return instrument.total;
+  }
+
+  void operator()(Event<TopOfBook> const &event) {
+    auto &top_of_book = event.value;
+    auto &instrument = instruments_[get_index(top_of_book.exchange, top_of_book.symbol)];
+    instrument.bid_price = top_of_book.layer.bid_price;
+    instrument.ask_price = top_of_book.layer.ask_price;
+  }
+
+  // returns the instrument index
+  size_t operator()(Event<TradeSummary> const &event) {
+    auto &[message_info, trade_summary] = event;
+    auto index = get_index(trade_summary.exchange, trade_summary.symbol);
+    auto &instrument = instruments_[index];
+    auto exchange_time_utc = trade_summary.exchange_time_utc;
+    if (exchange_time_utc.count() == 0)
+      exchange_time_utc = message_info.receive_time_utc;
+    auto bucket = to_bucket(exchange_time_utc);
+    if (bucket > instrument.head) {
+      advance(index, bucket);
+    } else if (bucket + static_cast<int64_t>(window_) <= instrument.head) {
+      late_ += std::size(trade_summary.trades);
+      return index;
+    }
+    instrument.offset = exchange_time_utc - message_info.receive_time_utc;
+    Summary summary;
+    for (auto &trade : trade_summary.trades) {
+      if (std::isnan(trade.price) || std::isnan(trade.quantity)) [[unlikely]]
+        continue;
+      switch (trade.side) {
+        using enum Side;
+        case UNDEFINED:
+          summary.unattributed_volume += trade.quantity;
+          ++summary.unattributed_count;
+          break;
+        case BUY:
+          summary.buy_volume += trade.quantity;
+          ++summary.buy_count;
+          if (trade.price > instrument.ask_price)
+            ++summary.trade_throughs;
+          break;
+        case SELL:
+          summary.sell_volume += trade.quantity;
+          ++summary.sell_count;
+          if (trade.price < instrument.bid_price)
+            ++summary.trade_throughs;
+          break;
+      }
+      summary.notional += trade.price * trade.quantity;
+    }
+    buckets_[index * window_ + static_cast<size_t>(bucket) % window_] += summary;
+    instrument.total += summary;
+    return index;
+  }
+
+ protected:
+  struct Instrument final {
+    Exchange exchange;
+    Symbol symbol;
+    double bid_price = NaN;
+    double ask_price = NaN;
+    int64_t head = -1;                     // most recent bucket
+    std::chrono::nanoseconds offset = {};  // exchange_time_utc - receive_time_utc (most recent accepted trade)
+    Summary total;
+  };
+
+  int64_t to_bucket(std::chrono::nanoseconds time) const { return time.count() / bucket_size_.count(); }
+
+  void advance(size_t index, int64_t bucket) {
+    auto &instrument = instruments_[index];
+    if (bucket <= instrument.head)
+      return;
+    auto buckets = std::data(buckets_) + index * window_;
+    if (instrument.head < 0 || static_cast<size_t>(bucket - instrument.head) >= window_) {
+      std::fill(buckets, buckets + window_, Summary{});
+      instrument.total = {};
+    } else {
+      for (auto i = instrument.head + 1; i <= bucket; ++i) {
+        auto &item = buckets[static_cast<size_t>(i) % window_];
+        instrument.total -= item;
+        item = {};
+      }
+      if (instrument.total.count() == 0)
+        instrument.total = {};
+    }
+    instrument.head = bucket;
+  }
+
+  size_t get_index(std::string_view const &exchange, std::string_view const &symbol) {
+    auto is_match = [&](auto index) {
+      auto &instrument = instruments_[index];
+      return instrument.exchange == exchange && instrument.symbol == symbol;
+    };
+    auto create = [&]() {
+      auto index = std::size(instruments_);
+      auto &instrument = instruments_.emplace_back();
+      instrument.exchange = exchange;
+      instrument.symbol = symbol;
+      buckets_.resize(std::size(buckets_) + window_);
+      return index;
+    };
+    return lookup_.get(utils::hash_all(exchange, symbol), is_match, create);
+  }
+
+ private:
+  std::chrono::nanoseconds const bucket_size_;
+  size_t const window_;
+  std::vector<Instrument> instruments_;
+  std::vector<Summary> buckets_;  // note! window_ buckets per instrument
+  utils::HashIndex lookup_;
+  size_t late_ = {};
+};
+
+}  // namespace tools
+}  // namespace roq
@@ -0,0 +1,83 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+#include "roq/clock.hpp"
+#include "roq/uuid.hpp"
+
+namespace roq {
+namespace tools {
+
+// uuid generator
+// - version 4 (random) and version 7 (unix epoch milliseconds followed by random bits)
+// - counter-based prng (splitmix64), i.e. no system call per uuid
+// - seeded once (std::random_device), use get() for a per-thread instance
+// - version 7 is monotonic per generator: uuids created within the same millisecond use a 12 bit counter (rand_a)
+// note! not cryptographically secure
+
+struct UUIDGenerator final {
+  UUIDGenerator() : UUIDGenerator{create_seed()} {}
+
+  // note! deterministic (testing purposes)
+  explicit UUIDGenerator(uint64_t seed) : state_{seed} {}
+
+  UUIDGenerator(UUIDGenerator &&) = default;
+  UUIDGenerator(UUIDGenerator const &) = delete;
+
+  // per-thread instance
+  static UUIDGenerator &get() {
+    thread_local UUIDGenerator result;
+    return result;
+  }
+
+  UUID create_v4() {
+    auto value = static_cast<UUID::value_type>(next()) << 64 | next();
+    value &= ~(static_cast<UUID::value_type>(0xF) << 76 | static_cast<UUID::value_type>(0x3) << 62);
+    value |= static_cast<UUID::value_type>(0x4) << 76 | static_cast<UUID::value_type>(0x2) << 62;
+    return UUID{value};
+  }
+
+  UUID create_v7() { return create_v7(clock::get_realtime()); }
+
+  UUID create_v7(std::chrono::nanoseconds now_utc) {
+    auto milliseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now_utc).count());
+    auto random = next();
+    if (milliseconds > milliseconds_) {
+      milliseconds_ = milliseconds;
+      counter_ = random >> 53;  // note! random start, leaves room to increment
+    } else if (++counter_ > 0xFFF) {
+      ++milliseconds_;
+      counter_ = {};
+    }
+    auto value = static_cast<UUID::value_type>(milliseconds_ & 0xFFFFFFFFFFFF) << 80 |
+                 static_cast<UUID::value_type>(0x7) << 76 | static_cast<UUID::value_type>(counter_) << 64 |
+                 static_cast<UUID::value_type>(0x2) << 62 | (next() >> 2);
+    return UUID{value};
+  }
+
+ protected:
+  static uint64_t create_seed() {
+    std::random_device random_device;
+    auto seed = static_cast<uint64_t>(random_device()) << 32 | random_device();
+    return seed ^ static_cast<uint64_t>(clock::get_system().count());
+  }
+
+  uint64_t next() {
+    auto result = (state_ += UINT64_C(0x9E3779B97F4A7C15));
+    result = (result ^ (result >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    result = (result ^ (result >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return result ^ (result >> 31);
+  }
+
+ private:
+  uint64_t state_ = {};
+  uint64_t milliseconds_ = {};  // note! most recent (version 7)
+  uint64_t counter_ = {};
+};
+
+}  // namespace tools
+}  // namespace roq
@@ -0,0 +1,62 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+// deterministic (compile-time) hashing
+// - FNV-1a for strings, followed by a final avalanche step
+// - useful for composite keys, e.g. (account, exchange, symbol), without allocating a std::string
+// note! not suitable for hash-flooding resistance
+
+namespace roq {
+namespace utils {
+
+namespace detail {
+// references:
+//   https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+constexpr uint64_t const FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+constexpr uint64_t const FNV_PRIME = 0x100000001b3;
+
+// references:
+//   https://xorshift.di.unimi.it/splitmix64.c
+constexpr uint64_t mix(uint64_t value) {
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+  return value ^ (value >> 31);
+}
+}  // namespace detail
+
+inline constexpr uint64_t hash(std::string_view const &value, uint64_t seed = detail::FNV_OFFSET_BASIS) {
+  auto result = seed;
+  for (auto c : value) {
+    result ^= static_cast<uint8_t>(c);
+    result *= detail::FNV_PRIME;
+  }
+  // note! separator (avoid "ab"+"c" == "a"+"bc")
+  result ^= 0xff;
+  result *= detail::FNV_PRIME;
+  return detail::mix(result);
+}
+
+template <typename T>
+inline constexpr uint64_t hash_combine(uint64_t seed, T const &value) {
+  using value_type = typename std::decay<T>::type;
+  if constexpr (std::is_integral<value_type>::value || std::is_enum<value_type>::value) {
+    return detail::mix(seed ^ (static_cast<uint64_t>(value) + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2)));
+  } else {
+    return hash(std::string_view{value}, seed);
+  }
+}
+
+template <typename... Args>
+inline constexpr uint64_t hash_all(Args const &...args) {
+  auto result = detail::FNV_OFFSET_BASIS;
+  ((result = hash_combine(result, args)), ...);
+  return result;
+}
+
+}  // namespace utils
+}  // namespace roq
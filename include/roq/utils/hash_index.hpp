@@ -0,0 +1,67 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <unordered_map>
+
+// composite key index, i.e. hash => index (into a container owned by the caller)
+// - collisions are resolved by probing (++hash), a match is confirmed by the caller (comparing the full key)
+// - no lookup requires the key to be materialized (e.g. as a std::string)
+// note! entries can not be removed (only clear), i.e. indices are expected to be stable
+
+namespace roq {
+namespace utils {
+
+struct HashIndex final {
+  static constexpr size_t const NOT_FOUND = static_cast<size_t>(-1);
+
+  size_t size() const { return std::size(lookup_); }
+
+  bool empty() const { return std::empty(lookup_); }
+
+  void reserve(size_t size) { lookup_.reserve(size); }
+
+  void clear() { lookup_.clear(); }
+
+  // returns NOT_FOUND if no index matches
+  template <typename IsMatch>
+  size_t find(uint64_t hash, IsMatch is_match) const {
+    for (;; ++hash) {
+      auto iter = lookup_.find(hash);
+      if (iter == std::end(lookup_))
+        return NOT_FOUND;
+      if (is_match((*iter).second)) [[likely]]
+        return (*iter).second;
+    }
+  }
+
+  // returns the matching index, otherwise the index returned by create (then added)
+  template <typename IsMatch, typename Create>
+  size_t get(uint64_t hash, IsMatch is_match, Create create) {
+    for (;; ++hash) {
+      auto iter = lookup_.find(hash);
+      if (iter == std::end(lookup_))
+        break;
+      if (is_match((*iter).second)) [[likely]]
+        return (*iter).second;
+    }
+    auto index = create();
+    lookup_.emplace(hash, index);
+    return index;
+  }
+
+  // note! the caller must guarantee that the key has not already been added
+  void insert(uint64_t hash, size_t index) {
+    while (!lookup_.try_emplace(hash, index).second)
+      ++hash;
+  }
+
+ private:
+  std::unordered_map<uint64_t, size_t> lookup_;
+};
+
+}  // namespace utils
+}  // namespace roq
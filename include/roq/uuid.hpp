@@ -4,7 +4,12 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <array>
 #include <bit>
+#include <cstdint>
+#include <functional>
+#include <utility>
 
 namespace roq {
 
@@ -81,34 +86,39 @@ static_assert(sizeof(UUID) == 16);
 
 }  // namespace roq
 
+template <>
+struct std::hash<roq::UUID> {
+  // note! mixes both halves (uuids may only have few random bits, e.g. version 7)
+  size_t operator()(roq::UUID const &value) const noexcept {
+    auto tmp = *std::data(value);
+    return static_cast<size_t>(mix(static_cast<uint64_t>(tmp) ^ mix(static_cast<uint64_t>(tmp >> 64))));
+  }
+
+ protected:
+  // note! murmur3 finalizer
+  static constexpr uint64_t mix(uint64_t value) {
+    value = (value ^ (value >> 33)) * UINT64_C(0xFF51AFD7ED558CCD);
+    value = (value ^ (value >> 33)) * UINT64_C(0xC4CEB9FE1A85EC53);
+    return value ^ (value >> 33);
+  }
+};
+
 template <>
 struct fmt::formatter<roq::UUID> {
   constexpr auto parse(format_parse_context &context) { return std::begin(context); }
   auto format(roq::UUID const &value, format_context &context) const {
     using namespace std::literals;
-    auto data = reinterpret_cast<std::byte const *>(std::data(value));
-    return fmt::format_to(
-        context.out(),
-        "{:02x}{:02x}{:02x}{:02x}-"
-        "{:02x}{:02x}-"
-        "{:02x}{:02x}-"
-        "{:02x}{:02x}-"
-        "{:02x}{:02x}{:02x}{:02x}{:02x}{:02x}"sv,
-        data[0],
-        data[1],
-        data[2],
-        data[3],
-        data[4],
-        data[5],
-        data[6],
-        data[7],
-        data[8],
-        data[9],
-        data[10],
-        data[11],
-        data[12],
-        data[13],
-        data[14],
-        data[15]);
+    // note! table lookup (no format parsing)
+    constexpr auto const DIGITS = "0123456789abcdef"sv;
+    auto data = reinterpret_cast<uint8_t const *>(std::data(value));
+    std::array<char, 36> buffer;
+    size_t offset = {};
+    for (size_t i = 0; i < sizeof(roq::UUID); ++i) {
+      if (i == 4 || i == 6 || i == 8 || i == 10)
+        buffer[offset++] = '-';
+      buffer[offset++] = DIGITS[data[i] >> 4];
+      buffer[offset++] = DIGITS[data[i] & 0xF];
+    }
+    return std::copy(std::begin(buffer), std::end(buffer), context.out());
   }
 };
@@ -0,0 +1,184 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/book_monitor.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+// note! minimal implementation, only what is required by the monitor
+struct MarketByPrice final : public cache::MarketByPrice {
+  std::string_view exchange() const override { return "deribit"sv; }
+  std::string_view symbol() const override { return "BTC-PERPETUAL"sv; }
+  uint16_t max_depth() const override { return {}; }
+  double price_increment() const override { return NaN; }
+  double quantity_increment() const override { return NaN; }
+  Precision price_precision() const override { return {}; }
+  Precision quantity_precision() const override { return {}; }
+  uint16_t stream_id() const override { return {}; }
+  std::chrono::nanoseconds exchange_time_utc() const override { return {}; }
+  uint64_t exchange_sequence() const override { return {}; }
+  uint32_t checksum() const override { return checksum_; }
+  std::pair<size_t, size_t> size() const override { return {std::size(bids_), std::size(asks_)}; }
+  bool empty() const override { return std::empty(bids_) && std::empty(asks_); }
+  void clear() override {
+    bids_.clear();
+    asks_.clear();
+  }
+  std::pair<std::span<MBPUpdate const>, std::span<MBPUpdate const>> extract(
+      std::span<MBPUpdate> const &, std::span<MBPUpdate> const &, bool) const override {
+    return {};
+  }
+  void extract_2(std::vector<MBPUpdate> &bids, std::vector<MBPUpdate> &asks, size_t) const override {
+    bids = bids_;
+    asks = asks_;
+  }
+  std::span<Layer const> extract(std::span<Layer> const &, bool) const override { return {}; }
+  void extract_2(std::vector<Layer> &, size_t) const override {}
+  bool exists(Side, double) const override { return false; }
+  std::pair<size_t, bool> find_index(Side, double) const override { return {}; }
+  bool is_bad() const override {
+    return !std::empty(bids_) && !std::empty(asks_) && bids_[0].price >= asks_[0].price;
+  }
+  Layer compute_vwap(double) const override { return {}; }
+  Layer compute_impact_price(double) const override { return {}; }
+  void create_depth_update(
+      MarketByPriceUpdate const &, size_t, std::vector<MBPUpdate> &, std::vector<MBPUpdate> &) const override {}
+
+  uint32_t checksum_ = {};
+
+ protected:
+  void update_helper(ReferenceData const &) override {}
+  void update_helper(MarketByPriceUpdate const &value) override {
+    if (utils::is_snapshot(value.update_type))
+      clear();
+    update_helper(value.bids, value.asks);
+  }
+  void update_helper(Side, MBPUpdate const &) override {}
+  MarketByPriceUpdate create_update_helper(
+      MarketByPriceUpdate const &, std::vector<MBPUpdate> &, std::vector<MBPUpdate> &) override {
+    return {};
+  }
+  MarketByPriceUpdate create_snapshot_helper(std::vector<MBPUpdate> &, std::vector<MBPUpdate> &) const override {
+    return {};
+  }
+  void update_helper(std::span<MBPUpdate const> const &bids, std::span<MBPUpdate const> const &asks) override {
+    auto helper = [](auto &levels, auto &updates, auto compare) {
+      for (auto &update : updates) {
+        std::erase_if(levels, [&](auto &level) { return level.price == update.price; });
+        if (update.quantity > 0.0)
+          levels.emplace_back(update);
+      }
+      std::sort(std::begin(levels), std::end(levels), [&](auto &lhs, auto &rhs) {
+        return compare(lhs.price, rhs.price);
+      });
+    };
+    helper(bids_, bids, std::greater{});
+    helper(asks_, asks, std::less{});
+  }
+
+ private:
+  std::vector<MBPUpdate> bids_;
+  std::vector<MBPUpdate> asks_;
+};
+
+struct Handler final : public tools::BookMonitor::Handler {
+  void operator()(cache::MarketByPrice const &, Mask<tools::BookMonitor::Violation> violations) override {
+    result.emplace_back(violations);
+  }
+  std::vector<Mask<tools::BookMonitor::Violation>> result;
+};
+
+void market_by_price_update(
+    auto &monitor,
+    auto &market_by_price,
+    std::span<MBPUpdate const> const &bids,
+    std::span<MBPUpdate const> const &asks,
+    UpdateType update_type,
+    uint64_t exchange_sequence,
+    uint16_t max_depth = {},
+    uint32_t checksum = {}) {
+  MessageInfo message_info{
+      .source_name = {},
+      .source_session_id = {},
+      .is_last = true,
+  };
+  MarketByPriceUpdate market_by_price_update{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .bids = bids,
+      .asks = asks,
+      .update_type = update_type,
+      .exchange_time_utc = {},
+      .exchange_sequence = exchange_sequence,
+      .sending_time_utc = {},
+      .price_precision = {},
+      .quantity_precision = {},
+      .max_depth = max_depth,
+      .checksum = checksum,
+  };
+  market_by_price(market_by_price_update);
+  Event event{message_info, market_by_price_update};
+  monitor(event, market_by_price);
+}
+}  // namespace
+
+TEST_CASE("book_monitor_crossed", "[book_monitor]") {
+  using Violation = tools::BookMonitor::Violation;
+  Handler handler;
+  tools::BookMonitor monitor{handler, {}};
+  MarketByPrice market_by_price;
+  std::vector<MBPUpdate> bids{{.price = 100.0, .quantity = 1.0}, {.price = 99.0, .quantity = 1.0}};
+  std::vector<MBPUpdate> asks{{.price = 101.0, .quantity = 1.0}, {.price = 102.0, .quantity = 1.0}};
+  market_by_price_update(monitor, market_by_price, bids, asks, UpdateType::SNAPSHOT, 1);
+  CHECK(monitor.violations(Violation::CROSSED) == 0);
+  // new ask crosses stale bids => bids are trimmed
+  std::vector<MBPUpdate> asks_2{{.price = 99.5, .quantity = 1.0}};
+  market_by_price_update(monitor, market_by_price, {}, asks_2, UpdateType::INCREMENTAL, 2);
+  CHECK(monitor.violations(Violation::CROSSED) == 1);
+  CHECK(monitor.trims() == 1);
+  CHECK(market_by_price.is_bad() == false);
+  CHECK(market_by_price.size() == std::pair<size_t, size_t>{1, 3});
+  CHECK(std::empty(handler.result));
+  // max depth
+  std::vector<MBPUpdate> asks_3{{.price = 103.0, .quantity = 1.0}};
+  market_by_price_update(monitor, market_by_price, {}, asks_3, UpdateType::INCREMENTAL, 3, 2);
+  CHECK(monitor.violations(Violation::MAX_DEPTH) == 1);
+  CHECK(market_by_price.size() == std::pair<size_t, size_t>{1, 2});
+  CHECK(monitor.trims() == 2);
+}
+
+TEST_CASE("book_monitor_request_snapshot", "[book_monitor]") {
+  using Violation = tools::BookMonitor::Violation;
+  Handler handler;
+  tools::BookMonitor monitor{handler, {}};
+  MarketByPrice market_by_price;
+  std::vector<MBPUpdate> bids{{.price = 100.0, .quantity = 1.0}};
+  std::vector<MBPUpdate> asks{{.price = 101.0, .quantity = 1.0}};
+  market_by_price_update(monitor, market_by_price, bids, asks, UpdateType::SNAPSHOT, 1);
+  // gap
+  market_by_price_update(monitor, market_by_price, bids, {}, UpdateType::INCREMENTAL, 3);
+  REQUIRE(std::size(handler.result) == 1);
+  CHECK(handler.result[0] == Mask{Violation::SEQUENCE_GAP});
+  // suppressed until snapshot
+  market_by_price_update(monitor, market_by_price, bids, {}, UpdateType::INCREMENTAL, 5);
+  CHECK(std::size(handler.result) == 1);
+  CHECK(monitor.violations(Violation::SEQUENCE_GAP) == 2);
+  market_by_price_update(monitor, market_by_price, bids, asks, UpdateType::SNAPSHOT, 10);
+  // checksum
+  market_by_price.checksum_ = 123;
+  market_by_price_update(monitor, market_by_price, bids, {}, UpdateType::INCREMENTAL, 11, {}, 456);
+  REQUIRE(std::size(handler.result) == 2);
+  CHECK(handler.result[1] == Mask{Violation::CHECKSUM});
+  market_by_price_update(monitor, market_by_price, bids, asks, UpdateType::SNAPSHOT, 12, {}, 123);
+  // crossed on both sides (undecidable)
+  std::vector<MBPUpdate> asks_2{{.price = 99.0, .quantity = 1.0}};
+  market_by_price_update(monitor, market_by_price, bids, asks_2, UpdateType::INCREMENTAL, 13, {}, 123);
+  REQUIRE(std::size(handler.result) == 3);
+  CHECK(handler.result[2] == Mask{Violation::CROSSED});
+  CHECK(monitor.snapshot_requests() == 3);
+}
@@ -0,0 +1,136 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/cache/consolidated_book.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+void market_by_price_update(
+    auto &book,
+    std::string_view const &exchange,
+    std::span<MBPUpdate const> const &bids,
+    std::span<MBPUpdate const> const &asks,
+    UpdateType update_type,
+    uint16_t max_depth = {}) {
+  MessageInfo message_info;
+  MarketByPriceUpdate market_by_price_update{
+      .stream_id = {},
+      .exchange = exchange,
+      .symbol = "BTC-USD"sv,
+      .bids = bids,
+      .asks = asks,
+      .update_type = update_type,
+      .exchange_time_utc = {},
+      .exchange_sequence = {},
+      .sending_time_utc = {},
+      .price_precision = {},
+      .quantity_precision = {},
+      .max_depth = max_depth,
+      .checksum = {},
+  };
+  Event event{message_info, market_by_price_update};
+  book(event);
+}
+}  // namespace
+
+TEST_CASE("consolidated_book_simple", "[consolidated_book]") {
+  cache::ConsolidatedBook book{0.1};
+  CHECK_THROWS_AS(cache::ConsolidatedBook{0.0}, InvalidArgument);
+  auto venue_1 = book.add("coinbase"sv, "BTC-USD"sv);
+  auto venue_2 = book.add("kraken"sv, "BTC-USD"sv);
+  CHECK(book.add("coinbase"sv, "BTC-USD"sv) == venue_1);
+  CHECK(book.best(Side::BUY) == nullptr);
+  std::vector<MBPUpdate> bids_1{{.price = 100.0, .quantity = 1.0}, {.price = 99.9, .quantity = 2.0}};
+  std::vector<MBPUpdate> asks_1{{.price = 100.2, .quantity = 1.0}};
+  market_by_price_update(book, "coinbase"sv, bids_1, asks_1, UpdateType::SNAPSHOT);
+  std::vector<MBPUpdate> bids_2{{.price = 100.1, .quantity = 3.0}, {.price = 100.0, .quantity = 4.0}};
+  std::vector<MBPUpdate> asks_2{{.price = 0.1 + 100.1, .quantity = 2.0}, {.price = 100.3, .quantity = 5.0}};
+  market_by_price_update(book, "kraken"sv, bids_2, asks_2, UpdateType::SNAPSHOT);
+  CHECK(book.size() == std::pair<size_t, size_t>{3, 2});
+  auto best_bid = book.best(Side::BUY);
+  REQUIRE(best_bid != nullptr);
+  CHECK(best_bid->price == 100.1);
+  CHECK(best_bid->quantities[venue_2] == 3.0);
+  auto best_ask = book.best(Side::SELL);
+  REQUIRE(best_ask != nullptr);
+  CHECK(best_ask->price == 100.2);
+  CHECK(best_ask->quantity == 3.0);
+  CHECK(best_ask->venues == 0x3);
+  // venue attribution
+  std::vector<double> prices;
+  book.for_each(Side::BUY, [&](auto &level) { prices.emplace_back(level.price); });
+  CHECK(prices == std::vector<double>{100.1, 100.0, 99.9});
+  // vwap
+  auto layer = book.compute_vwap(8.0);
+  CHECK(layer.bid_quantity == 8.0);
+  CHECK(layer.bid_price == (3.0 * 100.1 + 5.0 * 100.0) / 8.0);
+  CHECK(layer.ask_quantity == 8.0);
+  CHECK(layer.ask_price == (3.0 * 100.2 + 5.0 * 100.3) / 8.0);
+  CHECK(book.compute_vwap(100.0).bid_quantity == 10.0);
+  // incremental
+  std::vector<MBPUpdate> bids_3{{.price = 100.1, .quantity = 0.0}};
+  market_by_price_update(book, "kraken"sv, bids_3, {}, UpdateType::INCREMENTAL);
+  CHECK(book.best(Side::BUY)->price == 100.0);
+  CHECK(book.best(Side::BUY)->quantity == 5.0);
+  // snapshot (only clears the venue)
+  market_by_price_update(book, "coinbase"sv, {}, {}, UpdateType::SNAPSHOT);
+  CHECK(book.size() == std::pair<size_t, size_t>{1, 2});
+  CHECK(book.best(Side::BUY)->venues == 0x2);
+  CHECK(book.top_of_book().ask_quantity == 2.0);
+  // unknown venue
+  market_by_price_update(book, "binance"sv, bids_1, asks_1, UpdateType::SNAPSHOT);
+  CHECK(book.size() == std::pair<size_t, size_t>{1, 2});
+}
+
+TEST_CASE("consolidated_book_alias", "[consolidated_book]") {
+  cache::ConsolidatedBook book{0.1};
+  CHECK_THROWS_AS(book.add("coinbase"sv, "BTC-USD"sv, 0.01), InvalidArgument);
+  CHECK_THROWS_AS(book.add("coinbase"sv, "BTC-USD"sv, 0.25), InvalidArgument);
+  auto venue = book.add("coinbase"sv, "BTC-USD"sv, 0.5);
+  book.add("kraken"sv, "BTC-USD"sv);
+  // note! 100.01 and 100.04 would both round to 100.0
+  std::vector<MBPUpdate> bids_1{{.price = 100.01, .quantity = 1.0}, {.price = 100.04, .quantity = 2.0}};
+  market_by_price_update(book, "kraken"sv, bids_1, {}, UpdateType::SNAPSHOT);
+  CHECK(book.rejected() == 2);
+  CHECK(book.empty());
+  std::vector<MBPUpdate> bids_2{{.price = 100.0, .quantity = 1.0}, {.price = 99.5, .quantity = 2.0}};
+  market_by_price_update(book, "coinbase"sv, bids_2, {}, UpdateType::SNAPSHOT);
+  CHECK(book.size() == std::pair<size_t, size_t>{2, 0});
+  CHECK(book.best(Side::BUY)->quantities[venue] == 1.0);
+  CHECK(book.update(Side::BUY, venue, 100.0 + 0.1 - 0.1, 0.0) == true);  // rounding noise
+  CHECK(book.best(Side::BUY)->price == 99.5);
+}
+
+TEST_CASE("consolidated_book_max_depth", "[consolidated_book]") {
+  cache::ConsolidatedBook book{0.1};
+  auto venue_1 = book.add("coinbase"sv, "BTC-USD"sv);
+  auto venue_2 = book.add("kraken"sv, "BTC-USD"sv);
+  std::vector<MBPUpdate> bids_1{{.price = 100.0, .quantity = 1.0}, {.price = 99.9, .quantity = 2.0}};
+  market_by_price_update(book, "coinbase"sv, bids_1, {}, UpdateType::SNAPSHOT, 2);
+  std::vector<MBPUpdate> bids_2{{.price = 99.9, .quantity = 3.0}, {.price = 99.8, .quantity = 4.0}};
+  market_by_price_update(book, "kraken"sv, bids_2, {}, UpdateType::SNAPSHOT);
+  // a better level pushes 99.9 beyond the depth of the venue (no delete is sent)
+  std::vector<MBPUpdate> bids_3{{.price = 100.1, .quantity = 5.0}};
+  market_by_price_update(book, "coinbase"sv, bids_3, {}, UpdateType::INCREMENTAL, 2);
+  std::vector<double> prices;
+  book.for_each(Side::BUY, [&](auto &level) { prices.emplace_back(level.price); });
+  CHECK(prices == std::vector<double>{100.1, 100.0, 99.9, 99.8});
+  book.for_each(Side::BUY, [&](auto &level) {
+    if (level.price != 99.9)
+      return;
+    CHECK(level.venues == (uint32_t{1} << venue_2));
+    CHECK(level.quantities[venue_1] == 0.0);
+    CHECK(level.quantity == 3.0);
+  });
+  // levels only quoted by the venue are removed
+  std::vector<MBPUpdate> bids_4{{.price = 100.2, .quantity = 6.0}};
+  market_by_price_update(book, "coinbase"sv, bids_4, {}, UpdateType::INCREMENTAL, 2);
+  prices.clear();
+  book.for_each(Side::BUY, [&](auto &level) { prices.emplace_back(level.price); });
+  CHECK(prices == std::vector<double>{100.2, 100.1, 99.9, 99.8});
+  CHECK(book.compute_vwap(100.0).bid_quantity == 18.0);
+}
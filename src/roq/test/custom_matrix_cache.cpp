@@ -0,0 +1,130 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/cache/custom_matrix_cache.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+TEST_CASE("custom_matrix_cache_simple", "[custom_matrix_cache]") {
+  cache::CustomMatrixCache cache;
+  auto &matrix = cache.get("cov"sv);
+  std::vector<MatrixKey> rows{"A"sv, "B"sv, "C"sv};
+  std::vector<MatrixKey> columns{"X"sv, "Y"sv};
+  matrix.reset(rows, columns);
+  CHECK(std::size(matrix.data()) == 6);
+  CHECK(std::isnan(matrix.get("A"sv, "X"sv)));
+  matrix.fill(1.0);
+  matrix(1, 1) = 2.0;
+  CHECK(matrix.row_index("B"sv) == 1);
+  CHECK(matrix.column_index("Y"sv) == 1);
+  CHECK(matrix.get("B"sv, "Y"sv) == 2.0);
+  CHECK(std::isnan(matrix.get("D"sv, "Y"sv)));
+  // element-wise
+  std::vector<double> other{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  matrix.add(other);
+  CHECK(matrix.get("B"sv, "Y"sv) == 6.0);
+  matrix.scale(2.0);
+  CHECK(matrix.get("A"sv, "X"sv) == 4.0);
+  matrix.ema(0.5, other);
+  CHECK(matrix.get("A"sv, "X"sv) == 2.5);
+  CHECK_THROWS_AS(matrix.add(std::vector<double>{1.0}), InvalidArgument);
+  // reset (keeps existing cells)
+  std::vector<MatrixKey> rows_2{"C"sv, "A"sv};
+  matrix.reset(rows_2, columns);
+  CHECK(matrix.get("A"sv, "X"sv) == 2.5);
+  CHECK(matrix.row_index("B"sv) == static_cast<size_t>(-1));
+  // reset using own keys
+  std::vector<MatrixKey> columns_2{"X"sv, "Y"sv, "Z"sv};
+  matrix.reset(matrix.rows(), columns_2);
+  CHECK(matrix.row_index("C"sv) == 0);
+  CHECK(matrix.row_index("A"sv) == 1);
+  CHECK(matrix.get("A"sv, "X"sv) == 2.5);
+  CHECK(std::isnan(matrix.get("A"sv, "Z"sv)));
+  matrix.reset(matrix.rows(), matrix.columns());
+  CHECK(std::size(matrix.columns()) == 3);
+  CHECK(matrix.column_index("Z"sv) == 2);
+  CHECK(matrix.get("A"sv, "X"sv) == 2.5);
+  CHECK(cache.size() == 1);
+  CHECK(cache.find("cov"sv) == &matrix);
+  CHECK(cache.find("cov"sv, "A1"sv) == nullptr);
+}
+
+TEST_CASE("custom_matrix_cache_publish", "[custom_matrix_cache]") {
+  cache::CustomMatrixCache source, target;
+  auto &matrix = source.get("cov"sv, ""sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  std::vector<MatrixKey> keys{"A"sv, "B"sv, "C"sv, "D"sv};
+  matrix.reset(keys, keys);
+  matrix.fill(0.0);
+  size_t count = {};
+  UpdateType update_type = {};
+  size_t size = {};
+  auto callback = [&](CustomMatrix const &custom_matrix) {
+    ++count;
+    update_type = custom_matrix.update_type;
+    size = std::size(custom_matrix.data);
+    auto &result = target(custom_matrix);
+    CHECK(result.version() == custom_matrix.version);
+  };
+  // first publication is always a snapshot
+  CHECK(matrix.publish(true, callback) == true);
+  CHECK(update_type == UpdateType::SNAPSHOT);
+  CHECK(size == 16);
+  // nothing changed
+  CHECK(matrix.publish(true, callback) == false);
+  CHECK(count == 1);
+  // delta
+  matrix(1, 2) = 1.0;
+  matrix(2, 1) = 1.0;
+  CHECK(matrix.publish(true, callback) == true);
+  CHECK(update_type == UpdateType::INCREMENTAL);
+  CHECK(size == 4);  // 2 rows x 2 columns
+  CHECK(matrix.version() == 2);
+  auto result = target.find("cov"sv, ""sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(result != nullptr);
+  CHECK(result->version() == 2);
+  CHECK(std::equal(std::begin(result->data()), std::end(result->data()), std::begin(matrix.data())));
+  // full
+  matrix(3, 3) = 3.0;
+  CHECK(matrix.publish(false, callback) == true);
+  CHECK(update_type == UpdateType::SNAPSHOT);
+  CHECK(result->get("D"sv, "D"sv) == 3.0);
+}
+
+TEST_CASE("custom_matrix_cache_extend", "[custom_matrix_cache]") {
+  cache::CustomMatrixCache cache;
+  std::vector<MatrixKey> rows{"A"sv};
+  std::vector<MatrixKey> columns{"X"sv};
+  std::vector<double> data{1.0};
+  CustomMatrix custom_matrix{
+      .label = "test"sv,
+      .account = {},
+      .exchange = {},
+      .symbol = {},
+      .rows = rows,
+      .columns = columns,
+      .data = data,
+      .update_type = UpdateType::SNAPSHOT,
+      .version = 1,
+  };
+  cache(custom_matrix);
+  std::vector<MatrixKey> rows_2{"B"sv};
+  std::vector<MatrixKey> columns_2{"X"sv, "Y"sv};
+  std::vector<double> data_2{2.0, 3.0};
+  custom_matrix.rows = rows_2;
+  custom_matrix.columns = columns_2;
+  custom_matrix.data = data_2;
+  custom_matrix.update_type = UpdateType::INCREMENTAL;
+  custom_matrix.version = 2;
+  auto &matrix = cache(custom_matrix);
+  CHECK(std::size(matrix.rows()) == 2);
+  CHECK(std::size(matrix.columns()) == 2);
+  CHECK(matrix.get("A"sv, "X"sv) == 1.0);
+  CHECK(std::isnan(matrix.get("A"sv, "Y"sv)));
+  CHECK(matrix.get("B"sv, "X"sv) == 2.0);
+  CHECK(matrix.get("B"sv, "Y"sv) == 3.0);
+  custom_matrix.data = data;
+  CHECK_THROWS_AS(cache(custom_matrix), InvalidArgument);
+}
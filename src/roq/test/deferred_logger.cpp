@@ -0,0 +1,96 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <string>
+#include <thread>
+
+#include "roq/side.hpp"
+
+#include "roq/tools/deferred_logger.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Handler final : public tools::DeferredLogger::Handler {
+  void operator()(tools::DeferredLogger::Message const &message) override {
+    result.emplace_back(message.text);
+    file_name = message.file_name;
+    line = message.line;
+  }
+  std::vector<std::string> result;
+  std::string file_name;
+  uint32_t line = {};
+};
+}  // namespace
+
+TEST_CASE("deferred_logger_simple", "[deferred_logger]") {
+  Handler handler;
+  tools::DeferredLogger logger{handler, {}};
+  auto producer = logger.create_producer();
+  CHECK(producer("hello"sv));
+  {
+    // note! strings are copied
+    std::string symbol{"BTC-PERPETUAL"};
+    CHECK(producer(R"(symbol="{}", side={}, quantity={}, id={})"sv, symbol, Side::BUY, 1.5, 123));
+  }
+  CHECK(std::empty(handler.result));
+  CHECK(logger.drain() == 2);
+  REQUIRE(std::size(handler.result) == 2);
+  CHECK(handler.result[0] == "hello"sv);
+  CHECK(handler.result[1] == R"(symbol="BTC-PERPETUAL", side=BUY, quantity=1.5, id=123)"sv);
+  CHECK(handler.file_name == "deferred_logger.cpp"sv);
+  CHECK(handler.line > 0);
+  CHECK(logger.drain() == 0);
+}
+
+TEST_CASE("deferred_logger_wrap_around", "[deferred_logger]") {
+  Handler handler;
+  tools::DeferredLogger logger{handler, {.capacity = 1024}};
+  auto producer = logger.create_producer();
+  // fill
+  size_t count = {};
+  while (producer("{}: {}"sv, count, "0123456789"sv))
+    ++count;
+  CHECK(count > 0);
+  CHECK(producer.dropped() == 1);
+  CHECK(logger.drain() == count);
+  // wrap around (many times)
+  for (size_t i = 0; i < 100; ++i) {
+    CHECK(producer("{}: {}"sv, i, "0123456789"sv));
+    CHECK(producer("{}"sv, i));
+    CHECK(logger.drain() == 2);
+    CHECK(handler.result[std::size(handler.result) - 2] == fmt::format("{}: 0123456789"sv, i));
+    CHECK(handler.result.back() == fmt::format("{}"sv, i));
+  }
+  // too large
+  std::string text(2048, 'x');
+  CHECK(!producer("{}"sv, text));
+  CHECK(logger.dropped() == 2);
+}
+
+TEST_CASE("deferred_logger_threads", "[deferred_logger]") {
+  Handler handler;
+  tools::DeferredLogger logger{handler, {.capacity = 4096, .poll_interval = 10us}};
+  logger.start();
+  auto helper = [&](size_t id) {
+    auto producer = logger.create_producer();
+    for (size_t i = 0; i < 1000; ++i)
+      while (!producer("{} {}"sv, id, i))
+        std::this_thread::yield();
+  };
+  {
+    std::jthread thread_1{helper, 1};
+    std::jthread thread_2{helper, 2};
+  }
+  logger.stop();
+  REQUIRE(std::size(handler.result) == 2000);
+  // note! ordered per producer
+  std::array<size_t, 2> next = {};
+  for (auto &item : handler.result) {
+    auto id = item[0] - '1';
+    CHECK(item == fmt::format("{} {}"sv, id + 1, next[id]++));
+  }
+}
@@ -75,3 +75,21 @@ TEST_CASE("exceptions_what", "[exceptions]") {
   }
   CHECK(ok == true);
 }
+
+TEST_CASE("exceptions_what_truncate", "[exceptions]") {
+  std::string text(1024, 'x');
+  try {
+    throw NotReady{"{}"sv, text};
+  } catch (NotReady &e) {
+    std::string_view what{e.what()};
+    CHECK(std::size(what) == 511);
+    CHECK(what == std::string_view{text}.substr(0, 511));
+  }
+  try {
+    throw NotReady{"0123456789"sv};
+  } catch (NotReady &e) {
+    CHECK(e.what() == "0123456789"sv);
+    CHECK(e.line() > 0);
+    CHECK(e.file() == "exceptions.cpp"sv);
+  }
+}
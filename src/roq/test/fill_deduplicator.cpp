@@ -0,0 +1,70 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <fmt/format.h>
+
+#include "roq/tools/fill_deduplicator.hpp"
+
+using namespace std::literals;
+using namespace std::chrono_literals;
+
+using namespace roq;
+
+TEST_CASE("fill_deduplicator_simple", "[fill_deduplicator]") {
+  tools::FillDeduplicator fill_deduplicator;
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "123"sv, 1s) == true);
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "123"sv, 1s) == false);
+  CHECK(fill_deduplicator.insert("deribit"sv, "ETH-PERPETUAL"sv, "123"sv, 1s) == true);
+  CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, "123"sv) == true);
+  CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, "124"sv) == false);
+  CHECK(fill_deduplicator.size() == 2);
+}
+
+TEST_CASE("fill_deduplicator_capacity", "[fill_deduplicator]") {
+  tools::FillDeduplicator fill_deduplicator{{
+      .capacity = 100,
+      .expiry = 1h,
+      .confirm = true,
+  }};
+  for (size_t i = 0; i < 1000; ++i) {
+    auto trade_id = fmt::format("{}"sv, i);
+    CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, trade_id, 1s) == true);
+  }
+  CHECK(fill_deduplicator.size() == 100);
+  for (size_t i = 0; i < 900; ++i)
+    CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, fmt::format("{}"sv, i)) == false);
+  for (size_t i = 900; i < 1000; ++i)
+    CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, fmt::format("{}"sv, i)) == true);
+}
+
+TEST_CASE("fill_deduplicator_expiry", "[fill_deduplicator]") {
+  tools::FillDeduplicator fill_deduplicator{{
+      .capacity = 100,
+      .expiry = 10s,
+      .confirm = false,
+  }};
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "1"sv, 1s) == true);
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "2"sv, 5s) == true);
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "3"sv, 12s) == true);
+  CHECK(fill_deduplicator.size() == 2);
+  CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, "1"sv) == false);
+  CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, "2"sv) == true);
+}
+
+TEST_CASE("fill_deduplicator_clear", "[fill_deduplicator]") {
+  tools::FillDeduplicator fill_deduplicator{{
+      .capacity = 100,
+      .expiry = 10s,
+      .confirm = true,
+  }};
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "1"sv, 100s) == true);
+  fill_deduplicator.clear();
+  CHECK(fill_deduplicator.empty() == true);
+  // note! expiry must not be relative to fills seen before clear
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "2"sv, 1s) == true);
+  CHECK(fill_deduplicator.insert("deribit"sv, "BTC-PERPETUAL"sv, "3"sv, 2s) == true);
+  CHECK(fill_deduplicator.size() == 2);
+  CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, "1"sv) == false);
+  CHECK(fill_deduplicator.contains("deribit"sv, "BTC-PERPETUAL"sv, "2"sv) == true);
+}
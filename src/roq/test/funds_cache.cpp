@@ -0,0 +1,91 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/cache/funds_cache.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+void reference_data(auto &cache, std::string_view const &symbol, auto base_currency, auto quote_currency) {
+  MessageInfo message_info;
+  ReferenceData reference_data{
+      .stream_id = {},
+      .exchange = "binance"sv,
+      .symbol = symbol,
+      .description = {},
+      .security_type = {},
+      .base_currency = base_currency,
+      .quote_currency = quote_currency,
+      .margin_currency = {},
+      .commission_currency = {},
+      .strike_currency = {},
+      .underlying = {},
+      .time_zone = {},
+  };
+  Event event{message_info, reference_data};
+  cache(event);
+}
+
+void top_of_book(auto &cache, std::string_view const &symbol, double bid_price, double ask_price) {
+  MessageInfo message_info;
+  TopOfBook top_of_book{
+      .stream_id = {},
+      .exchange = "binance"sv,
+      .symbol = symbol,
+      .layer{
+          .bid_price = bid_price,
+          .bid_quantity = 1.0,
+          .ask_price = ask_price,
+          .ask_quantity = 1.0,
+      },
+  };
+  Event event{message_info, top_of_book};
+  cache(event);
+}
+
+auto funds_update(auto &cache, std::string_view const &currency, double balance, double hold) {
+  MessageInfo message_info;
+  FundsUpdate funds_update{
+      .stream_id = {},
+      .account = "A1"sv,
+      .currency = currency,
+      .margin_mode = {},
+      .balance = balance,
+      .hold = hold,
+      .external_account = {},
+  };
+  Event event{message_info, funds_update};
+  return cache(event);
+}
+}  // namespace
+
+TEST_CASE("funds_cache_simple", "[funds_cache]") {
+  cache::FundsCache cache{"USDT"sv};
+  reference_data(cache, "BTCUSDT"sv, "BTC"sv, "USDT"sv);
+  reference_data(cache, "USDTTRY"sv, "USDT"sv, "TRY"sv);
+  auto total = funds_update(cache, "USDT"sv, 1000.0, 100.0);
+  REQUIRE(total != nullptr);
+  CHECK(total->available == 900.0);
+  CHECK(total->is_complete() == true);
+  total = funds_update(cache, "BTC"sv, 2.0, 0.0);
+  CHECK(total->available == 900.0);
+  CHECK(total->missing == 1);
+  top_of_book(cache, "BTCUSDT"sv, 99.0, 101.0);
+  CHECK(total->available == 1100.0);
+  CHECK(total->is_complete() == true);
+  top_of_book(cache, "BTCUSDT"sv, 149.0, 151.0);
+  CHECK(total->available == 1200.0);
+  funds_update(cache, "TRY"sv, 500.0, 0.0);
+  top_of_book(cache, "USDTTRY"sv, 4.0, 6.0);
+  CHECK(total->available == 1300.0);
+  CHECK(cache.get_rate("TRY"sv) == 0.2);
+  funds_update(cache, "BTC"sv, 1.0, NaN);
+  CHECK(total->available == 1150.0);
+  cache.refresh();
+  CHECK(total->available == 1150.0);
+  CHECK(cache.get_total("A1"sv) == total);
+  CHECK(cache.get_total("A2"sv) == nullptr);
+}
@@ -0,0 +1,44 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <string_view>
+#include <vector>
+
+#include "roq/utils/hash_index.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+TEST_CASE("hash_index_collision", "[hash_index]") {
+  std::vector<std::string_view> keys;
+  utils::HashIndex lookup;
+  auto find = [&](auto hash, auto const &key) {
+    return lookup.find(hash, [&](auto index) { return keys[index] == key; });
+  };
+  auto get = [&](auto hash, auto const &key) {
+    auto create = [&]() {
+      auto index = std::size(keys);
+      keys.emplace_back(key);
+      return index;
+    };
+    return lookup.get(hash, [&](auto index) { return keys[index] == key; }, create);
+  };
+  // note! same hash, i.e. forced collisions
+  CHECK(get(123, "abc"sv) == 0);
+  CHECK(get(123, "def"sv) == 1);
+  CHECK(get(123, "abc"sv) == 0);
+  CHECK(get(124, "ghi"sv) == 2);
+  lookup.insert(123, std::size(keys));
+  keys.emplace_back("jkl"sv);
+  CHECK(std::size(lookup) == 4);
+  CHECK(find(123, "abc"sv) == 0);
+  CHECK(find(123, "def"sv) == 1);
+  CHECK(find(124, "ghi"sv) == 2);
+  CHECK(find(123, "jkl"sv) == 3);
+  CHECK(find(123, "xyz"sv) == utils::HashIndex::NOT_FOUND);
+  lookup.clear();
+  CHECK(lookup.empty());
+  CHECK(find(123, "abc"sv) == utils::HashIndex::NOT_FOUND);
+}
@@ -27,6 +27,12 @@ static_assert(Mask<E>{E::A} != Mask<E>{E::B});
 static_assert(Mask<E>{E::A} == Mask<E>{}.set(E::A));
 static_assert(Mask<E>{E::A, E::B} == Mask<E>{}.set(E::A).set(E::B));
 static_assert(Mask<E>{E::A, E::B, E::C} == Mask<E>{}.set(E::A).set(E::B).set(E::C));
+static_assert(Mask<E>{}.popcount() == 0);
+static_assert(Mask<E>{E::A, E::C}.popcount() == 2);
+static_assert(*Mask<E>::iterator{Mask<E>{E::B, E::C}} == E::B);
+static_assert(Mask<E>::NAMES[0] == "A"sv);
+static_assert(Mask<E>::NAMES[2] == "C"sv);
+static_assert(std::empty(Mask<E>::NAMES[3]));
 }  // namespace
 
 template <>
@@ -85,3 +91,24 @@ TEST_CASE("mask_with_undefined", "[mask]") {
   CHECK(fmt::format("{}"sv, Mask{E2::A, E2::C}) == "A|C"sv);
   CHECK(fmt::format("{}"sv, Mask{E2::A, E2::B, E2::C}) == "A|B|C"sv);
 }
+
+TEST_CASE("mask_iterate", "[mask]") {
+  auto mask = Mask{E::A, E::C};
+  std::vector<E> result;
+  for (Mask<E>::iterator iter{mask}; iter != Mask<E>::sentinel{}; ++iter)
+    result.emplace_back(*iter);
+  CHECK(result == std::vector<E>{E::A, E::C});
+  result.clear();
+  mask.for_each_set([&](auto flag) { result.emplace_back(flag); });
+  CHECK(result == std::vector<E>{E::A, E::C});
+  result.clear();
+  Mask<E>{}.for_each_set([&](auto flag) { result.emplace_back(flag); });
+  CHECK(std::empty(result));
+  // highest bit
+  auto mask_2 = Mask<E>{static_cast<int>(0x80000001u)};
+  CHECK(mask_2.popcount() == 2);
+  std::vector<size_t> indices;
+  for (Mask<E>::iterator iter{mask_2}; iter != Mask<E>::sentinel{}; ++iter)
+    indices.emplace_back(iter.index());
+  CHECK(indices == std::vector<size_t>{0, 31});
+}
@@ -0,0 +1,131 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/mass_cancel.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Handler final : public tools::MassCancel::Handler {
+  void operator()(CancelAllOrders const &, uint8_t) override { ++native; }
+  void operator()(CancelOrder const &cancel_order, uint8_t, bool is_last) override {
+    order_ids.emplace_back(cancel_order.order_id);
+    CHECK(cancel_order.version == 2);
+    if (is_last)
+      ++batches;
+  }
+  size_t native = {};
+  size_t batches = {};
+  std::vector<uint64_t> order_ids;
+};
+
+void create_order(
+    auto &order_cache, uint64_t order_id, std::string_view const &symbol, Side side, uint8_t source = {}) {
+  CreateOrder create_order{
+      .account = "A1"sv,
+      .order_id = order_id,
+      .exchange = "deribit"sv,
+      .symbol = symbol,
+      .side = side,
+      .execution_instructions = {},
+      .request_template = {},
+      .routing_id = {},
+  };
+  order_cache(create_order, source);
+}
+
+void gateway_settings(auto &mass_cancel, Mask<Filter> oms_cancel_all_orders) {
+  MessageInfo message_info;
+  GatewaySettings gateway_settings{
+      .supports = {},
+      .mbp_max_depth = {},
+      .mbp_tick_size_multiplier = NaN,
+      .mbp_min_trade_vol_multiplier = NaN,
+      .mbp_allow_remove_non_existing = {},
+      .mbp_allow_price_inversion = {},
+      .mbp_checksum = {},
+      .oms_download_has_state = {},
+      .oms_download_has_routing_id = {},
+      .oms_request_id_type = {},
+      .oms_cancel_all_orders = oms_cancel_all_orders,
+  };
+  Event event{message_info, gateway_settings};
+  mass_cancel(event);
+}
+}  // namespace
+
+TEST_CASE("mass_cancel_fan_out", "[mass_cancel]") {
+  Handler handler;
+  cache::OrderCache order_cache;
+  tools::MassCancel mass_cancel{handler, order_cache};
+  create_order(order_cache, 1, "BTC-PERPETUAL"sv, Side::BUY);
+  create_order(order_cache, 2, "BTC-PERPETUAL"sv, Side::SELL);
+  create_order(order_cache, 3, "ETH-PERPETUAL"sv, Side::BUY);
+  create_order(order_cache, 4, "BTC-PERPETUAL"sv, Side::BUY);
+  CancelAllOrders cancel_all_orders{
+      .account = "A1"sv,
+      .order_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .strategy_id = {},
+      .side = Side::BUY,
+  };
+  // note! gateway settings not yet received
+  CHECK(mass_cancel.get_support(cancel_all_orders, 0) == tools::MassCancel::Support::UNKNOWN);
+  CHECK(mass_cancel(cancel_all_orders, 0) == 2);
+  CHECK(handler.native == 0);
+  CHECK(handler.batches == 1);
+  CHECK(handler.order_ids == std::vector<uint64_t>{1, 4});
+  CHECK(order_cache.find(1)->max_request_version == 2);
+  // note! side not supported
+  gateway_settings(mass_cancel, {Filter::ACCOUNT, Filter::EXCHANGE, Filter::SYMBOL});
+  CHECK(mass_cancel.get_support(cancel_all_orders, 0) == tools::MassCancel::Support::UNSUPPORTED);
+  CHECK(mass_cancel.is_native(cancel_all_orders, 0) == false);
+  gateway_settings(mass_cancel, {});
+  CHECK(mass_cancel.get_support(cancel_all_orders, 0) == tools::MassCancel::Support::UNSUPPORTED);
+}
+
+TEST_CASE("mass_cancel_source", "[mass_cancel]") {
+  Handler handler;
+  cache::OrderCache order_cache;
+  tools::MassCancel mass_cancel{handler, order_cache};
+  create_order(order_cache, 1, "BTC-PERPETUAL"sv, Side::BUY, 0);
+  create_order(order_cache, 2, "BTC-PERPETUAL"sv, Side::BUY, 1);
+  create_order(order_cache, 3, "ETH-PERPETUAL"sv, Side::SELL, 1);
+  create_order(order_cache, 4, "ETH-PERPETUAL"sv, Side::SELL, 0);
+  CancelAllOrders cancel_all_orders{
+      .account = {},
+      .order_id = {},
+      .exchange = {},
+      .symbol = {},
+      .strategy_id = {},
+      .side = {},
+  };
+  // note! orders on other sources must not be canceled
+  CHECK(mass_cancel(cancel_all_orders, 1) == 2);
+  CHECK(handler.order_ids == std::vector<uint64_t>{2, 3});
+  CHECK(order_cache.find(1)->max_request_version == 1);
+  CHECK(order_cache.find(4)->max_request_version == 1);
+}
+
+TEST_CASE("mass_cancel_native", "[mass_cancel]") {
+  Handler handler;
+  cache::OrderCache order_cache;
+  tools::MassCancel mass_cancel{handler, order_cache};
+  create_order(order_cache, 1, "BTC-PERPETUAL"sv, Side::BUY);
+  gateway_settings(mass_cancel, {Filter::ACCOUNT, Filter::EXCHANGE, Filter::SYMBOL, Filter::SIDE});
+  CancelAllOrders cancel_all_orders{
+      .account = "A1"sv,
+      .order_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .strategy_id = {},
+      .side = Side::BUY,
+  };
+  CHECK(mass_cancel(cancel_all_orders, 0) == 1);
+  CHECK(handler.native == 1);
+  CHECK(std::empty(handler.order_ids));
+}
@@ -0,0 +1,159 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/metrics_aggregator.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Handler final : public tools::MetricsAggregator::Handler {
+  void operator()(CustomMetricsUpdate const &custom_metrics_update, tools::MetricsAggregator::Statistic statistic)
+      override {
+    CHECK(custom_metrics_update.label == "test"sv);
+    for (auto &measurement : custom_metrics_update.measurements)
+      result.push_back({statistic, std::string{measurement.name}, measurement.value});
+  }
+  struct Item final {
+    tools::MetricsAggregator::Statistic statistic;
+    std::string name;
+    double value;
+  };
+  std::vector<Item> result;
+};
+
+void custom_metrics(auto &aggregator, std::string_view const &name, double value) {
+  std::vector<Measurement> measurements{
+      {.name = name, .value = value},
+  };
+  CustomMetrics custom_metrics{
+      .label = "test"sv,
+      .account = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .measurements = measurements,
+      .update_type = UpdateType::INCREMENTAL,
+  };
+  aggregator(custom_metrics);
+}
+
+void timer(auto &aggregator, std::chrono::nanoseconds now) {
+  MessageInfo message_info;
+  Timer timer{
+      .now = now,
+  };
+  Event event{message_info, timer};
+  aggregator(event);
+}
+}  // namespace
+
+TEST_CASE("metrics_aggregator_simple", "[metrics_aggregator]") {
+  using Statistic = tools::MetricsAggregator::Statistic;
+  Handler handler;
+  tools::MetricsAggregator::Config config{
+      .interval = 1s,
+      .window = 2,
+      .statistics = {Statistic::MIN, Statistic::MAX, Statistic::MEAN, Statistic::LAST, Statistic::COUNT},
+  };
+  tools::MetricsAggregator aggregator{handler, config};
+  auto now = std::chrono::nanoseconds{1s};
+  custom_metrics(aggregator, "x"sv, 1.0);
+  custom_metrics(aggregator, "x"sv, 5.0);
+  custom_metrics(aggregator, "x"sv, 3.0);
+  custom_metrics(aggregator, "y"sv, NaN);  // ignored
+  CHECK(aggregator.size() == 1);
+  tools::MetricsAggregator::Aggregate aggregate;
+  REQUIRE(aggregator.get(aggregate, "test"sv, ""sv, "deribit"sv, "BTC-PERPETUAL"sv, "x"sv) == true);
+  CHECK(aggregate.count == 3);
+  CHECK(aggregator.get(aggregate, "test"sv, ""sv, "deribit"sv, "BTC-PERPETUAL"sv, "z"sv) == false);
+  timer(aggregator, now);
+  REQUIRE(std::size(handler.result) == 5);
+  CHECK(handler.result[0].statistic == Statistic::MIN);
+  CHECK(handler.result[0].value == 1.0);
+  CHECK(handler.result[1].statistic == Statistic::MAX);
+  CHECK(handler.result[1].value == 5.0);
+  CHECK(handler.result[2].statistic == Statistic::MEAN);
+  CHECK(handler.result[2].value == 3.0);
+  CHECK(handler.result[3].statistic == Statistic::LAST);
+  CHECK(handler.result[3].value == 3.0);
+  CHECK(handler.result[4].statistic == Statistic::COUNT);
+  CHECK(handler.result[4].value == 3.0);
+  handler.result.clear();
+  // nothing new
+  timer(aggregator, now + 1s);
+  CHECK(std::empty(handler.result));
+  // rolling window (2 intervals)
+  custom_metrics(aggregator, "x"sv, 7.0);
+  timer(aggregator, now + 2s);
+  REQUIRE(std::size(handler.result) == 5);
+  CHECK(handler.result[0].value == 7.0);
+  CHECK(handler.result[4].value == 1.0);
+  handler.result.clear();
+  custom_metrics(aggregator, "x"sv, 9.0);
+  timer(aggregator, now + 2500ms);  // note! less than interval
+  CHECK(std::empty(handler.result));
+  timer(aggregator, now + 3s);
+  REQUIRE(std::size(handler.result) == 5);
+  CHECK(handler.result[0].value == 7.0);
+  CHECK(handler.result[1].value == 9.0);
+  CHECK(handler.result[2].value == 8.0);
+  CHECK(handler.result[3].value == 9.0);
+  CHECK(handler.result[4].value == 2.0);
+}
+
+TEST_CASE("metrics_aggregator_missed_timer", "[metrics_aggregator]") {
+  using Statistic = tools::MetricsAggregator::Statistic;
+  Handler handler;
+  tools::MetricsAggregator::Config config{
+      .interval = 1s,
+      .window = 3,
+      .statistics = {Statistic::MEAN, Statistic::COUNT},
+  };
+  tools::MetricsAggregator aggregator{handler, config};
+  auto now = std::chrono::nanoseconds{1s};
+  auto get = [&]() {
+    REQUIRE(std::size(handler.result) == 2);
+    std::pair result{handler.result[0].value, handler.result[1].value};
+    handler.result.clear();
+    return result;
+  };
+  custom_metrics(aggregator, "x"sv, 1.0);
+  timer(aggregator, now);
+  CHECK(get() == std::pair{1.0, 1.0});
+  custom_metrics(aggregator, "x"sv, 2.0);
+  timer(aggregator, now + 1s);
+  CHECK(get() == std::pair{1.5, 2.0});
+  // note! timer missed (now + 2s), the first bucket has expired
+  custom_metrics(aggregator, "x"sv, 3.0);
+  timer(aggregator, now + 3s);
+  CHECK(get() == std::pair{2.5, 2.0});
+  // note! more than the window
+  custom_metrics(aggregator, "x"sv, 4.0);
+  timer(aggregator, now + 8s);
+  CHECK(get() == std::pair{4.0, 1.0});
+  // note! publish does not advance the window
+  for (auto value : {5.0, 6.0, 7.0}) {
+    custom_metrics(aggregator, "x"sv, value);
+    aggregator.publish();
+  }
+  CHECK(std::size(handler.result) == 6);
+  CHECK(handler.result[4].value == 5.5);
+  CHECK(handler.result[5].value == 4.0);
+}
+
+TEST_CASE("metrics_aggregator_zero_interval", "[metrics_aggregator]") {
+  using Statistic = tools::MetricsAggregator::Statistic;
+  Handler handler;
+  tools::MetricsAggregator::Config config{
+      .interval = {},
+      .window = 2,
+      .statistics = {Statistic::COUNT},
+  };
+  tools::MetricsAggregator aggregator{handler, config};
+  custom_metrics(aggregator, "x"sv, 1.0);
+  timer(aggregator, 1s);
+  REQUIRE(std::size(handler.result) == 1);
+  CHECK(handler.result[0].value == 1.0);
+}
@@ -0,0 +1,319 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "roq/cache/order_cache.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+auto create_order(
+    auto &cache,
+    uint64_t order_id,
+    Side side = Side::BUY,
+    double price = 100.0,
+    uint32_t strategy_id = {},
+    std::string_view const &routing_id = {}) {
+  CreateOrder create_order{
+      .account = "A1"sv,
+      .order_id = order_id,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .side = side,
+      .position_effect = {},
+      .margin_mode = {},
+      .max_show_quantity = NaN,
+      .order_type = OrderType::LIMIT,
+      .time_in_force = TimeInForce::GTC,
+      .execution_instructions = {},
+      .request_template = {},
+      .quantity = 1.0,
+      .price = price,
+      .stop_price = NaN,
+      .routing_id = routing_id,
+      .strategy_id = strategy_id,
+  };
+  return cache(create_order, 0);
+}
+
+auto order_update(auto &cache, uint64_t order_id, OrderStatus order_status) {
+  MessageInfo message_info;
+  OrderUpdate order_update{
+      .account = {},
+      .order_id = order_id,
+      .exchange = {},
+      .symbol = {},
+      .execution_instructions = {},
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .order_status = order_status,
+      .routing_id = {},
+      .max_request_version = 1,
+      .max_response_version = 1,
+      .max_accepted_version = 1,
+      .user = {},
+  };
+  Event event{message_info, order_update};
+  return cache(event);
+}
+
+auto trade_update(auto &cache, uint64_t order_id, double quantity, std::string_view const &trade_id) {
+  MessageInfo message_info;
+  Fill fill{
+      .exchange_time_utc = {},
+      .external_trade_id = trade_id,
+      .quantity = quantity,
+      .price = 100.0,
+      .liquidity = {},
+  };
+  TradeUpdate trade_update{
+      .stream_id = {},
+      .account = "A1"sv,
+      .order_id = order_id,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .side = Side::BUY,
+      .position_effect = {},
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .fills = {&fill, 1},
+      .routing_id = {},
+      .user = {},
+  };
+  Event event{message_info, trade_update};
+  return cache(event);
+}
+}  // namespace
+
+TEST_CASE("order_cache_simple", "[order_cache]") {
+  cache::OrderCache cache{4};
+  CHECK(cache.empty() == true);
+  auto order = create_order(cache, 1);
+  REQUIRE(order != nullptr);
+  CHECK(order->order_status == OrderStatus::SENT);
+  CHECK(order->has_pending_request() == true);
+  CHECK(cache.size() == 1);
+  CHECK(cache.find(1) == order);
+  CHECK(cache.find(2) == nullptr);
+  order = order_update(cache, 1, OrderStatus::WORKING);
+  REQUIRE(order != nullptr);
+  CHECK(order->order_status == OrderStatus::WORKING);
+  CHECK(order->max_accepted_version == 1);
+  CHECK(order->has_pending_request() == false);
+  CHECK(cache.size() == 1);
+  order = order_update(cache, 1, OrderStatus::CANCELED);
+  CHECK(order->is_complete() == true);
+  CHECK(cache.size() == 0);
+  // note! final status is never reverted
+  order = order_update(cache, 1, OrderStatus::WORKING);
+  CHECK(order->order_status == OrderStatus::CANCELED);
+  CHECK(cache.size() == 0);
+}
+
+TEST_CASE("order_cache_recycle", "[order_cache]") {
+  cache::OrderCache cache{4};
+  for (uint64_t order_id = 1; order_id <= 100; ++order_id) {
+    create_order(cache, order_id);
+    order_update(cache, order_id, OrderStatus::COMPLETED);
+  }
+  CHECK(cache.capacity() == 4);
+  CHECK(cache.size() == 0);
+  CHECK(cache.find(1) == nullptr);
+  CHECK(cache.find(100) != nullptr);
+}
+
+TEST_CASE("order_cache_grow", "[order_cache]") {
+  cache::OrderCache cache{4};
+  for (uint64_t order_id = 1; order_id <= 10; ++order_id)
+    create_order(cache, order_id);
+  CHECK(cache.capacity() == 16);
+  CHECK(cache.size() == 10);
+  for (uint64_t order_id = 1; order_id <= 10; ++order_id)
+    CHECK(cache.find(order_id) != nullptr);
+  size_t counter = {};
+  cache.for_each([&](auto &) { ++counter; });
+  CHECK(counter == 10);
+}
+
+TEST_CASE("order_cache_overflow", "[order_cache]") {
+  cache::OrderCache cache{4, 8};
+  // note! long-lived working order and a far-away dense range
+  create_order(cache, 1);
+  for (uint64_t order_id = 1001; order_id <= 1020; ++order_id)
+    create_order(cache, order_id);
+  CHECK(cache.capacity() == 8);
+  CHECK(cache.size() == 21);
+  CHECK(cache.overflow() == 13);
+  CHECK(cache.find(1) != nullptr);
+  for (uint64_t order_id = 1001; order_id <= 1020; ++order_id)
+    CHECK(cache.find(order_id) != nullptr);
+  size_t counter = {};
+  cache.for_each([&](auto &) { ++counter; });
+  CHECK(counter == 21);
+  // completed orders are purged from the overflow
+  for (uint64_t order_id = 1001; order_id <= 1020; ++order_id)
+    order_update(cache, order_id, OrderStatus::COMPLETED);
+  CHECK(cache.size() == 1);
+  create_order(cache, 2001);
+  create_order(cache, 2009);
+  CHECK(cache.size() == 3);
+  CHECK(cache.find(2001) != nullptr);
+  CHECK(cache.find(2009) != nullptr);
+  CHECK(cache.overflow() == 2);  // note! both map to the slot of order 1
+}
+
+TEST_CASE("order_cache_index_levels", "[order_cache]") {
+  cache::OrderCache cache{4};
+  struct Expected final {
+    uint64_t order_id = {};
+    double price = NaN;
+    size_t sequence = {};
+  };
+  std::vector<Expected> expected;
+  size_t sequence = {};
+  auto modify = [&](uint64_t order_id, double price) {
+    MessageInfo message_info;
+    OrderUpdate order_update{
+        .account = {},
+        .order_id = order_id,
+        .exchange = {},
+        .symbol = {},
+        .execution_instructions = {},
+        .external_account = {},
+        .external_order_id = {},
+        .client_order_id = {},
+        .order_status = OrderStatus::WORKING,
+        .price = price,
+        .routing_id = {},
+        .user = {},
+    };
+    cache(Event{message_info, order_update});
+    // note! an unchanged price keeps the time priority
+    for (auto &item : expected)
+      if (item.order_id == order_id && item.price != price) {
+        item.price = price;
+        item.sequence = ++sequence;
+      }
+  };
+  auto check = [&]() {
+    std::sort(std::begin(expected), std::end(expected), [](auto &lhs, auto &rhs) {
+      return lhs.price > rhs.price || (lhs.price == rhs.price && lhs.sequence < rhs.sequence);
+    });
+    std::vector<uint64_t> result;
+    cache.for_each("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv, Side::BUY, [&](auto &order) {
+      result.emplace_back(order.order_id);
+    });
+    REQUIRE(std::size(result) == std::size(expected));
+    for (size_t i = 0; i < std::size(result); ++i)
+      CHECK(result[i] == expected[i].order_id);
+  };
+  // note! many orders sharing few price levels, time priority within a level
+  for (uint64_t order_id = 1; order_id <= 1000; ++order_id) {
+    auto price = 100.0 + static_cast<double>((order_id * 7) % 13);
+    create_order(cache, order_id, Side::BUY, price);
+    expected.push_back({.order_id = order_id, .price = price, .sequence = ++sequence});
+  }
+  check();
+  // note! requotes move the order to the back of the new level
+  for (uint64_t order_id = 1; order_id <= 1000; order_id += 3)
+    modify(order_id, 100.0 + static_cast<double>((order_id * 5) % 17));
+  check();
+  // note! empty the best level
+  for (auto &item : expected)
+    if (item.price == 116.0)
+      modify(item.order_id, 90.0);
+  check();
+  for (uint64_t order_id = 2; order_id <= 1000; order_id += 2) {
+    order_update(cache, order_id, OrderStatus::CANCELED);
+    std::erase_if(expected, [&](auto &item) { return item.order_id == order_id; });
+  }
+  check();
+}
+
+TEST_CASE("order_cache_trade_update", "[order_cache]") {
+  cache::OrderCache cache{4};
+  create_order(cache, 1);
+  auto order = trade_update(cache, 1, 0.25, "t1"sv);
+  REQUIRE(order != nullptr);
+  CHECK(order->filled_quantity == 0.25);
+  trade_update(cache, 1, 0.5, "t2"sv);
+  CHECK(order->filled_quantity == 0.75);
+  // note! replayed (e.g. after reconnect)
+  trade_update(cache, 1, 0.25, "t1"sv);
+  trade_update(cache, 1, 0.5, "t2"sv);
+  CHECK(order->filled_quantity == 0.75);
+  CHECK(trade_update(cache, 2, 1.0, "t3"sv) == nullptr);
+}
+
+TEST_CASE("order_cache_index", "[order_cache]") {
+  cache::OrderCache cache{4};
+  create_order(cache, 1, Side::BUY, 100.0, 1, "abc"sv);
+  create_order(cache, 2, Side::BUY, 102.0, 2, "abc"sv);
+  create_order(cache, 3, Side::BUY, 101.0, 1);
+  create_order(cache, 4, Side::SELL, 104.0, 1);
+  create_order(cache, 5, Side::SELL, 103.0, 2);
+  create_order(cache, 6, Side::BUY, NaN, 2);
+  auto get = [&](auto side) {
+    std::vector<uint64_t> result;
+    cache.for_each("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv, side, [&](auto &order) {
+      result.emplace_back(order.order_id);
+    });
+    return result;
+  };
+  auto get_strategy = [&](auto strategy_id) {
+    std::vector<uint64_t> result;
+    cache.for_each_strategy(strategy_id, [&](auto &order) { result.emplace_back(order.order_id); });
+    std::sort(std::begin(result), std::end(result));
+    return result;
+  };
+  auto get_routing_id = [&](auto routing_id) {
+    std::vector<uint64_t> result;
+    cache.for_each_routing_id(routing_id, [&](auto &order) { result.emplace_back(order.order_id); });
+    std::sort(std::begin(result), std::end(result));
+    return result;
+  };
+  // note! best price first, market orders before limit orders
+  CHECK(get(Side::BUY) == std::vector<uint64_t>{6, 2, 3, 1});
+  CHECK(get(Side::SELL) == std::vector<uint64_t>{5, 4});
+  CHECK(get_strategy(1) == std::vector<uint64_t>{1, 3, 4});
+  CHECK(get_strategy(2) == std::vector<uint64_t>{2, 5, 6});
+  CHECK(get_strategy(3) == std::vector<uint64_t>{});
+  CHECK(get_routing_id("abc"sv) == std::vector<uint64_t>{1, 2});
+  CHECK(get_routing_id("xyz"sv) == std::vector<uint64_t>{});
+  // complete
+  order_update(cache, 2, OrderStatus::CANCELED);
+  order_update(cache, 6, OrderStatus::COMPLETED);
+  CHECK(get(Side::BUY) == std::vector<uint64_t>{3, 1});
+  CHECK(get_strategy(2) == std::vector<uint64_t>{5});
+  CHECK(get_routing_id("abc"sv) == std::vector<uint64_t>{1});
+  // modify (price)
+  MessageInfo message_info;
+  OrderUpdate order_update{
+      .account = {},
+      .order_id = 1,
+      .exchange = {},
+      .symbol = {},
+      .execution_instructions = {},
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .order_status = OrderStatus::WORKING,
+      .price = 105.0,
+      .routing_id = {},
+      .user = {},
+  };
+  cache(Event{message_info, order_update});
+  CHECK(get(Side::BUY) == std::vector<uint64_t>{1, 3});
+  // clear
+  cache.clear();
+  CHECK(get(Side::BUY) == std::vector<uint64_t>{});
+  CHECK(get_strategy(1) == std::vector<uint64_t>{});
+  CHECK(get_routing_id("abc"sv) == std::vector<uint64_t>{});
+}
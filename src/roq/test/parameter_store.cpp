@@ -0,0 +1,207 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <thread>
+
+#include "roq/cache/parameter_store.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Parameters final {
+  double max_position = 1.0;
+  int32_t levels = 5;
+  int64_t interval = {};
+  bool enabled = true;
+};
+
+auto create_parameter(
+    std::string_view const &label,
+    uint32_t strategy_id,
+    std::string_view const &account,
+    std::string_view const &symbol,
+    std::string_view const &value) {
+  return Parameter{
+      .label = label,
+      .strategy_id = strategy_id,
+      .account = account,
+      .exchange = std::empty(symbol) ? ""sv : "deribit"sv,
+      .symbol = symbol,
+      .value = value,
+  };
+}
+
+void parameters_update(auto &store, std::span<Parameter const> const &parameters, UpdateType update_type) {
+  MessageInfo message_info;
+  ParametersUpdate parameters_update{
+      .parameters = parameters,
+      .update_type = update_type,
+      .user = {},
+  };
+  Event event{message_info, parameters_update};
+  store(event);
+}
+}  // namespace
+
+TEST_CASE("parameter_store_simple", "[parameter_store]") {
+  cache::ParameterStore<Parameters> store{
+      {
+          {"max_position"sv, &Parameters::max_position},
+          {"levels"sv, &Parameters::levels},
+          {"interval"sv, &Parameters::interval},
+          {"enabled"sv, &Parameters::enabled},
+      },
+      123,
+  };
+  auto btc = store.add("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  auto eth = store.add("A1"sv, "deribit"sv, "ETH-PERPETUAL"sv);
+  auto other = store.add("A2"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  CHECK(store.add("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv) == btc);
+  // defaults
+  CHECK(store[btc].max_position == 1.0);
+  CHECK(store[btc].levels == 5);
+  CHECK(store[btc].enabled == true);
+  // note! order does not matter, the most specific wins
+  std::vector<Parameter> parameters{
+      create_parameter("max_position"sv, 0, "A1"sv, "BTC-PERPETUAL"sv, "4.5"sv),
+      create_parameter("max_position"sv, 0, ""sv, ""sv, "2"sv),
+      create_parameter("max_position"sv, 0, "A1"sv, ""sv, "3"sv),
+      create_parameter("levels"sv, 123, ""sv, ""sv, "10"sv),
+      create_parameter("levels"sv, 0, ""sv, ""sv, "7"sv),
+      create_parameter("levels"sv, 456, ""sv, ""sv, "20"sv),  // other strategy
+      create_parameter("interval"sv, 0, ""sv, ""sv, "100"sv),
+      create_parameter("enabled"sv, 0, ""sv, "ETH-PERPETUAL"sv, "False"sv),
+      create_parameter("unknown"sv, 0, ""sv, ""sv, "abc"sv),
+      create_parameter("levels"sv, 0, "A2"sv, ""sv, "1.5"sv),  // error
+  };
+  auto &before = store[btc];
+  parameters_update(store, parameters, UpdateType::SNAPSHOT);
+  CHECK(&store[btc] != &before);
+  CHECK(store.version() == 1);
+  CHECK(store.errors() == 1);
+  CHECK(store[btc].max_position == 4.5);
+  CHECK(store[eth].max_position == 3.0);
+  CHECK(store[other].max_position == 2.0);
+  CHECK(store[btc].levels == 10);
+  CHECK(store[other].levels == 10);
+  CHECK(store[btc].interval == 100);
+  CHECK(store[btc].enabled == true);
+  CHECK(store[eth].enabled == false);
+  // incremental
+  std::vector<Parameter> parameters_2{
+      create_parameter("max_position"sv, 0, "A1"sv, ""sv, "5"sv),
+  };
+  parameters_update(store, parameters_2, UpdateType::INCREMENTAL);
+  CHECK(store[btc].max_position == 4.5);
+  CHECK(store[eth].max_position == 5.0);
+  CHECK(store[eth].enabled == false);
+  // snapshot (replaces everything)
+  parameters_update(store, parameters_2, UpdateType::SNAPSHOT);
+  CHECK(store[btc].max_position == 5.0);
+  CHECK(store[eth].enabled == true);
+  CHECK(store[other].max_position == 1.0);
+  CHECK(store.version() == 3);
+}
+
+TEST_CASE("parameter_store_overflow", "[parameter_store]") {
+  cache::ParameterStore<Parameters> store{
+      {
+          {"levels"sv, &Parameters::levels},
+          {"interval"sv, &Parameters::interval},
+      },
+  };
+  auto btc = store.add("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  std::vector<Parameter> parameters{
+      create_parameter("levels"sv, 0, ""sv, ""sv, "3000000000"sv),  // error (int32_t)
+      create_parameter("interval"sv, 0, ""sv, ""sv, "3000000000"sv),
+  };
+  parameters_update(store, parameters, UpdateType::SNAPSHOT);
+  CHECK(store.errors() == 1);
+  CHECK(store[btc].levels == 5);
+  CHECK(store[btc].interval == 3000000000);
+}
+
+TEST_CASE("parameter_store_reader", "[parameter_store]") {
+  cache::ParameterStore<Parameters> store{
+      {
+          {"max_position"sv, &Parameters::max_position},
+      },
+  };
+  auto btc = store.add("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  auto reader = store.create_reader();
+  CHECK(store.retired() == 0);
+  std::vector<Parameter> parameters{
+      create_parameter("max_position"sv, 0, ""sv, ""sv, "2"sv),
+  };
+  {
+    auto guard = reader.lock();
+    auto &before = guard[btc];
+    CHECK(before.max_position == 1.0);
+    parameters_update(store, parameters, UpdateType::SNAPSHOT);
+    // note! still referenced by the guard
+    CHECK(store.retired() == 1);
+    CHECK(before.max_position == 1.0);
+    CHECK(guard[btc].max_position == 2.0);
+    // note! the table is also retired
+    auto eth = store.add("A1"sv, "deribit"sv, "ETH-PERPETUAL"sv);
+    CHECK(store.retired() == 2);
+    CHECK(store[eth].max_position == 2.0);
+  }
+  parameters_update(store, parameters, UpdateType::INCREMENTAL);
+  CHECK(store.retired() == 0);
+  auto guard = reader.lock();
+  CHECK(guard[btc].max_position == 2.0);
+  CHECK(guard[1].max_position == 2.0);
+}
+
+TEST_CASE("parameter_store_threads", "[parameter_store]") {
+  cache::ParameterStore<Parameters> store{
+      {
+          {"max_position"sv, &Parameters::max_position},
+          {"levels"sv, &Parameters::levels},
+      },
+      {},
+      {
+          .max_position = 0.0,
+          .levels = 0,
+          .interval = {},
+          .enabled = true,
+      },
+  };
+  auto btc = store.add("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  std::atomic<bool> done = false;
+  std::atomic<size_t> errors = {};
+  auto helper = [&, reader = store.create_reader()]() {
+    while (!done.load(std::memory_order_acquire)) {
+      auto guard = reader.lock();
+      auto &parameters = guard[btc];
+      // note! both members are always updated together
+      if (parameters.max_position != static_cast<double>(parameters.levels))
+        ++errors;
+    }
+  };
+  {
+    std::jthread thread{helper};
+    std::vector<Parameter> parameters;
+    for (size_t i = 0; i < 1000; ++i) {
+      auto value = fmt::format("{}"sv, i);
+      parameters = {
+          create_parameter("max_position"sv, 0, ""sv, ""sv, value),
+          create_parameter("levels"sv, 0, ""sv, ""sv, value),
+      };
+      parameters_update(store, parameters, UpdateType::SNAPSHOT);
+      if ((i % 100) == 0)
+        store.add("A1"sv, "deribit"sv, fmt::format("S{}"sv, i));
+    }
+    done.store(true, std::memory_order_release);
+  }
+  CHECK(errors == 0);
+  parameters_update(store, {}, UpdateType::INCREMENTAL);
+  CHECK(store.retired() == 0);
+}
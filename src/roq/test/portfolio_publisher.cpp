@@ -0,0 +1,125 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/portfolio_publisher.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Handler final : public tools::PortfolioPublisher::Handler {
+  void operator()(Portfolio const &portfolio, uint8_t source) override {
+    CHECK(portfolio.update_type == UpdateType::INCREMENTAL);
+    CHECK(portfolio.strategy_id == 123);
+    CHECK(source == 2);
+    accounts.emplace_back(portfolio.account);
+    positions.assign(std::begin(portfolio.positions), std::end(portfolio.positions));
+  }
+  std::vector<std::string> accounts;
+  std::vector<Position> positions;
+};
+
+void timer(auto &publisher, std::chrono::nanoseconds now) {
+  MessageInfo message_info;
+  Timer timer{
+      .now = now,
+  };
+  Event event{message_info, timer};
+  publisher(event);
+}
+}  // namespace
+
+TEST_CASE("portfolio_publisher_is_last", "[portfolio_publisher]") {
+  Handler handler;
+  tools::PortfolioPublisher::Config config{
+      .interval = {},
+      .user = {},
+      .strategy_id = 123,
+      .source = 2,
+  };
+  tools::PortfolioPublisher publisher{handler, config};
+  cache::PositionCache::Position position{
+      .account = "A1"sv,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_quantity = 1.0,
+  };
+  MessageInfo message_info{
+      .source_name = {},
+      .source_session_id = {},
+      .is_last = false,
+  };
+  publisher(position, message_info);
+  position.long_quantity = 2.0;
+  publisher(position, message_info);
+  CHECK(publisher.pending() == 1);
+  CHECK(std::empty(handler.accounts));
+  message_info.is_last = true;
+  position.symbol = "ETH-PERPETUAL"sv;
+  position.short_quantity = 3.0;
+  publisher(position, message_info);
+  CHECK(publisher.pending() == 0);
+  REQUIRE(std::size(handler.accounts) == 1);
+  CHECK(handler.accounts[0] == "A1"sv);
+  REQUIRE(std::size(handler.positions) == 2);
+  CHECK(handler.positions[0].symbol == "BTC-PERPETUAL"sv);
+  CHECK(handler.positions[0].long_position == 2.0);
+  CHECK(handler.positions[0].short_position == 0.0);
+  CHECK(handler.positions[1].symbol == "ETH-PERPETUAL"sv);
+  CHECK(handler.positions[1].short_position == 3.0);
+  // only changed
+  position.short_quantity = 4.0;
+  publisher(position, message_info);
+  REQUIRE(std::size(handler.accounts) == 2);
+  REQUIRE(std::size(handler.positions) == 1);
+  CHECK(handler.positions[0].symbol == "ETH-PERPETUAL"sv);
+  CHECK(handler.positions[0].short_position == 4.0);
+}
+
+TEST_CASE("portfolio_publisher_interval", "[portfolio_publisher]") {
+  Handler handler;
+  tools::PortfolioPublisher::Config config{
+      .interval = 100ms,
+      .user = {},
+      .strategy_id = 123,
+      .source = 2,
+  };
+  tools::PortfolioPublisher publisher{handler, config};
+  auto now = std::chrono::nanoseconds{1s};
+  publisher.update("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv, 1.0, 0.0);
+  publisher.update("A2"sv, "deribit"sv, "BTC-PERPETUAL"sv, 2.0, 0.0);
+  timer(publisher, now);
+  CHECK(handler.accounts == std::vector<std::string>{"A1", "A2"});
+  handler.accounts.clear();
+  publisher.update("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv, 3.0, 0.0);
+  timer(publisher, now + 50ms);
+  CHECK(std::empty(handler.accounts));
+  timer(publisher, now + 100ms);
+  CHECK(handler.accounts == std::vector<std::string>{"A1"});
+  handler.accounts.clear();
+  // note! reverted before publication
+  publisher.update("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv, 4.0, 0.0);
+  publisher.update("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv, 3.0, 0.0);
+  timer(publisher, now + 200ms);
+  CHECK(std::empty(handler.accounts));
+  CHECK(publisher.pending() == 0);
+  // note! is_last is ignored
+  cache::PositionCache::Position position{
+      .account = "A1"sv,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_quantity = 5.0,
+  };
+  MessageInfo message_info{
+      .source_name = {},
+      .source_session_id = {},
+      .is_last = true,
+  };
+  publisher(position, message_info);
+  CHECK(std::empty(handler.accounts));
+  CHECK(publisher.pending() == 1);
+  timer(publisher, now + 300ms);
+  CHECK(handler.accounts == std::vector<std::string>{"A1"});
+}
@@ -0,0 +1,156 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/cache/position_cache.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+auto trade_update(
+    auto &cache,
+    Side side,
+    double quantity,
+    double price,
+    std::string_view const &trade_id,
+    PositionEffect position_effect = {},
+    std::string_view const &account = "A1"sv) {
+  MessageInfo message_info;
+  Fill fill{
+      .exchange_time_utc = {},
+      .external_trade_id = trade_id,
+      .quantity = quantity,
+      .price = price,
+      .liquidity = {},
+  };
+  TradeUpdate trade_update{
+      .stream_id = {},
+      .account = account,
+      .order_id = 1,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .side = side,
+      .position_effect = position_effect,
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .fills = {&fill, 1},
+      .routing_id = {},
+      .user = {},
+  };
+  Event event{message_info, trade_update};
+  return cache(event);
+}
+
+void top_of_book(auto &cache, double bid_price, double ask_price) {
+  MessageInfo message_info;
+  TopOfBook top_of_book{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .layer{
+          .bid_price = bid_price,
+          .bid_quantity = 1.0,
+          .ask_price = ask_price,
+          .ask_quantity = 1.0,
+      },
+  };
+  Event event{message_info, top_of_book};
+  cache(event);
+}
+
+void reference_data(auto &cache, std::string_view const &symbol, double multiplier) {
+  MessageInfo message_info;
+  ReferenceData reference_data{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = symbol,
+      .description = {},
+      .security_type = {},
+      .base_currency = {},
+      .quote_currency = {},
+      .margin_currency = {},
+      .commission_currency = {},
+      .tick_size = NaN,
+      .multiplier = multiplier,
+      .min_notional = NaN,
+      .min_trade_vol = NaN,
+      .max_trade_vol = NaN,
+      .trade_vol_step_size = NaN,
+      .strike_currency = {},
+      .underlying = {},
+      .time_zone = {},
+  };
+  Event event{message_info, reference_data};
+  cache(event);
+}
+}  // namespace
+
+TEST_CASE("position_cache_simple", "[position_cache]") {
+  cache::PositionCache cache;
+  auto position = trade_update(cache, Side::BUY, 2.0, 100.0, "1"sv);
+  REQUIRE(position != nullptr);
+  CHECK(position->long_quantity == 2.0);
+  CHECK(position->long_average_price == 100.0);
+  position = trade_update(cache, Side::BUY, 2.0, 110.0, "2"sv);
+  CHECK(position->long_quantity == 4.0);
+  CHECK(position->long_average_price == 105.0);
+  // duplicate
+  CHECK(trade_update(cache, Side::BUY, 2.0, 110.0, "2"sv) == nullptr);
+  CHECK(position->long_quantity == 4.0);
+  top_of_book(cache, 109.0, 111.0);
+  CHECK(position->unrealized_pnl == 20.0);
+  // netting
+  position = trade_update(cache, Side::SELL, 5.0, 115.0, "3"sv);
+  CHECK(position->long_quantity == 0.0);
+  CHECK(position->short_quantity == 1.0);
+  CHECK(position->short_average_price == 115.0);
+  CHECK(position->realized_pnl == 40.0);
+  CHECK(position->unrealized_pnl == 5.0);
+  CHECK(position->net_quantity() == -1.0);
+  CHECK(cache.size() == 1);
+  CHECK(cache.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv) == position);
+  CHECK(cache.find("A2"sv, "deribit"sv, "BTC-PERPETUAL"sv) == nullptr);
+}
+
+TEST_CASE("position_cache_duplicate", "[position_cache]") {
+  cache::PositionCache cache;
+  CHECK(trade_update(cache, Side::BUY, 1.0, 100.0, "1"sv) != nullptr);
+  // note! duplicates must not create a position
+  CHECK(trade_update(cache, Side::BUY, 1.0, 100.0, "1"sv, {}, "A2"sv) == nullptr);
+  CHECK(cache.size() == 1);
+  CHECK(cache.find("A2"sv, "deribit"sv, "BTC-PERPETUAL"sv) == nullptr);
+}
+
+TEST_CASE("position_cache_close_excess", "[position_cache]") {
+  cache::PositionCache cache;
+  trade_update(cache, Side::BUY, 2.0, 100.0, "1"sv);
+  auto position = trade_update(cache, Side::SELL, 3.0, 110.0, "2"sv, PositionEffect::CLOSE);
+  REQUIRE(position != nullptr);
+  CHECK(position->long_quantity == 0.0);
+  CHECK(position->short_quantity == 0.0);
+  CHECK(position->realized_pnl == 20.0);
+  CHECK(position->close_excess_quantity == 1.0);
+}
+
+TEST_CASE("position_cache_multiplier", "[position_cache]") {
+  cache::PositionCache cache;
+  reference_data(cache, "BTC-PERPETUAL"sv, 10.0);
+  reference_data(cache, "ETH-PERPETUAL"sv, 100.0);
+  REQUIRE(trade_update(cache, Side::BUY, 1.0, 100.0, "1"sv) != nullptr);
+  REQUIRE(trade_update(cache, Side::BUY, 1.0, 100.0, "2"sv, {}, "A2"sv) != nullptr);
+  auto position = cache.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  auto position_2 = cache.find("A2"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(position != nullptr);
+  REQUIRE(position_2 != nullptr);
+  CHECK(position->multiplier == 10.0);
+  top_of_book(cache, 101.0, 101.0);
+  CHECK(position->unrealized_pnl == 10.0);
+  // note! applied to all positions of the instrument
+  reference_data(cache, "BTC-PERPETUAL"sv, 20.0);
+  CHECK(position->multiplier == 20.0);
+  CHECK(position_2->multiplier == 20.0);
+  CHECK(position_2->unrealized_pnl == 20.0);
+}
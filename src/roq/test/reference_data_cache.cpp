@@ -0,0 +1,121 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+
+#include "roq/cache/reference_data_cache.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+auto &reference_data(auto &cache, double tick_size, double trade_vol_step_size, double min_trade_vol) {
+  MessageInfo message_info;
+  ReferenceData reference_data{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .description = {},
+      .security_type = SecurityType::FUTURES,
+      .base_currency = "BTC"sv,
+      .quote_currency = "USD"sv,
+      .margin_currency = {},
+      .commission_currency = {},
+      .tick_size = tick_size,
+      .multiplier = 10.0,
+      .min_notional = 100.0,
+      .min_trade_vol = min_trade_vol,
+      .max_trade_vol = 1000.0,
+      .trade_vol_step_size = trade_vol_step_size,
+      .strike_currency = {},
+      .underlying = {},
+      .time_zone = {},
+  };
+  Event event{message_info, reference_data};
+  return cache(event);
+}
+}  // namespace
+
+TEST_CASE("reference_data_cache_precision", "[reference_data_cache]") {
+  using cache::ReferenceDataCache;
+  CHECK(ReferenceDataCache::compute_precision(1.0) == Precision::_0);
+  CHECK(ReferenceDataCache::compute_precision(5.0) == Precision::_0);
+  CHECK(ReferenceDataCache::compute_precision(0.5) == Precision::_1);
+  CHECK(ReferenceDataCache::compute_precision(0.01) == Precision::_2);
+  CHECK(ReferenceDataCache::compute_precision(0.05) == Precision::_2);
+  CHECK(ReferenceDataCache::compute_precision(0.07) == Precision::_2);
+  CHECK(ReferenceDataCache::compute_precision(0.00001) == Precision::_5);
+  CHECK(ReferenceDataCache::compute_precision(0.0) == Precision::UNDEFINED);
+  CHECK(ReferenceDataCache::compute_precision(NaN) == Precision::UNDEFINED);
+}
+
+TEST_CASE("reference_data_cache_simple", "[reference_data_cache]") {
+  cache::ReferenceDataCache cache;
+  CHECK(cache.find("deribit"sv, "BTC-PERPETUAL"sv) == nullptr);
+  auto &instrument = reference_data(cache, 0.1, 0.001, 0.01);
+  CHECK(cache.size() == 1);
+  CHECK(cache.find("deribit"sv, "BTC-PERPETUAL"sv) == &instrument);
+  CHECK(instrument.has_tick_size());
+  CHECK(instrument.price_precision == Precision::_1);
+  CHECK(instrument.quantity_precision == Precision::_3);
+  CHECK(instrument.tick_units == 1);
+  // prices
+  CHECK(instrument.to_ticks(0.3) == 3);
+  CHECK(instrument.to_ticks(123.44) == 1234);
+  CHECK(instrument.from_ticks(3) == 0.3);
+  CHECK(instrument.round_to_tick(0.30000000000000004) == 0.3);
+  CHECK(instrument.round_to_tick(123.46) == 123.5);
+  CHECK(instrument.round_to_tick(-1.04) == -1.0);
+  CHECK(std::isnan(instrument.round_to_tick(NaN)));
+  CHECK(instrument.validate_price(0.1 + 0.2) == true);
+  CHECK(instrument.validate_price(0.15) == false);
+  // quantities
+  CHECK(instrument.validate_quantity(0.01) == true);
+  CHECK(instrument.validate_quantity(0.1 + 0.2) == true);
+  CHECK(instrument.validate_quantity(0.0105) == false);    // step
+  CHECK(instrument.validate_quantity(0.009) == false);     // min
+  CHECK(instrument.validate_quantity(1000.001) == false);  // max
+  CHECK(instrument.validate_quantity(0.0) == false);
+  CHECK(instrument.validate_quantity(NaN) == false);
+  CHECK(instrument.validate_notional(100.0, 0.1) == true);
+  CHECK(instrument.validate_notional(90.0, 0.1) == false);
+  // NaN means unchanged
+  reference_data(cache, 0.05, NaN, NaN);
+  CHECK(instrument.price_precision == Precision::_2);
+  CHECK(instrument.tick_units == 5);
+  CHECK(instrument.round_to_tick(1.23) == 1.25);
+  CHECK(instrument.from_ticks(7) == 0.35);
+  CHECK(instrument.quantity_precision == Precision::_3);
+  CHECK(instrument.min_trade_vol == 0.01);
+}
+
+TEST_CASE("reference_data_cache_unknown_tick_size", "[reference_data_cache]") {
+  cache::ReferenceDataCache::Instrument unknown;
+  CHECK(unknown.has_tick_size() == false);
+  CHECK(unknown.round_to_tick(101.25) == 101.25);
+  CHECK(std::isnan(unknown.round_to_tick(NaN)));
+  CHECK(unknown.validate_price(101.25) == true);
+  // unrepresentable (no decimal precision)
+  cache::ReferenceDataCache cache;
+  auto &instrument = reference_data(cache, 1.0e-20, 0.001, 0.01);
+  CHECK(instrument.has_tick_size() == false);
+  CHECK(instrument.round_to_tick(101.25) == 101.25);
+  CHECK(instrument.validate_price(101.25) == true);
+}
+
+TEST_CASE("reference_data_cache_limits", "[reference_data_cache]") {
+  cache::ReferenceDataCache cache;
+  auto &instrument = reference_data(cache, 0.1, 0.1, 0.3);
+  CHECK(instrument.validate_quantity(0.29999999999999993) == true);  // rounding noise
+  CHECK(instrument.validate_quantity(0.1 + 0.2) == true);
+  CHECK(instrument.validate_quantity(0.2) == false);
+  CHECK(instrument.validate_quantity(1000.0000000000001) == true);
+  CHECK(instrument.validate_quantity(1000.1) == false);
+  // unknown step size (relative to the limit)
+  cache::ReferenceDataCache cache_2;
+  auto &instrument_2 = reference_data(cache_2, 0.1, NaN, 0.3);
+  CHECK(instrument_2.validate_quantity(0.29999999999999993) == true);
+  CHECK(instrument_2.validate_quantity(0.2999) == false);
+}
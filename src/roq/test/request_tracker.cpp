@@ -0,0 +1,196 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/request_tracker.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Handler final : public tools::RequestTracker::Handler {
+  void operator()(tools::RequestTracker::Request const &request) override {
+    CHECK(request.request_status == RequestStatus::TIMEOUT);
+    order_ids.emplace_back(request.order_id);
+  }
+  std::vector<uint64_t> order_ids;
+};
+
+void create_order(auto &tracker, uint64_t order_id, std::chrono::nanoseconds now) {
+  CreateOrder create_order{
+      .account = "A1"sv,
+      .order_id = order_id,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .execution_instructions = {},
+      .request_template = {},
+      .routing_id = {},
+  };
+  TraceInfo trace_info{now, now, now};
+  tracker(create_order, trace_info);
+}
+
+void cancel_order(auto &tracker, uint64_t order_id, uint32_t version, std::chrono::nanoseconds now) {
+  CancelOrder cancel_order{
+      .account = "A1"sv,
+      .order_id = order_id,
+      .request_template = {},
+      .routing_id = {},
+      .version = version,
+      .conditional_on_version = {},
+  };
+  TraceInfo trace_info{now, now, now};
+  tracker(cancel_order, trace_info);
+}
+
+bool order_ack(auto &tracker, uint64_t order_id, uint32_t version, RequestStatus request_status, auto now) {
+  MessageInfo message_info{
+      .source_name = {},
+      .source_session_id = {},
+      .receive_time = now,
+  };
+  OrderAck order_ack{
+      .account = {},
+      .order_id = order_id,
+      .exchange = {},
+      .symbol = {},
+      .request_status = request_status,
+      .text = {},
+      .request_id = {},
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .routing_id = {},
+      .version = version,
+      .user = {},
+  };
+  Event event{message_info, order_ack};
+  return tracker(event);
+}
+
+void timer(auto &tracker, std::chrono::nanoseconds now) {
+  MessageInfo message_info;
+  Timer timer{
+      .now = now,
+  };
+  Event event{message_info, timer};
+  tracker(event);
+}
+}  // namespace
+
+TEST_CASE("request_tracker_simple", "[request_tracker]") {
+  Handler handler;
+  tools::RequestTracker::Config config{
+      .timeout = 10ms,
+      .resolution = 1ms,
+  };
+  tools::RequestTracker tracker{handler, config};
+  auto now = std::chrono::nanoseconds{1s};
+  create_order(tracker, 1, now);
+  create_order(tracker, 2, now);
+  cancel_order(tracker, 1, 2, now + 1ms);
+  CHECK(tracker.size() == 3);
+  REQUIRE(tracker.find(1, 1) != nullptr);
+  CHECK(tracker.find(1, 1)->request_type == RequestType::CREATE_ORDER);
+  REQUIRE(tracker.find(1, 2) != nullptr);
+  CHECK(tracker.find(1, 2)->request_type == RequestType::CANCEL_ORDER);
+  // forwarded is not final
+  CHECK(order_ack(tracker, 1, 1, RequestStatus::FORWARDED, now + 1ms) == true);
+  CHECK(tracker.size() == 3);
+  CHECK(tracker.find(1, 1)->request_status == RequestStatus::FORWARDED);
+  CHECK(order_ack(tracker, 1, 1, RequestStatus::ACCEPTED, now + 3ms) == true);
+  CHECK(tracker.size() == 2);
+  CHECK(tracker.find(1, 1) == nullptr);
+  CHECK(tracker.latency().count() == 1);
+  CHECK(tracker.latency().sum() == 3ms);
+  // unknown
+  CHECK(order_ack(tracker, 1, 1, RequestStatus::ACCEPTED, now + 4ms) == false);
+  CHECK(order_ack(tracker, 3, 1, RequestStatus::ACCEPTED, now + 4ms) == false);
+  // timeout
+  timer(tracker, now + 9ms);
+  CHECK(std::empty(handler.order_ids));
+  timer(tracker, now + 10ms);
+  CHECK(handler.order_ids == std::vector<uint64_t>{2});
+  CHECK(tracker.size() == 1);
+  timer(tracker, now + 11ms);
+  CHECK(handler.order_ids == std::vector<uint64_t>{2, 1});
+  CHECK(tracker.size() == 0);
+  CHECK(tracker.timeouts() == 2);
+  // late ack
+  CHECK(order_ack(tracker, 2, 1, RequestStatus::ACCEPTED, now + 12ms) == false);
+  CHECK(tracker.latency().count() == 1);
+}
+
+TEST_CASE("request_tracker_cascade", "[request_tracker]") {
+  Handler handler;
+  tools::RequestTracker::Config config{
+      .timeout = 100ms,
+      .resolution = 10us,  // note! 10,000 ticks, i.e. spans 3 levels of the wheel
+  };
+  tools::RequestTracker tracker{handler, config};
+  auto now = std::chrono::nanoseconds{1s} + 123us;
+  for (uint64_t order_id = 1; order_id <= 100; ++order_id)
+    create_order(tracker, order_id, now + order_id * 1ms);
+  // note! timer less frequent than resolution
+  for (auto time = now; time < (now + 300ms); time += 3ms) {
+    timer(tracker, time);
+    for (auto order_id : handler.order_ids) {
+      auto expire = now + order_id * 1ms + 100ms;
+      CHECK(expire <= time);
+      CHECK((time - expire) < (3ms + 10us));
+    }
+    handler.order_ids.clear();
+  }
+  CHECK(tracker.size() == 0);
+  CHECK(tracker.timeouts() == 100);
+}
+
+TEST_CASE("request_tracker_overflow", "[request_tracker]") {
+  Handler handler;
+  tools::RequestTracker::Config config{
+      .timeout = 20ms,
+      .resolution = 1ns,  // note! 20,000,000 ticks, i.e. beyond the range of the wheel
+  };
+  tools::RequestTracker tracker{handler, config};
+  auto now = std::chrono::nanoseconds{1s};
+  create_order(tracker, 1, now);
+  timer(tracker, now + 20ms - 1ns);
+  CHECK(std::empty(handler.order_ids));
+  timer(tracker, now + 20ms);
+  CHECK(handler.order_ids == std::vector<uint64_t>{1});
+}
+
+TEST_CASE("request_tracker_jump", "[request_tracker]") {
+  Handler handler;
+  tools::RequestTracker::Config config{
+      .timeout = 1h,
+      .resolution = 1ns,  // note! 3.6e12 ticks, i.e. only feasible if empty slots are skipped
+  };
+  tools::RequestTracker tracker{handler, config};
+  auto now = std::chrono::nanoseconds{1s};
+  create_order(tracker, 1, now);
+  create_order(tracker, 2, now + 30min);
+  timer(tracker, now + 1h - 1ns);
+  CHECK(std::empty(handler.order_ids));
+  timer(tracker, now + 2h);
+  CHECK(handler.order_ids == std::vector<uint64_t>{1, 2});
+  CHECK(tracker.size() == 0);
+}
+
+TEST_CASE("request_tracker_histogram", "[request_tracker]") {
+  metrics::Histogram histogram;
+  histogram(0ns);
+  histogram(1023ns);
+  histogram(1024ns);  // note! upper bound is inclusive
+  histogram(1025ns);
+  histogram(2048ns);
+  histogram(1h);
+  CHECK(histogram.count() == 6);
+  CHECK(histogram[0] == 3);
+  CHECK(histogram[1] == 2);
+  CHECK(histogram[2] == 0);
+  CHECK(histogram[metrics::Histogram::SIZE - 1] == 1);
+  CHECK(metrics::Histogram::bucket_limit(0) == 1024.0);
+  CHECK(metrics::Histogram::bucket_limit(1) == 2048.0);
+}
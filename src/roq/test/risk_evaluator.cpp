@@ -0,0 +1,333 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/risk_evaluator.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+auto create_order(auto &risk_evaluator, uint64_t order_id, Side side, double quantity) {
+  CreateOrder create_order{
+      .account = "A1"sv,
+      .order_id = order_id,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .side = side,
+      .execution_instructions = {},
+      .request_template = {},
+      .quantity = quantity,
+      .routing_id = {},
+  };
+  return risk_evaluator(create_order);
+}
+
+void risk_limits_update(auto &risk_evaluator, RiskLimit const &risk_limit) {
+  MessageInfo message_info;
+  RiskLimitsUpdate risk_limits_update{
+      .user = {},
+      .strategy_id = {},
+      .account = "A1"sv,
+      .limits = {&risk_limit, 1},
+      .update_type = UpdateType::SNAPSHOT,
+  };
+  Event event{message_info, risk_limits_update};
+  risk_evaluator(event);
+}
+
+void order_ack(auto &risk_evaluator, uint64_t order_id, RequestType request_type, RequestStatus request_status) {
+  MessageInfo message_info;
+  OrderAck order_ack{
+      .account = {},
+      .order_id = order_id,
+      .exchange = {},
+      .symbol = {},
+      .request_type = request_type,
+      .request_status = request_status,
+      .text = {},
+      .request_id = {},
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .routing_id = {},
+      .user = {},
+  };
+  Event event{message_info, order_ack};
+  risk_evaluator(event);
+}
+
+void order_update(auto &risk_evaluator, uint64_t order_id, OrderStatus order_status, double remaining_quantity) {
+  MessageInfo message_info;
+  OrderUpdate order_update{
+      .account = {},
+      .order_id = order_id,
+      .exchange = {},
+      .symbol = {},
+      .execution_instructions = {},
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .order_status = order_status,
+      .remaining_quantity = remaining_quantity,
+      .routing_id = {},
+      .user = {},
+  };
+  Event event{message_info, order_update};
+  risk_evaluator(event);
+}
+
+void trade_update(auto &risk_evaluator, Side side, double quantity, std::string_view const &trade_id) {
+  MessageInfo message_info;
+  Fill fill{
+      .exchange_time_utc = {},
+      .external_trade_id = trade_id,
+      .quantity = quantity,
+      .price = 100.0,
+      .liquidity = {},
+  };
+  TradeUpdate trade_update{
+      .stream_id = {},
+      .account = "A1"sv,
+      .order_id = 1,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .side = side,
+      .position_effect = {},
+      .external_account = {},
+      .external_order_id = {},
+      .client_order_id = {},
+      .fills = {&fill, 1},
+      .routing_id = {},
+      .user = {},
+  };
+  Event event{message_info, trade_update};
+  risk_evaluator(event);
+}
+}  // namespace
+
+TEST_CASE("risk_evaluator_no_limits", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  CHECK(create_order(risk_evaluator, 1, Side::BUY, 1000.0) == Error::UNDEFINED);
+  CHECK(create_order(risk_evaluator, 2, Side::SELL, 1000.0) == Error::UNDEFINED);
+}
+
+TEST_CASE("risk_evaluator_simple", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  RiskLimit risk_limit{
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_position = 0.0,
+      .short_position = 0.0,
+      .long_position_limit = 5.0,
+      .short_position_limit = 5.0,
+      .long_risk_exposure_limit = 8.0,
+      .short_risk_exposure_limit = NaN,
+      .allow_netting = false,
+  };
+  risk_limits_update(risk_evaluator, risk_limit);
+  CHECK(create_order(risk_evaluator, 1, Side::BUY, 6.0) == Error::RISK_LIMIT_REACHED);
+  CHECK(create_order(risk_evaluator, 2, Side::BUY, 5.0) == Error::UNDEFINED);
+  CHECK(create_order(risk_evaluator, 3, Side::BUY, 4.0) == Error::RISK_LIMIT_REACHED);
+  CHECK(create_order(risk_evaluator, 4, Side::BUY, 3.0) == Error::UNDEFINED);
+  auto instrument = risk_evaluator.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(instrument != nullptr);
+  CHECK(instrument->buy_working == 8.0);
+  order_update(risk_evaluator, 2, OrderStatus::CANCELED, 0.0);
+  CHECK(instrument->buy_working == 3.0);
+  ModifyOrder modify_order{
+      .account = "A1"sv,
+      .order_id = 4,
+      .request_template = {},
+      .quantity = 6.0,
+      .routing_id = {},
+  };
+  CHECK(risk_evaluator(modify_order) == Error::RISK_LIMIT_REACHED);
+  modify_order.quantity = 5.0;
+  CHECK(risk_evaluator(modify_order) == Error::UNDEFINED);
+  CHECK(instrument->buy_working == 5.0);
+  CHECK(create_order(risk_evaluator, 5, Side::SELL, 5.0) == Error::UNDEFINED);
+}
+
+TEST_CASE("risk_evaluator_reject", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  RiskLimit risk_limit{
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_position = 0.0,
+      .short_position = 0.0,
+      .long_position_limit = NaN,
+      .short_position_limit = NaN,
+      .long_risk_exposure_limit = 5.0,
+      .short_risk_exposure_limit = NaN,
+      .allow_netting = false,
+  };
+  risk_limits_update(risk_evaluator, risk_limit);
+  auto instrument = risk_evaluator.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(instrument != nullptr);
+  // note! a reject storm must not inflate the working quantity
+  for (uint64_t order_id = 1; order_id <= 10; ++order_id) {
+    CHECK(create_order(risk_evaluator, order_id, Side::BUY, 5.0) == Error::UNDEFINED);
+    order_ack(risk_evaluator, order_id, RequestType::CREATE_ORDER, RequestStatus::REJECTED);
+    CHECK(instrument->buy_working == 0.0);
+  }
+  CHECK(create_order(risk_evaluator, 11, Side::BUY, 2.0) == Error::UNDEFINED);
+  order_ack(risk_evaluator, 11, RequestType::CREATE_ORDER, RequestStatus::ACCEPTED);
+  ModifyOrder modify_order{
+      .account = "A1"sv,
+      .order_id = 11,
+      .request_template = {},
+      .quantity = 4.0,
+      .routing_id = {},
+  };
+  CHECK(risk_evaluator(modify_order) == Error::UNDEFINED);
+  CHECK(instrument->buy_working == 4.0);
+  order_ack(risk_evaluator, 11, RequestType::MODIFY_ORDER, RequestStatus::REJECTED);
+  CHECK(instrument->buy_working == 2.0);
+  // note! the order itself is still working
+  order_ack(risk_evaluator, 11, RequestType::CREATE_ORDER, RequestStatus::REJECTED);
+  CHECK(instrument->buy_working == 2.0);
+}
+
+TEST_CASE("risk_evaluator_invalid_quantity", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  RiskLimit risk_limit{
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_position = 0.0,
+      .short_position = 0.0,
+      .long_position_limit = 5.0,
+      .short_position_limit = 5.0,
+      .long_risk_exposure_limit = 5.0,
+      .short_risk_exposure_limit = 5.0,
+      .allow_netting = false,
+  };
+  risk_limits_update(risk_evaluator, risk_limit);
+  CHECK(create_order(risk_evaluator, 1, Side::BUY, NaN) == Error::INVALID_QUANTITY);
+  CHECK(create_order(risk_evaluator, 2, Side::BUY, 0.0) == Error::INVALID_QUANTITY);
+  CHECK(create_order(risk_evaluator, 3, Side::SELL, -1.0) == Error::INVALID_QUANTITY);
+  auto instrument = risk_evaluator.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(instrument != nullptr);
+  CHECK(instrument->buy_working == 0.0);
+  CHECK(instrument->sell_working == 0.0);
+  // note! limits must still be enforced
+  CHECK(create_order(risk_evaluator, 4, Side::BUY, 5.0) == Error::UNDEFINED);
+  CHECK(create_order(risk_evaluator, 5, Side::BUY, 1.0) == Error::RISK_LIMIT_REACHED);
+  ModifyOrder modify_order{
+      .account = "A1"sv,
+      .order_id = 4,
+      .request_template = {},
+      .quantity = -1.0,
+      .routing_id = {},
+  };
+  CHECK(risk_evaluator(modify_order) == Error::INVALID_QUANTITY);
+  CHECK(instrument->buy_working == 5.0);
+}
+
+TEST_CASE("risk_evaluator_invalid_request", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  CHECK(create_order(risk_evaluator, 1, Side::UNDEFINED, 1.0) == Error::INVALID_SIDE);
+  CHECK(create_order(risk_evaluator, 2, Side::BUY, 1.0) == Error::UNDEFINED);
+  auto instrument = risk_evaluator.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(instrument != nullptr);
+  CHECK(instrument->buy_working == 1.0);
+  // note! a repeated order_id must not double-count the working quantity
+  CHECK(create_order(risk_evaluator, 2, Side::BUY, 1.0) == Error::INVALID_ORDER_ID);
+  CHECK(create_order(risk_evaluator, 2, Side::SELL, 1.0) == Error::INVALID_ORDER_ID);
+  CHECK(instrument->buy_working == 1.0);
+  CHECK(instrument->sell_working == 0.0);
+  order_update(risk_evaluator, 2, OrderStatus::CANCELED, 0.0);
+  CHECK(instrument->buy_working == 0.0);
+}
+
+TEST_CASE("risk_evaluator_position", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  RiskLimit risk_limit{
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_position = 0.0,
+      .short_position = 0.0,
+      .long_position_limit = 5.0,
+      .short_position_limit = NaN,
+      .long_risk_exposure_limit = 6.0,
+      .short_risk_exposure_limit = NaN,
+      .allow_netting = false,
+  };
+  risk_limits_update(risk_evaluator, risk_limit);
+  auto instrument = risk_evaluator.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(instrument != nullptr);
+  trade_update(risk_evaluator, Side::BUY, 3.0, "t1"sv);
+  CHECK(instrument->long_position == 3.0);
+  CHECK(create_order(risk_evaluator, 1, Side::BUY, 3.0) == Error::RISK_LIMIT_REACHED);
+  CHECK(create_order(risk_evaluator, 2, Side::BUY, 2.0) == Error::UNDEFINED);
+  // note! replayed (e.g. after reconnect)
+  trade_update(risk_evaluator, Side::BUY, 3.0, "t1"sv);
+  CHECK(instrument->long_position == 3.0);
+  CHECK(create_order(risk_evaluator, 3, Side::BUY, 1.0) == Error::UNDEFINED);
+  CHECK(create_order(risk_evaluator, 4, Side::BUY, 1.0) == Error::RISK_LIMIT_REACHED);
+  // note! no netting
+  trade_update(risk_evaluator, Side::SELL, 2.0, "t2"sv);
+  CHECK(instrument->long_position == 3.0);
+  CHECK(instrument->short_position == 2.0);
+  CHECK(create_order(risk_evaluator, 5, Side::BUY, 1.0) == Error::RISK_LIMIT_REACHED);
+}
+
+TEST_CASE("risk_evaluator_nan_position", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  RiskLimit risk_limit{
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_position = 4.0,
+      .short_position = 0.0,
+      .long_position_limit = 5.0,
+      .short_position_limit = NaN,
+      .long_risk_exposure_limit = NaN,
+      .short_risk_exposure_limit = NaN,
+      .allow_netting = false,
+  };
+  risk_limits_update(risk_evaluator, risk_limit);
+  auto instrument = risk_evaluator.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(instrument != nullptr);
+  CHECK(create_order(risk_evaluator, 1, Side::BUY, 2.0) == Error::RISK_LIMIT_REACHED);
+  // note! NaN means unchanged
+  risk_limit.long_position = NaN;
+  risk_limit.short_position = NaN;
+  risk_limits_update(risk_evaluator, risk_limit);
+  CHECK(instrument->long_position == 4.0);
+  CHECK(instrument->short_position == 0.0);
+  CHECK(create_order(risk_evaluator, 2, Side::BUY, 2.0) == Error::RISK_LIMIT_REACHED);
+  CHECK(create_order(risk_evaluator, 3, Side::BUY, 1.0) == Error::UNDEFINED);
+}
+
+TEST_CASE("risk_evaluator_netting", "[risk_evaluator]") {
+  tools::RiskEvaluator risk_evaluator;
+  RiskLimit risk_limit{
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .long_position = 0.0,
+      .short_position = 0.0,
+      .long_position_limit = 5.0,
+      .short_position_limit = 2.0,
+      .long_risk_exposure_limit = NaN,
+      .short_risk_exposure_limit = NaN,
+      .allow_netting = true,
+  };
+  risk_limits_update(risk_evaluator, risk_limit);
+  auto instrument = risk_evaluator.find("A1"sv, "deribit"sv, "BTC-PERPETUAL"sv);
+  REQUIRE(instrument != nullptr);
+  trade_update(risk_evaluator, Side::BUY, 4.0, "t1"sv);
+  CHECK(instrument->long_position == 4.0);
+  // note! the long position is deducted
+  CHECK(create_order(risk_evaluator, 1, Side::SELL, 5.0) == Error::UNDEFINED);
+  CHECK(create_order(risk_evaluator, 2, Side::SELL, 7.0) == Error::RISK_LIMIT_REACHED);
+  CHECK(create_order(risk_evaluator, 3, Side::BUY, 2.0) == Error::RISK_LIMIT_REACHED);
+  // note! a sell fill reduces the long position
+  trade_update(risk_evaluator, Side::SELL, 3.0, "t2"sv);
+  CHECK(instrument->long_position == 1.0);
+  CHECK(instrument->short_position == 0.0);
+  trade_update(risk_evaluator, Side::SELL, 3.0, "t2"sv);
+  CHECK(instrument->long_position == 1.0);
+  CHECK(instrument->short_position == 0.0);
+  CHECK(create_order(risk_evaluator, 4, Side::BUY, 2.0) == Error::UNDEFINED);
+}
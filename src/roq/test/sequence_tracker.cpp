@@ -0,0 +1,115 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/sequence_tracker.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Handler final : public tools::SequenceTracker<uint64_t>::Handler {
+  void operator()(tools::SequenceTracker<uint64_t>::Gap const &gap) override { gaps.emplace_back(gap.first, gap.last); }
+  std::vector<std::pair<uint64_t, uint64_t>> gaps;
+};
+
+struct Helper final {
+  Helper(tools::SequenceTracker<uint64_t>::Config const &config) : tracker{handler, config} {}
+
+  void operator()(uint64_t sequence, bool snapshot = false, std::chrono::nanoseconds now = {}) {
+    auto callback = [&](auto value) { result.emplace_back(value); };
+    tracker(0, 0, "deribit"sv, "BTC-PERPETUAL"sv, sequence, snapshot, now, sequence, callback);
+  }
+
+  void operator()(std::chrono::nanoseconds now) {
+    MessageInfo message_info;
+    Timer timer{
+        .now = now,
+    };
+    Event event{message_info, timer};
+    tracker(event, [&](auto value) { result.emplace_back(value); });
+  }
+
+  Handler handler;
+  tools::SequenceTracker<uint64_t> tracker;
+  std::vector<uint64_t> result;
+};
+}  // namespace
+
+TEST_CASE("sequence_tracker_reorder", "[sequence_tracker]") {
+  Helper helper{{.window = 4, .timeout = 1ms}};
+  helper(1);
+  helper(2);
+  helper(4);
+  helper(5);
+  CHECK(helper.result == std::vector<uint64_t>{1, 2});
+  helper(3);
+  CHECK(helper.result == std::vector<uint64_t>{1, 2, 3, 4, 5});
+  // duplicates
+  helper(5);
+  helper(3);
+  CHECK(helper.tracker.duplicates() == 2);
+  CHECK(helper.tracker.reordered() == 2);
+  CHECK(std::empty(helper.handler.gaps));
+  // zero means unknown
+  helper(0);
+  CHECK(helper.result.back() == 0);
+}
+
+TEST_CASE("sequence_tracker_gap", "[sequence_tracker]") {
+  Helper helper{{.window = 4, .timeout = 1ms}};
+  helper(1);
+  helper(3);
+  helper(5);
+  // timeout => 2 and 4 are missing
+  helper(10ms);
+  CHECK(helper.result == std::vector<uint64_t>{1, 3, 5});
+  REQUIRE(std::size(helper.handler.gaps) == 2);
+  CHECK(helper.handler.gaps[0] == std::pair<uint64_t, uint64_t>{2, 2});
+  CHECK(helper.handler.gaps[1] == std::pair<uint64_t, uint64_t>{4, 4});
+  helper(7);
+  helper(8);
+  // beyond the window => reset, 6 and 9 are missing
+  helper(10, false, 20ms);
+  CHECK(helper.result == std::vector<uint64_t>{1, 3, 5, 7, 8, 10});
+  REQUIRE(std::size(helper.handler.gaps) == 4);
+  CHECK(helper.handler.gaps[2] == std::pair<uint64_t, uint64_t>{6, 6});
+  CHECK(helper.handler.gaps[3] == std::pair<uint64_t, uint64_t>{9, 9});
+  // far beyond the window (nothing buffered) => reported once
+  helper(20, false, 30ms);
+  CHECK(helper.result.back() == 20);
+  REQUIRE(std::size(helper.handler.gaps) == 5);
+  CHECK(helper.handler.gaps[4] == std::pair<uint64_t, uint64_t>{11, 19});
+  CHECK(helper.tracker.missing() == 13);
+  // note! too late
+  helper(17);
+  CHECK(helper.result.back() == 20);
+  CHECK(helper.tracker.duplicates() == 1);
+  helper(40ms);
+  CHECK(std::size(helper.handler.gaps) == 5);
+}
+
+TEST_CASE("sequence_tracker_snapshot", "[sequence_tracker]") {
+  Helper helper{{.window = 8, .timeout = 1ms}};
+  helper(1);
+  helper(3);
+  helper(6);
+  // snapshot covers 3
+  helper(4, true);
+  CHECK(helper.result == std::vector<uint64_t>{1, 4});
+  helper(5);
+  CHECK(helper.result == std::vector<uint64_t>{1, 4, 5, 6});
+  CHECK(std::empty(helper.handler.gaps));
+  // timer (nothing pending)
+  helper(10ms);
+  CHECK(std::size(helper.result) == 4);
+  // stale snapshot => ignored (9 is still buffered)
+  helper(9);
+  helper(3, true);
+  CHECK(helper.tracker.duplicates() == 1);
+  helper(7);
+  helper(8);
+  CHECK(helper.result == std::vector<uint64_t>{1, 4, 5, 6, 7, 8, 9});
+  CHECK(std::empty(helper.handler.gaps));
+}
@@ -0,0 +1,107 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/signal_engine.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+Layer create_layer(double bid_price, double bid_quantity, double ask_price, double ask_quantity) {
+  return {
+      .bid_price = bid_price,
+      .bid_quantity = bid_quantity,
+      .ask_price = ask_price,
+      .ask_quantity = ask_quantity,
+  };
+}
+
+bool top_of_book(auto &engine, std::string_view const &symbol, Layer const &layer) {
+  MessageInfo message_info;
+  TopOfBook top_of_book{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = symbol,
+      .layer = layer,
+      .update_type = {},
+      .exchange_time_utc = {},
+      .exchange_sequence = {},
+      .sending_time_utc = {},
+  };
+  Event event{message_info, top_of_book};
+  return engine(event);
+}
+}  // namespace
+
+TEST_CASE("signal_engine_top_of_book", "[signal_engine]") {
+  tools::SignalEngine engine{{.depth = 5, .alpha = 0.5}};
+  auto btc = engine.add("deribit"sv, "BTC-PERPETUAL"sv, 0.5);
+  auto eth = engine.add("deribit"sv, "ETH-PERPETUAL"sv);
+  CHECK(engine.add("deribit"sv, "BTC-PERPETUAL"sv) == btc);
+  CHECK(engine.size() == 2);
+  CHECK(engine.padded_size() == tools::SignalEngine::LANES);
+  CHECK(reinterpret_cast<uintptr_t>(std::data(engine.mid())) % ROQ_CACHELINE_SIZE == 0);
+  CHECK(top_of_book(engine, "XRP-PERPETUAL"sv, {}) == false);
+  CHECK(top_of_book(engine, "BTC-PERPETUAL"sv, create_layer(100.0, 3.0, 102.0, 1.0)));
+  CHECK(engine.mid()[btc] == 101.0);
+  CHECK(engine.microprice()[btc] == 101.5);
+  CHECK(engine.spread()[btc] == 4.0);
+  CHECK(engine.imbalance()[btc] == 0.5);
+  CHECK(engine.ema_mid()[btc] == 101.0);
+  CHECK(std::isnan(engine.mid()[eth]));
+  // unchanged
+  CHECK(top_of_book(engine, "BTC-PERPETUAL"sv, create_layer(100.0, 3.0, 102.0, 1.0)) == false);
+  CHECK(engine.ema_mid()[btc] == 101.0);
+  // changed
+  CHECK(top_of_book(engine, "BTC-PERPETUAL"sv, create_layer(102.0, 1.0, 104.0, 1.0)));
+  CHECK(engine.mid()[btc] == 103.0);
+  CHECK(engine.ema_mid()[btc] == 102.0);
+  CHECK(engine.imbalance()[btc] == 0.0);
+  // tick size unknown
+  CHECK(top_of_book(engine, "ETH-PERPETUAL"sv, create_layer(10.0, 1.0, 11.0, 1.0)));
+  CHECK(std::isnan(engine.spread()[eth]));
+  MessageInfo message_info;
+  ReferenceData reference_data{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "ETH-PERPETUAL"sv,
+      .description = {},
+      .security_type = {},
+      .base_currency = {},
+      .quote_currency = {},
+      .margin_currency = {},
+      .commission_currency = {},
+      .tick_size = 0.25,
+      .strike_currency = {},
+      .underlying = {},
+      .time_zone = {},
+  };
+  engine(Event{message_info, reference_data});
+  CHECK(engine.spread()[eth] == 4.0);
+}
+
+TEST_CASE("signal_engine_depth", "[signal_engine]") {
+  tools::SignalEngine engine{{.depth = 2, .alpha = 0.1}};
+  auto index = engine.add("deribit"sv, "BTC-PERPETUAL"sv, 1.0);
+  std::vector<Layer> layers{
+      create_layer(100.0, 1.0, 101.0, 1.0),
+      create_layer(99.0, 5.0, 102.0, 1.0),
+      create_layer(98.0, 100.0, 103.0, 1.0),  // beyond depth
+  };
+  CHECK(engine.update(index, layers));
+  CHECK(engine.imbalance()[index] == 0.5);
+  CHECK(engine.microprice()[index] == 100.5);
+  CHECK(engine.update(index, layers) == false);
+  layers[2].bid_quantity = 1.0;
+  CHECK(engine.update(index, layers) == false);
+  layers[1].ask_quantity = 5.0;
+  CHECK(engine.update(index, layers));
+  CHECK(engine.imbalance()[index] == 0.0);
+  // padding
+  for (size_t i = 0; i < tools::SignalEngine::LANES; ++i)
+    engine.add("deribit"sv, fmt::format("{}"sv, i));
+  CHECK(engine.padded_size() == 2 * tools::SignalEngine::LANES);
+  CHECK(engine.mid()[index] == 100.5);
+}
@@ -0,0 +1,113 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/cache/statistics_cache.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+struct Handler final : public cache::StatisticsCache::Handler {
+  void operator()(cache::StatisticsCache::Instrument const &, Statistics const &statistics) override {
+    result.emplace_back(statistics.type, statistics.value);
+  }
+  std::vector<std::pair<StatisticsType, double>> result;
+};
+
+auto &statistics_update(
+    auto &cache, std::span<Statistics const> const &statistics, UpdateType update_type, uint16_t stream_id = {}) {
+  MessageInfo message_info;
+  StatisticsUpdate statistics_update{
+      .stream_id = stream_id,
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .statistics = statistics,
+      .update_type = update_type,
+      .exchange_time_utc = {},
+      .exchange_sequence = {},
+      .sending_time_utc = {},
+  };
+  Event event{message_info, statistics_update};
+  return cache(event);
+}
+}  // namespace
+
+TEST_CASE("statistics_cache_simple", "[statistics_cache]") {
+  Handler handler;
+  cache::StatisticsCache cache{handler, {StatisticsType::FUNDING_RATE, StatisticsType::SETTLEMENT_PRICE}};
+  CHECK(cache.find("deribit"sv, "BTC-PERPETUAL"sv) == nullptr);
+  CHECK(std::isnan(cache.get("deribit"sv, "BTC-PERPETUAL"sv, StatisticsType::FUNDING_RATE)));
+  std::vector<Statistics> statistics{
+      {.type = StatisticsType::FUNDING_RATE, .value = 0.25},
+      {.type = StatisticsType::OPEN_INTEREST, .value = 100.0},
+      {.type = StatisticsType::SETTLEMENT_PRICE, .value = 123.0},
+  };
+  auto &instrument = statistics_update(cache, statistics, UpdateType::SNAPSHOT);
+  CHECK(cache.size() == 1);
+  CHECK(instrument[StatisticsType::FUNDING_RATE] == 0.25);
+  CHECK(instrument[StatisticsType::OPEN_INTEREST] == 100.0);
+  CHECK(std::isnan(instrument[StatisticsType::CLOSE_PRICE]));
+  CHECK(instrument.get(StatisticsType::SETTLEMENT_PRICE).type == StatisticsType::SETTLEMENT_PRICE);
+  REQUIRE(std::size(handler.result) == 2);
+  CHECK(handler.result[0] == std::pair{StatisticsType::FUNDING_RATE, 0.25});
+  CHECK(handler.result[1] == std::pair{StatisticsType::SETTLEMENT_PRICE, 123.0});
+  handler.result.clear();
+  // incremental (merge), unchanged values do not notify
+  std::vector<Statistics> statistics_2{
+      {.type = StatisticsType::FUNDING_RATE, .value = 0.25},
+      {.type = StatisticsType::OPEN_INTEREST, .value = 200.0},
+      {.type = StatisticsType::CLOSE_PRICE, .value = 122.0},
+  };
+  statistics_update(cache, statistics_2, UpdateType::INCREMENTAL);
+  CHECK(std::empty(handler.result));
+  CHECK(cache.get("deribit"sv, "BTC-PERPETUAL"sv, StatisticsType::OPEN_INTEREST) == 200.0);
+  CHECK(cache.get("deribit"sv, "BTC-PERPETUAL"sv, StatisticsType::CLOSE_PRICE) == 122.0);
+  CHECK(cache.get("deribit"sv, "BTC-PERPETUAL"sv, StatisticsType::SETTLEMENT_PRICE) == 123.0);
+  // snapshot (resets missing)
+  std::vector<Statistics> statistics_3{
+      {.type = StatisticsType::FUNDING_RATE, .value = 0.5},
+  };
+  statistics_update(cache, statistics_3, UpdateType::SNAPSHOT);
+  REQUIRE(std::size(handler.result) == 2);
+  CHECK(handler.result[0] == std::pair{StatisticsType::FUNDING_RATE, 0.5});
+  CHECK(handler.result[1].first == StatisticsType::SETTLEMENT_PRICE);
+  CHECK(std::isnan(handler.result[1].second));
+  CHECK(std::isnan(instrument[StatisticsType::OPEN_INTEREST]));
+  CHECK(std::isnan(instrument[StatisticsType::CLOSE_PRICE]));
+  CHECK(&instrument == cache.find("deribit"sv, "BTC-PERPETUAL"sv));
+}
+
+TEST_CASE("statistics_cache_streams", "[statistics_cache]") {
+  Handler handler;
+  cache::StatisticsCache cache{handler, {StatisticsType::FUNDING_RATE, StatisticsType::SETTLEMENT_PRICE}};
+  std::vector<Statistics> statistics_1{
+      {.type = StatisticsType::FUNDING_RATE, .value = 0.25},
+  };
+  std::vector<Statistics> statistics_2{
+      {.type = StatisticsType::OPEN_INTEREST, .value = 100.0},
+      {.type = StatisticsType::SETTLEMENT_PRICE, .value = 123.0},
+  };
+  statistics_update(cache, statistics_1, UpdateType::SNAPSHOT, 1);
+  auto &instrument = statistics_update(cache, statistics_2, UpdateType::SNAPSHOT, 2);
+  CHECK(instrument[StatisticsType::FUNDING_RATE] == 0.25);
+  CHECK(instrument[StatisticsType::OPEN_INTEREST] == 100.0);
+  CHECK(instrument[StatisticsType::SETTLEMENT_PRICE] == 123.0);
+  handler.result.clear();
+  // note! a snapshot does not reset types owned by another stream
+  statistics_1[0].value = 0.5;
+  statistics_update(cache, statistics_1, UpdateType::SNAPSHOT, 1);
+  REQUIRE(std::size(handler.result) == 1);
+  CHECK(handler.result[0] == std::pair{StatisticsType::FUNDING_RATE, 0.5});
+  CHECK(instrument[StatisticsType::OPEN_INTEREST] == 100.0);
+  CHECK(instrument[StatisticsType::SETTLEMENT_PRICE] == 123.0);
+  handler.result.clear();
+  statistics_2.pop_back();
+  statistics_update(cache, statistics_2, UpdateType::SNAPSHOT, 2);
+  REQUIRE(std::size(handler.result) == 1);
+  CHECK(handler.result[0].first == StatisticsType::SETTLEMENT_PRICE);
+  CHECK(std::isnan(handler.result[0].second));
+  CHECK(instrument[StatisticsType::FUNDING_RATE] == 0.5);
+  CHECK(instrument[StatisticsType::OPEN_INTEREST] == 100.0);
+}
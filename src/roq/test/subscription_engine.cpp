@@ -0,0 +1,71 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/subscription_engine.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+TEST_CASE("subscription_engine_simple", "[subscription_engine]") {
+  tools::SubscriptionEngine engine;
+  engine(client::Symbol{.regex = "BTC-PERPETUAL"sv, .exchange = "deribit"sv});
+  engine(client::Symbol{.regex = "^ETH\\-.*$"sv, .exchange = {}});
+  engine(client::Symbol{.regex = "[A-Z]+USDT"sv, .exchange = "binance"sv});
+  // literal
+  auto id_1 = engine.add("deribit"sv, "BTC-PERPETUAL"sv);
+  CHECK(engine.is_subscribed(id_1));
+  CHECK(!engine.is_subscribed(engine.add("bybit"sv, "BTC-PERPETUAL"sv)));
+  CHECK(!engine.is_subscribed(engine.add("deribit"sv, "BTC-PERPETUAL-X"sv)));
+  // prefix
+  CHECK(engine.is_subscribed(engine.add("deribit"sv, "ETH-PERPETUAL"sv)));
+  CHECK(engine.is_subscribed(engine.add("bybit"sv, "ETH-"sv)));
+  CHECK(!engine.is_subscribed(engine.add("bybit"sv, "ETHUSDT"sv)));
+  // regex (full match)
+  CHECK(engine.is_subscribed(engine.add("binance"sv, "BTCUSDT"sv)));
+  CHECK(!engine.is_subscribed(engine.add("binance"sv, "BTCUSDT_PERP"sv)));
+  CHECK(!engine.is_subscribed(engine.add("bybit"sv, "BTCUSDT"sv)));
+  // same id
+  CHECK(engine.add("deribit"sv, "BTC-PERPETUAL"sv) == id_1);
+  CHECK(engine.find("deribit"sv, "BTC-PERPETUAL"sv) == id_1);
+  CHECK(engine.find("deribit"sv, "XYZ"sv) == tools::SubscriptionEngine::NOT_FOUND);
+  CHECK(engine.size() == 9);
+  // unknown instruments are matched directly
+  CHECK(engine.is_subscribed("binance"sv, "ETHUSDT"sv));
+  CHECK(!engine.is_subscribed("binance"sv, "ethusdt"sv));
+}
+
+TEST_CASE("subscription_engine_late_pattern", "[subscription_engine]") {
+  tools::SubscriptionEngine engine;
+  std::vector<size_t> ids;
+  for (size_t i = 0; i < 200; ++i)
+    ids.emplace_back(engine.add("deribit"sv, fmt::format("BTC-{}"sv, i)));
+  CHECK(!engine.is_subscribed(ids[0]));
+  engine(client::Symbol{.regex = "BTC-1[0-9]"sv, .exchange = {}});
+  engine(client::Symbol{.regex = "BTC-199"sv, .exchange = "deribit"sv});
+  size_t count = {};
+  for (auto id : ids)
+    count += engine.is_subscribed(id);
+  CHECK(count == 11);
+  CHECK(engine.is_subscribed(ids[15]));
+  CHECK(engine.is_subscribed(ids[199]));
+  CHECK(!engine.is_subscribed(ids[100]));
+  // any
+  engine(client::Symbol{.regex = ".*"sv, .exchange = {}});
+  for (auto id : ids)
+    CHECK(engine.is_subscribed(id));
+}
+
+TEST_CASE("subscription_engine_account", "[subscription_engine]") {
+  tools::SubscriptionEngine engine;
+  engine(client::Account{.regex = "A1"sv});
+  engine(client::Account{.regex = "B.*"sv});
+  engine(client::Account{.regex = "C[0-9]"sv});
+  CHECK(engine.is_subscribed_account("A1"sv));
+  CHECK(!engine.is_subscribed_account("A2"sv));
+  CHECK(engine.is_subscribed_account("B123"sv));
+  CHECK(engine.is_subscribed_account("C7"sv));
+  CHECK(!engine.is_subscribed_account("C77"sv));
+  CHECK_THROWS_AS(engine(client::Account{.regex = "D[0-9"sv}), InvalidArgument);
+}
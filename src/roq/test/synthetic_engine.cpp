@@ -0,0 +1,137 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/synthetic_engine.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+Layer create_layer(double bid_price, double bid_quantity, double ask_price, double ask_quantity) {
+  return {
+      .bid_price = bid_price,
+      .bid_quantity = bid_quantity,
+      .ask_price = ask_price,
+      .ask_quantity = ask_quantity,
+  };
+}
+
+auto refresh(auto &engine) {
+  std::vector<std::string> result;
+  engine.refresh([&](auto &synthetic) { result.emplace_back(synthetic.name); });
+  return result;
+}
+}  // namespace
+
+TEST_CASE("synthetic_engine_spread", "[synthetic_engine]") {
+  tools::SyntheticEngine engine{{.depth = 5}};
+  std::vector<tools::SyntheticEngine::Leg> legs{
+      {.exchange = "cme"sv, .symbol = "A"sv, .weight = 1.0},
+      {.exchange = "cme"sv, .symbol = "B"sv, .weight = -1.0},
+  };
+  auto spread = engine.add("A-B"sv, legs);
+  std::vector<tools::SyntheticEngine::Leg> legs_2{
+      {.exchange = "cme"sv, .symbol = "A"sv, .weight = 2.0},
+  };
+  auto basket = engine.add("2A"sv, legs_2);
+  std::vector<tools::SyntheticEngine::Leg> legs_3{
+      {.exchange = "cme"sv, .symbol = "C"sv, .weight = 0.0},
+  };
+  CHECK_THROWS_AS(engine.add("C"sv, legs_3), InvalidArgument);
+  CHECK_THROWS_AS(engine.add("A-B"sv, legs_2), InvalidArgument);  // duplicate name
+  std::vector<tools::SyntheticEngine::Leg> legs_4{
+      {.exchange = "cme"sv, .symbol = "A"sv, .weight = 1.0},
+      {.exchange = "cme"sv, .symbol = "A"sv, .weight = -1.0},
+  };
+  CHECK_THROWS_AS(engine.add("A-A"sv, legs_4), InvalidArgument);  // duplicate leg
+  CHECK(engine.size() == 2);
+  CHECK(engine.find("A-B"sv) == spread);
+  CHECK(engine.find("2A"sv) == basket);
+  CHECK(engine.find("A-A"sv) == tools::SyntheticEngine::NOT_FOUND);
+  CHECK(refresh(engine) == std::vector<std::string>{"A-B", "2A"});
+  CHECK(std::isnan(engine[spread].layers[0].bid_price));
+  std::vector<Layer> a{create_layer(100.0, 2.0, 101.0, 1.0), create_layer(99.0, 5.0, 102.0, 3.0)};
+  std::vector<Layer> b{create_layer(50.0, 1.0, 51.0, 3.0), create_layer(49.0, 4.0, 52.0, 2.0)};
+  CHECK(engine.update(engine.find_leg("cme"sv, "A"sv), a));
+  CHECK(engine.update(engine.find_leg("cme"sv, "B"sv), b));
+  CHECK(engine.update(engine.find_leg("cme"sv, "B"sv), b) == false);  // unchanged
+  CHECK(refresh(engine) == std::vector<std::string>{"A-B", "2A"});
+  CHECK(refresh(engine) == std::vector<std::string>{});
+  auto &layers = engine[spread].layers;
+  CHECK(layers[0].bid_price == 49.0);
+  CHECK(layers[0].bid_quantity == 2.0);
+  CHECK(layers[1].bid_price == 48.0);
+  CHECK(layers[1].bid_quantity == 1.0);
+  CHECK(layers[2].bid_price == 47.0);
+  CHECK(layers[2].bid_quantity == 2.0);
+  CHECK(std::isnan(layers[3].bid_price));
+  CHECK(layers[0].ask_price == 51.0);
+  CHECK(layers[0].ask_quantity == 1.0);
+  CHECK(layers[1].ask_price == 53.0);
+  CHECK(layers[1].ask_quantity == 3.0);
+  CHECK(std::isnan(layers[2].ask_price));
+  auto &layers_2 = engine[basket].layers;
+  CHECK(layers_2[0].bid_price == 200.0);
+  CHECK(layers_2[0].bid_quantity == 1.0);
+  CHECK(layers_2[1].ask_price == 204.0);
+  CHECK(layers_2[1].ask_quantity == 1.5);
+  // only the spread depends on B
+  std::vector<Layer> b_2{create_layer(50.0, 2.0, 51.0, 3.0)};
+  CHECK(engine.update(engine.find_leg("cme"sv, "B"sv), b_2));
+  CHECK(refresh(engine) == std::vector<std::string>{"A-B"});
+  CHECK(layers[0].ask_price == 51.0);
+  CHECK(layers[0].ask_quantity == 1.0);
+  CHECK(layers[1].ask_price == 52.0);
+  CHECK(layers[1].ask_quantity == 1.0);
+  CHECK(std::isnan(layers[2].ask_price));
+}
+
+TEST_CASE("synthetic_engine_dust", "[synthetic_engine]") {
+  tools::SyntheticEngine engine{{.depth = 3, .min_trade_vol = 0.5}};
+  std::vector<tools::SyntheticEngine::Leg> legs{
+      {.exchange = "cme"sv, .symbol = "A"sv, .weight = 0.1},
+      {.exchange = "cme"sv, .symbol = "B"sv, .weight = 1.0},
+  };
+  auto basket = engine.add("A+B"sv, legs);
+  // note! 0.3 / 0.1 is 2.9999999999999996, i.e. B would leave a tiny leftover
+  std::vector<Layer> a{create_layer(100.0, 0.3, 101.0, 0.3), create_layer(99.0, 1.0, 102.0, 1.0)};
+  std::vector<Layer> b{create_layer(50.0, 3.0, 51.0, 3.0), create_layer(49.0, 0.2, 52.0, 5.0)};
+  engine.update(engine.find_leg("cme"sv, "A"sv), a);
+  engine.update(engine.find_leg("cme"sv, "B"sv), b);
+  refresh(engine);
+  auto &layers = engine[basket].layers;
+  CHECK(layers[0].bid_price == 60.0);
+  CHECK(layers[0].bid_quantity == 0.3 / 0.1);
+  // note! 0.2 is below min_trade_vol
+  CHECK(std::isnan(layers[1].bid_price));
+  CHECK(layers[0].ask_price == 0.1 * 101.0 + 51.0);
+  CHECK(layers[1].ask_price == 0.1 * 102.0 + 52.0);
+  CHECK(layers[1].ask_quantity == 5.0);
+  CHECK(std::isnan(layers[2].ask_price));
+}
+
+TEST_CASE("synthetic_engine_merge", "[synthetic_engine]") {
+  tools::SyntheticEngine engine{{.depth = 3, .min_trade_vol = 0.5}};
+  std::vector<tools::SyntheticEngine::Leg> legs{
+      {.exchange = "cme"sv, .symbol = "A"sv, .weight = 1.0},
+  };
+  auto synthetic = engine.add("A"sv, legs);
+  // note! levels are not validated, i.e. a price can repeat after a level which is not published
+  std::vector<Layer> a{
+      create_layer(100.0, 1.0, 101.0, 1.0), create_layer(99.0, 0.2, 101.0, 2.0), create_layer(100.0, 2.0, NaN, 0.0)};
+  engine.update(engine.find_leg("cme"sv, "A"sv), a);
+  refresh(engine);
+  auto &layers = engine[synthetic].layers;
+  // merged with the level produced by the previous step
+  CHECK(layers[0].ask_price == 101.0);
+  CHECK(layers[0].ask_quantity == 3.0);
+  CHECK(std::isnan(layers[1].ask_price));
+  // not merged across the level below min_trade_vol
+  CHECK(layers[0].bid_price == 100.0);
+  CHECK(layers[0].bid_quantity == 1.0);
+  CHECK(layers[1].bid_price == 100.0);
+  CHECK(layers[1].bid_quantity == 2.0);
+  CHECK(std::isnan(layers[2].bid_price));
+}
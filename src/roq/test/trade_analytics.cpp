@@ -0,0 +1,158 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include "roq/tools/trade_analytics.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+auto trade_summary(
+    auto &analytics,
+    std::chrono::nanoseconds exchange_time_utc,
+    std::span<Trade const> const &trades,
+    std::chrono::nanoseconds skew = {}) {
+  MessageInfo message_info;
+  message_info.receive_time_utc = exchange_time_utc + skew;
+  TradeSummary trade_summary{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .trades = trades,
+      .exchange_time_utc = exchange_time_utc,
+      .exchange_sequence = {},
+      .sending_time_utc = {},
+  };
+  Event event{message_info, trade_summary};
+  return analytics(event);
+}
+
+Trade create_trade(Side side, double price, double quantity) {
+  return {
+      .side = side,
+      .price = price,
+      .quantity = quantity,
+      .trade_id = {},
+      .taker_order_id = {},
+      .maker_order_id = {},
+  };
+}
+}  // namespace
+
+TEST_CASE("trade_analytics_simple", "[trade_analytics]") {
+  tools::TradeAnalytics analytics{{.bucket_size = 1s, .window = 3}};
+  CHECK(analytics.find("deribit"sv, "BTC-PERPETUAL"sv) == tools::TradeAnalytics::NOT_FOUND);
+  std::vector<Trade> trades{
+      create_trade(Side::BUY, 100.0, 1.0),
+      create_trade(Side::SELL, 99.0, 2.0),
+  };
+  auto index = trade_summary(analytics, 10s, trades);
+  CHECK(analytics.find("deribit"sv, "BTC-PERPETUAL"sv) == index);
+  auto &summary = analytics[index];
+  CHECK(summary.buy_volume == 1.0);
+  CHECK(summary.sell_volume == 2.0);
+  CHECK(summary.count() == 2);
+  CHECK(summary.vwap() == 298.0 / 3.0);
+  std::vector<Trade> trades_2{
+      create_trade(Side::BUY, 101.0, 1.0),
+  };
+  trade_summary(analytics, 11s, trades_2);
+  trade_summary(analytics, 12s + 500ms, trades_2);
+  CHECK(summary.buy_volume == 3.0);
+  CHECK(summary.count() == 4);
+  // first bucket leaves the window
+  trade_summary(analytics, 13s, trades_2);
+  CHECK(summary.buy_volume == 3.0);
+  CHECK(summary.sell_volume == 0.0);
+  CHECK(summary.vwap() == 101.0);
+  // late (out of order, but within the window)
+  trade_summary(analytics, 11s + 1ms, trades_2);
+  CHECK(summary.buy_volume == 4.0);
+  // late (older than the window)
+  trade_summary(analytics, 10s, trades_2);
+  CHECK(summary.buy_volume == 4.0);
+  CHECK(analytics.late() == 1);
+  // query
+  CHECK(analytics.get(index, 14s).buy_volume == 2.0);
+  CHECK(analytics.get(index, 15s).buy_volume == 1.0);
+  CHECK(analytics.get(index, 100s).count() == 0);
+  CHECK(std::isnan(analytics.get(index, 100s).vwap()));
+}
+
+TEST_CASE("trade_analytics_trade_through", "[trade_analytics]") {
+  tools::TradeAnalytics analytics{{}};
+  MessageInfo message_info;
+  TopOfBook top_of_book{
+      .stream_id = {},
+      .exchange = "deribit"sv,
+      .symbol = "BTC-PERPETUAL"sv,
+      .layer{
+          .bid_price = 100.0,
+          .bid_quantity = 1.0,
+          .ask_price = 101.0,
+          .ask_quantity = 1.0,
+      },
+      .update_type = {},
+      .exchange_time_utc = {},
+      .exchange_sequence = {},
+      .sending_time_utc = {},
+  };
+  analytics(Event{message_info, top_of_book});
+  std::vector<Trade> trades{
+      create_trade(Side::BUY, 101.0, 1.0),
+      create_trade(Side::BUY, 102.0, 1.0),  // through
+      create_trade(Side::SELL, 100.0, 1.0),
+      create_trade(Side::SELL, 99.5, 1.0),  // through
+      create_trade(Side::UNDEFINED, 50.0, 1.0),
+  };
+  auto index = trade_summary(analytics, 1s, trades);
+  CHECK(analytics[index].trade_throughs == 2);
+  CHECK(analytics[index].count() == 5);
+}
+
+TEST_CASE("trade_analytics_undefined_side", "[trade_analytics]") {
+  tools::TradeAnalytics analytics{{.bucket_size = 1s, .window = 3}};
+  std::vector<Trade> trades{
+      create_trade(Side::UNDEFINED, 100.0, 2.0),
+  };
+  auto index = trade_summary(analytics, 10s, trades);
+  auto &summary = analytics[index];
+  CHECK(summary.unattributed_volume == 2.0);
+  CHECK(summary.unattributed_count == 1);
+  CHECK(summary.volume() == 2.0);
+  CHECK(summary.count() == 1);
+  CHECK(summary.vwap() == 100.0);
+  CHECK(summary.trade_throughs == 0);
+  std::vector<Trade> trades_2{
+      create_trade(Side::BUY, 103.0, 1.0),
+  };
+  trade_summary(analytics, 11s, trades_2);
+  CHECK(summary.volume() == 3.0);
+  CHECK(summary.vwap() == 101.0);
+  // first bucket leaves the window
+  trade_summary(analytics, 13s, trades_2);
+  CHECK(summary.unattributed_volume == 0.0);
+  CHECK(summary.unattributed_count == 0);
+  CHECK(summary.count() == 2);
+}
+
+TEST_CASE("trade_analytics_skew", "[trade_analytics]") {
+  tools::TradeAnalytics analytics{{.bucket_size = 1s, .window = 3}};
+  std::vector<Trade> trades{
+      create_trade(Side::BUY, 100.0, 1.0),
+  };
+  // note! local clock is 5s ahead of the exchange
+  auto index = trade_summary(analytics, 10s, trades, 5s);
+  CHECK(analytics.get(index, 16s).buy_volume == 1.0);
+  trade_summary(analytics, 11s, trades, 5s);
+  CHECK(analytics.late() == 0);
+  CHECK(analytics.get(index, 17s).buy_volume == 2.0);
+  // late (dropped) trades do not update the offset
+  trade_summary(analytics, 1s, trades, -10s);
+  CHECK(analytics.late() == 1);
+  CHECK(analytics.get(index, 17s).buy_volume == 2.0);
+  CHECK(analytics.get(index, 18s).buy_volume == 1.0);
+  CHECK(analytics.get(index, 19s).count() == 0);
+}
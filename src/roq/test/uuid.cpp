@@ -0,0 +1,27 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <unordered_set>
+
+#include "roq/uuid.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+TEST_CASE("uuid_format", "[uuid]") {
+  CHECK(fmt::format("{}"sv, UUID{}) == "00000000-0000-0000-0000-000000000000"sv);
+  auto value = static_cast<UUID::value_type>(UINT64_C(0x0123456789abcdef)) << 64 | UINT64_C(0xfedcba9876543210);
+  CHECK(fmt::format("{}"sv, UUID{value}) == "01234567-89ab-cdef-fedc-ba9876543210"sv);
+}
+
+TEST_CASE("uuid_hash", "[uuid]") {
+  std::unordered_set<size_t> hashes;
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    hashes.emplace(std::hash<UUID>{}(UUID{i}));
+    hashes.emplace(std::hash<UUID>{}(UUID{static_cast<UUID::value_type>(i) << 64}));
+  }
+  CHECK(std::size(hashes) == 2000);
+  CHECK(std::hash<UUID>{}(UUID{123}) == std::hash<UUID>{}(UUID{123}));
+}
@@ -0,0 +1,54 @@
+/* Copyright (c) 2017-2024, Hans Erik Thrane */
+
+#include <catch2/catch_all.hpp>
+
+#include <unordered_set>
+
+#include "roq/tools/uuid_generator.hpp"
+
+using namespace std::literals;
+
+using namespace roq;
+
+namespace {
+auto get_version(UUID const &uuid) {
+  return static_cast<uint32_t>((static_cast<UUID::value_type>(uuid) >> 76) & 0xF);
+}
+
+auto get_variant(UUID const &uuid) {
+  return static_cast<uint32_t>((static_cast<UUID::value_type>(uuid) >> 62) & 0x3);
+}
+}  // namespace
+
+TEST_CASE("uuid_generator_v4", "[uuid_generator]") {
+  tools::UUIDGenerator generator{123};
+  std::unordered_set<UUID> uuids;
+  for (size_t i = 0; i < 1000; ++i) {
+    auto uuid = generator.create_v4();
+    CHECK(get_version(uuid) == 4);
+    CHECK(get_variant(uuid) == 2);
+    uuids.emplace(uuid);
+  }
+  CHECK(std::size(uuids) == 1000);
+  auto text = fmt::format("{}"sv, tools::UUIDGenerator::get().create_v4());
+  CHECK(std::size(text) == 36);
+  CHECK(text[14] == '4');
+}
+
+TEST_CASE("uuid_generator_v7", "[uuid_generator]") {
+  tools::UUIDGenerator generator{123};
+  auto now = std::chrono::nanoseconds{1712345678901234567};
+  auto previous = generator.create_v7(now);
+  CHECK(get_version(previous) == 7);
+  CHECK(get_variant(previous) == 2);
+  CHECK(static_cast<uint64_t>(static_cast<UUID::value_type>(previous) >> 80) == UINT64_C(1712345678901));
+  // monotonic (same millisecond, counter overflow and clock going backwards)
+  for (size_t i = 0; i < 10000; ++i) {
+    auto uuid = generator.create_v7(i < 5000 ? now : (now - 1s));
+    CHECK(get_version(uuid) == 7);
+    CHECK(static_cast<UUID::value_type>(uuid) > static_cast<UUID::value_type>(previous));
+    previous = uuid;
+  }
+  auto uuid = generator.create_v7(now + 1s);
+  CHECK(static_cast<uint64_t>(static_cast<UUID::value_type>(uuid) >> 80) == UINT64_C(1712345679901));
+}